@@ -0,0 +1,216 @@
+#include <inotify-cpp/Inotify.h>
+
+#include <benchmark/benchmark.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <limits>
+#include <map>
+#include <string>
+
+using namespace inotify;
+
+namespace {
+
+/**
+ * @brief Synthetic directory trees, created once per size and removed
+ *        when the benchmarks are done. Every directory has up to ten
+ *        subdirectories and one file.
+ */
+class Trees {
+  public:
+    ~Trees()
+    {
+        for (const auto& tree : mTrees) {
+            boost::filesystem::remove_all(tree.second);
+        }
+    }
+
+    const boost::filesystem::path& get(std::size_t directories)
+    {
+        auto& root = mTrees[directories];
+        if (!root.empty()) {
+            return root;
+        }
+
+        root = "inotifyBenchmarkTree" + std::to_string(directories);
+        boost::filesystem::remove_all(root);
+        boost::filesystem::create_directories(root);
+
+        // Breadth first, the tree stays balanced
+        std::vector<boost::filesystem::path> level { root };
+        std::size_t created = 1;
+        while (created < directories) {
+            std::vector<boost::filesystem::path> next;
+            for (const auto& parent : level) {
+                std::ofstream((parent / "file.txt").string());
+                for (int child = 0; child < 10 && created < directories; ++child, ++created) {
+                    next.push_back(parent / std::to_string(child));
+                    boost::filesystem::create_directory(next.back());
+                }
+            }
+            level.swap(next);
+        }
+        return root;
+    }
+
+  private:
+    std::map<std::size_t, boost::filesystem::path> mTrees;
+};
+
+Trees trees;
+
+/**
+ * @return resident set size of the process in kB
+ */
+std::size_t residentSetSize()
+{
+    std::ifstream status("/proc/self/status");
+    std::string key;
+    while (status >> key) {
+        if (key == "VmRSS:") {
+            std::size_t kiloBytes = 0;
+            status >> kiloBytes;
+            return kiloBytes;
+        }
+        status.ignore(std::numeric_limits<std::streamsize>::max(), '\n');
+    }
+    return 0;
+}
+
+std::size_t maxWatches()
+{
+    std::ifstream stream("/proc/sys/fs/inotify/max_user_watches");
+    std::size_t watches = 0;
+    stream >> watches;
+    return watches;
+}
+
+void DirectoryCrawl(benchmark::State& state)
+{
+    const auto& root = trees.get(static_cast<std::size_t>(state.range(0)));
+
+    std::size_t entries = 0;
+    for (auto _ : state) {
+        DirectoryCrawler crawler(static_cast<std::size_t>(state.range(1)));
+        auto statistics = crawler.crawl(
+            root,
+            [](boost::string_ref) { return false; },
+            [&](const boost::filesystem::path&, EntryType) { ++entries; });
+        benchmark::DoNotOptimize(statistics);
+    }
+    state.SetItemsProcessed(static_cast<std::int64_t>(entries));
+}
+
+/**
+ * @brief Watches a tree of range(0) directories. Reports the resident
+ *        set size the watches added to the process in kB, the kernel
+ *        memory of the watches is not part of it. Later iterations
+ *        reuse the memory freed by the earlier ones, so the largest
+ *        growth of all iterations is reported.
+ */
+void WatchDirectoryRecursively(benchmark::State& state)
+{
+    auto directories = static_cast<std::size_t>(state.range(0));
+    if (directories > maxWatches()) {
+        state.SkipWithError("Tree exceeds /proc/sys/fs/inotify/max_user_watches");
+        return;
+    }
+    const auto& root = trees.get(directories);
+
+    std::size_t residentSetGrowth = 0;
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto residentSetBefore = residentSetSize();
+        {
+            Inotify inotify;
+            inotify.setCrawlThreads(static_cast<std::size_t>(state.range(1)));
+            state.ResumeTiming();
+            inotify.watchDirectoryRecursively(root);
+            state.PauseTiming();
+            auto residentSetAfter = residentSetSize();
+            if (residentSetAfter > residentSetBefore) {
+                residentSetGrowth
+                    = std::max(residentSetGrowth, residentSetAfter - residentSetBefore);
+            }
+        }
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(directories));
+    state.counters["rss_kb"] = static_cast<double>(residentSetGrowth);
+}
+
+/**
+ * @brief Watches a tree of range(0) directories from a state saved
+ *        before, nothing changed in between. Compare with
+ *        WatchDirectoryRecursively.
+ */
+void RestoreWatchState(benchmark::State& state)
+{
+    auto directories = static_cast<std::size_t>(state.range(0));
+    if (directories > maxWatches()) {
+        state.SkipWithError("Tree exceeds /proc/sys/fs/inotify/max_user_watches");
+        return;
+    }
+    const auto& root = trees.get(directories);
+    auto stateFile = root.native() + ".state";
+    {
+        Inotify inotify;
+        inotify.watchDirectoryRecursively(root);
+        inotify.saveWatchState(stateFile);
+    }
+
+    for (auto _ : state) {
+        state.PauseTiming();
+        {
+            Inotify inotify;
+            state.ResumeTiming();
+            bool restored = inotify.restoreWatchState(stateFile);
+            state.PauseTiming();
+            if (!restored) {
+                state.SkipWithError("Saved watch state is invalid");
+            }
+        }
+        state.ResumeTiming();
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<std::int64_t>(directories));
+    boost::filesystem::remove(stateFile);
+}
+
+/**
+ * @brief Registers the tree sizes from 10k up to
+ *        INOTIFY_BENCHMARK_MAX_DIRECTORIES, 100k by default. Creating
+ *        the larger trees takes a while and needs the disk space.
+ */
+int registerCrawlBenchmarks()
+{
+    std::size_t maxDirectories = 100000;
+    if (const char* configured = std::getenv("INOTIFY_BENCHMARK_MAX_DIRECTORIES")) {
+        maxDirectories = std::strtoul(configured, nullptr, 10);
+    }
+
+    for (std::size_t directories = 10000; directories <= maxDirectories; directories *= 10) {
+        auto size = static_cast<std::int64_t>(directories);
+        benchmark::RegisterBenchmark("DirectoryCrawl", DirectoryCrawl)
+            ->Args({ size, 1 })
+            ->Args({ size, 4 })
+            ->Unit(benchmark::kMillisecond)
+            ->UseRealTime();
+        benchmark::RegisterBenchmark("WatchDirectoryRecursively", WatchDirectoryRecursively)
+            ->Args({ size, 1 })
+            ->Args({ size, 4 })
+            ->Unit(benchmark::kMillisecond)
+            ->Iterations(3)
+            ->UseRealTime();
+        benchmark::RegisterBenchmark("RestoreWatchState", RestoreWatchState)
+            ->Arg(size)
+            ->Unit(benchmark::kMillisecond)
+            ->Iterations(3)
+            ->UseRealTime();
+    }
+    return 0;
+}
+
+int registered = registerCrawlBenchmarks();
+}
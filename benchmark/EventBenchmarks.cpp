@@ -0,0 +1,278 @@
+#include <inotify-cpp/NotifierBuilder.h>
+#include <inotify-cpp/StaticNotifier.h>
+
+#include <benchmark/benchmark.h>
+#include <boost/filesystem/fstream.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+
+using namespace inotify;
+
+namespace {
+
+/**
+ * @brief Watched directory with a file whose opens cause the events.
+ *        Every open causes an open and a close_nowrite event, they
+ *        alternate and are never merged by the kernel.
+ */
+struct EventSource {
+    EventSource()
+        : directory("inotifyBenchmarkDirectory")
+        , file(directory / "file.txt")
+    {
+        boost::filesystem::create_directories(directory);
+        boost::filesystem::ofstream stream(file);
+    }
+    ~EventSource()
+    {
+        boost::filesystem::remove_all(directory);
+    }
+
+    void open(std::size_t times) const
+    {
+        for (std::size_t i = 0; i < times; ++i) {
+            close(::open(file.c_str(), O_RDONLY));
+        }
+    }
+
+    boost::filesystem::path directory;
+    boost::filesystem::path file;
+};
+
+// Events per iteration are below the default max_queued_events
+const std::size_t eventsPerOpen = 2;
+
+void GetNextEvent(benchmark::State& state)
+{
+    EventSource source;
+    Inotify inotify;
+    inotify.setEventMask(IN_OPEN | IN_CLOSE_NOWRITE);
+    inotify.watchDirectoryRecursively(source.directory);
+
+    auto opens = static_cast<std::size_t>(state.range(0));
+    for (auto _ : state) {
+        state.PauseTiming();
+        source.open(opens);
+        state.ResumeTiming();
+
+        for (std::size_t i = 0; i < opens * eventsPerOpen; ++i) {
+            benchmark::DoNotOptimize(inotify.getNextEvent());
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * opens * eventsPerOpen);
+}
+BENCHMARK(GetNextEvent)->Arg(64)->Arg(1024)->Arg(4096);
+
+void GetNextEvents(benchmark::State& state)
+{
+    EventSource source;
+    Inotify inotify;
+    inotify.setEventMask(IN_OPEN | IN_CLOSE_NOWRITE);
+    inotify.watchDirectoryRecursively(source.directory);
+
+    auto opens = static_cast<std::size_t>(state.range(0));
+    std::vector<FileSystemEvent> events;
+    for (auto _ : state) {
+        state.PauseTiming();
+        source.open(opens);
+        state.ResumeTiming();
+
+        std::size_t read = 0;
+        while (read < opens * eventsPerOpen) {
+            events.clear();
+            read += inotify.getNextEvents(events);
+        }
+        benchmark::DoNotOptimize(events.data());
+    }
+    state.SetItemsProcessed(state.iterations() * opens * eventsPerOpen);
+}
+BENCHMARK(GetNextEvents)->Arg(64)->Arg(1024)->Arg(4096);
+
+void GetNextEventViews(benchmark::State& state)
+{
+    EventSource source;
+    Inotify inotify;
+    inotify.setEventMask(IN_OPEN | IN_CLOSE_NOWRITE);
+    inotify.watchDirectoryRecursively(source.directory);
+
+    auto opens = static_cast<std::size_t>(state.range(0));
+    std::vector<EventView> views;
+    for (auto _ : state) {
+        state.PauseTiming();
+        source.open(opens);
+        state.ResumeTiming();
+
+        std::size_t read = 0;
+        while (read < opens * eventsPerOpen) {
+            views.clear();
+            read += inotify.getNextEventViews(views);
+        }
+        benchmark::DoNotOptimize(views.data());
+    }
+    state.SetItemsProcessed(state.iterations() * opens * eventsPerOpen);
+}
+BENCHMARK(GetNextEventViews)->Arg(64)->Arg(1024)->Arg(4096);
+
+/**
+ * @brief Events through NotifierBuilder::run to the observers,
+ *        including the time to cause them
+ *
+ * @param range(0) opens per iteration
+ * @param range(1) observer threads, zero observes on the reading thread
+ */
+void NotifierRun(benchmark::State& state)
+{
+    EventSource source;
+    std::atomic<std::size_t> observed(0);
+    auto notifier = BuildNotifier()
+                        .watchPathRecursively(source.directory)
+                        .setObserverThreads(static_cast<std::size_t>(state.range(1)))
+                        .onEvents({ Event::open, Event::close_nowrite },
+                            [&](const Notification&) { ++observed; });
+    std::thread thread([&]() { notifier.run(); });
+
+    auto opens = static_cast<std::size_t>(state.range(0));
+    for (auto _ : state) {
+        auto expected = observed + opens * eventsPerOpen;
+        source.open(opens);
+        while (observed < expected) {
+            std::this_thread::yield();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * opens * eventsPerOpen);
+
+    notifier.stop();
+    thread.join();
+}
+BENCHMARK(NotifierRun)->Args({ 1024, 0 })->Args({ 1024, 2 })->UseRealTime();
+
+/**
+ * @brief Like NotifierRun on the reading thread, with the observer
+ *        inlined by StaticNotifier
+ */
+void StaticNotifierRun(benchmark::State& state)
+{
+    EventSource source;
+    std::atomic<std::size_t> observed(0);
+    auto notifier
+        = makeNotifier(on<Event::open, Event::close_nowrite>([&](const Notification&) {
+              ++observed;
+          }));
+    notifier.watchPathRecursively(source.directory);
+    std::thread thread([&]() { notifier.run(); });
+
+    auto opens = static_cast<std::size_t>(state.range(0));
+    for (auto _ : state) {
+        auto expected = observed + opens * eventsPerOpen;
+        source.open(opens);
+        while (observed < expected) {
+            std::this_thread::yield();
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * opens * eventsPerOpen);
+
+    notifier.stop();
+    thread.join();
+}
+BENCHMARK(StaticNotifierRun)->Arg(1024)->UseRealTime();
+
+/**
+ * @brief Events of a recorded log through NotifierBuilder::run at
+ *        maximum speed. Measures the dispatch pipeline without the
+ *        kernel, every iteration replays the same events.
+ *
+ * @param range(0) opens in the log
+ * @param range(1) observer threads, zero observes on the reading thread
+ */
+void ReplayedNotifierRun(benchmark::State& state)
+{
+    EventSource source;
+    auto logFile = source.directory.parent_path() / "inotifyBenchmarkEvents.log";
+    auto opens = static_cast<std::size_t>(state.range(0));
+    {
+        Inotify inotify;
+        inotify.setEventMask(IN_OPEN | IN_CLOSE_NOWRITE);
+        inotify.watchDirectoryRecursively(source.directory);
+        inotify.recordEvents(logFile);
+        source.open(opens);
+
+        std::vector<FileSystemEvent> events;
+        std::size_t read = 0;
+        while (read < opens * eventsPerOpen) {
+            read += inotify.getNextEvents(events);
+        }
+        inotify.stopRecording();
+    }
+
+    std::atomic<std::size_t> observed(0);
+    for (auto _ : state) {
+        state.PauseTiming();
+        auto notifier = BuildNotifier()
+                            .replayEvents(logFile, ReplaySpeed::maximum)
+                            .setObserverThreads(static_cast<std::size_t>(state.range(1)))
+                            .onEvents({ Event::open, Event::close_nowrite },
+                                [&](const Notification&) { ++observed; });
+        state.ResumeTiming();
+
+        notifier.run();
+    }
+    state.SetItemsProcessed(state.iterations() * opens * eventsPerOpen);
+    boost::filesystem::remove(logFile);
+}
+BENCHMARK(ReplayedNotifierRun)->Args({ 4096, 0 })->Args({ 4096, 2 })->UseRealTime();
+
+/**
+ * @brief Time from closing a file until its observer runs. Reports
+ *        the median and 99th percentile in microseconds.
+ *
+ * @param range(0) observer threads, zero observes on the reading thread
+ */
+void NotificationLatency(benchmark::State& state)
+{
+    using Clock = std::chrono::steady_clock;
+
+    EventSource source;
+    std::atomic<std::size_t> observed(0);
+    Clock::time_point observedAt;
+    auto notifier = BuildNotifier()
+                        .watchPathRecursively(source.directory)
+                        .setObserverThreads(static_cast<std::size_t>(state.range(0)))
+                        .onEvent(Event::close_nowrite, [&](const Notification&) {
+                            observedAt = Clock::now();
+                            ++observed;
+                        });
+    std::thread thread([&]() { notifier.run(); });
+
+    std::vector<double> latencies;
+    for (auto _ : state) {
+        auto expected = observed + 1;
+        int fd = ::open(source.file.c_str(), O_RDONLY);
+        auto closedAt = Clock::now();
+        close(fd);
+        while (observed < expected) {
+            std::this_thread::yield();
+        }
+
+        std::chrono::duration<double> latency = observedAt - closedAt;
+        state.SetIterationTime(latency.count());
+        latencies.push_back(latency.count() * 1e6);
+    }
+
+    notifier.stop();
+    thread.join();
+
+    if (!latencies.empty()) {
+        std::sort(latencies.begin(), latencies.end());
+        state.counters["p50_us"] = latencies[latencies.size() / 2];
+        state.counters["p99_us"] = latencies[latencies.size() * 99 / 100];
+    }
+}
+BENCHMARK(NotificationLatency)->Arg(0)->Arg(2)->UseManualTime()->Iterations(10000);
+}
@@ -0,0 +1,65 @@
+#include <inotify-cpp/IgnoreMatcher.h>
+
+#include <benchmark/benchmark.h>
+
+#include <string>
+#include <vector>
+
+using namespace inotify;
+
+namespace {
+
+std::vector<std::string> paths()
+{
+    std::vector<std::string> paths;
+    for (int i = 0; i < 1024; ++i) {
+        paths.push_back("/home/user/project/src/module" + std::to_string(i % 32) + "/file"
+            + std::to_string(i) + ".cpp");
+    }
+    return paths;
+}
+
+/**
+ * @brief Matches paths against range(0) substring rules, none of
+ *        them matches
+ */
+void IgnoreSubstrings(benchmark::State& state)
+{
+    IgnoreMatcher matcher;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        matcher.ignore("/build" + std::to_string(i) + "/");
+    }
+    matcher.compile();
+
+    auto candidates = paths();
+    for (auto _ : state) {
+        for (const auto& path : candidates) {
+            benchmark::DoNotOptimize(matcher.matches(path));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(candidates.size()));
+}
+BENCHMARK(IgnoreSubstrings)->Arg(1)->Arg(16)->Arg(256)->Arg(4096);
+
+/**
+ * @brief Matches file names against range(0) glob patterns, none of
+ *        them matches
+ */
+void IgnorePatterns(benchmark::State& state)
+{
+    IgnoreMatcher matcher;
+    for (int64_t i = 0; i < state.range(0); ++i) {
+        matcher.ignorePattern("*." + std::to_string(i) + "~");
+    }
+    matcher.compile();
+
+    auto candidates = paths();
+    for (auto _ : state) {
+        for (const auto& path : candidates) {
+            benchmark::DoNotOptimize(matcher.matches(path));
+        }
+    }
+    state.SetItemsProcessed(state.iterations() * static_cast<int64_t>(candidates.size()));
+}
+BENCHMARK(IgnorePatterns)->Arg(1)->Arg(16)->Arg(256);
+}
@@ -19,20 +19,20 @@ int main(int argc, char** argv)
     boost::filesystem::path path(argv[1]);
 
     // Set the event handler which will be used to process particular events
-    auto handleNotification = [&](Notification notification) {
+    auto handleNotification = [&](const Notification& notification) {
         std::cout << "Event " << notification.event << " on " << notification.path
                   << " was triggered." << std::endl;
     };
 
     // Set the a separate unexpected event handler for all other events. An exception is thrown by
     // default.
-    auto handleUnexpectedNotification = [](Notification notification) {
+    auto handleUnexpectedNotification = [](const Notification& notification) {
         std::cout << "Event " << notification.event << " on " << notification.path
                   << " was triggered, but was not expected" << std::endl;
     };
 
     // Set the events to be notified for
-    auto events = { Event::open | Event::is_dir, // some events occur in combinations
+    auto events = { Event::open | Event::is_dir, // open events of directories only
                     Event::access,
                     Event::create,
                     Event::modify,
@@ -0,0 +1,100 @@
+#pragma once
+#include <inotify-cpp/NotifierBuilder.h>
+
+#include <boost/asio/io_context.hpp>
+#include <boost/asio/posix/stream_descriptor.hpp>
+#include <boost/asio/steady_timer.hpp>
+#include <boost/version.hpp>
+
+#include <chrono>
+
+#if BOOST_VERSION < 106600
+#error "AsioNotifier requires Boost.Asio 1.66 or newer"
+#endif
+
+namespace inotify {
+
+/**
+ * @brief Dispatches the events of a NotifierBuilder on a Boost.Asio
+ *        io_context instead of a thread blocking in run().
+ *
+ * The observers are called by the threads running the io_context, thus
+ * one reactor thread can serve many notifiers. The adapter and the
+ * notifier have to outlive the io_context handlers, cancel() and
+ * stop() end the dispatching. Header only, the library itself does not
+ * depend on Boost.Asio.
+ */
+class AsioNotifier {
+  public:
+    AsioNotifier(boost::asio::io_context& context, NotifierBuilder& notifier)
+        : mNotifier(notifier)
+        , mDescriptor(context, notifier.getFileDescriptor())
+        , mTimer(context)
+    {
+    }
+
+    ~AsioNotifier()
+    {
+        cancel();
+
+        // The fd is owned by the notifier
+        mDescriptor.release();
+    }
+
+    AsioNotifier(const AsioNotifier&) = delete;
+    AsioNotifier& operator=(const AsioNotifier&) = delete;
+
+    auto start() -> void
+    {
+        waitReadable();
+        waitTimeout();
+    }
+
+    auto cancel() -> void
+    {
+        boost::system::error_code error;
+        mDescriptor.cancel(error);
+        mTimer.cancel();
+    }
+
+  private:
+    auto waitReadable() -> void
+    {
+        mDescriptor.async_wait(boost::asio::posix::stream_descriptor::wait_read,
+            [this](const boost::system::error_code& error) {
+                if (error || mNotifier.hasStopped()) {
+                    return;
+                }
+
+                mNotifier.processReady();
+                waitReadable();
+                waitTimeout();
+            });
+    }
+
+    /**
+     * @brief Held back events become due without the fd becoming readable
+     */
+    auto waitTimeout() -> void
+    {
+        int timeout = mNotifier.getNextTimeout();
+        if (timeout < 0) {
+            return;
+        }
+
+        mTimer.expires_after(std::chrono::milliseconds(timeout));
+        mTimer.async_wait([this](const boost::system::error_code& error) {
+            if (error || mNotifier.hasStopped()) {
+                return;
+            }
+
+            mNotifier.processReady();
+            waitTimeout();
+        });
+    }
+
+    NotifierBuilder& mNotifier;
+    boost::asio::posix::stream_descriptor mDescriptor;
+    boost::asio::steady_timer mTimer;
+};
+}
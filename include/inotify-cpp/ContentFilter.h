@@ -0,0 +1,100 @@
+#pragma once
+#include <inotify-cpp/FileSystemEvent.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+namespace inotify {
+
+/**
+ * @brief How the content filter decides that a file was not changed
+ */
+enum class ContentCheck {
+    off,
+    metadata, ///< same inode, size and modification time
+    hash ///< same inode, size and hash of the content if the modification time differs
+};
+
+/**
+ * @brief Drops modify and close_write events of files whose content
+ *        did not change since the last event of the same kind.
+ *
+ * Every checked file is stat'ed and, with ContentCheck::hash, read and
+ * hashed on a pool of worker threads, the reading thread never touches
+ * the file. Results are collected once the fd is readable. Events of a
+ * path with a check in flight wait behind it, thus the events of every
+ * path keep their order, events of other paths pass immediately.
+ *
+ * Modify and close_write are compared against separate baselines, a
+ * close_write after a modify on new content still passes. The first
+ * event on a file has no baseline and always passes. Remove and move
+ * events forget the baseline of their paths, an overflow forgets all
+ * of them.
+ *
+ * process and collect must always be called by the same thread.
+ */
+class ContentFilter {
+  public:
+    ContentFilter(ContentCheck check, std::size_t threads);
+    ~ContentFilter();
+
+    ContentFilter(const ContentFilter&) = delete;
+    ContentFilter& operator=(const ContentFilter&) = delete;
+
+    auto getFileDescriptor() const -> int;
+    auto process(FileSystemEvent&& event, std::vector<FileSystemEvent>& out) -> void;
+    auto collect(std::vector<FileSystemEvent>& out) -> std::size_t;
+    auto flushAll(std::vector<FileSystemEvent>& out) -> void;
+    auto pending() const -> std::size_t;
+
+  private:
+    struct State {
+        bool valid;
+        bool racy; ///< modified in the tick it was stat'ed in, the time can not be trusted
+        bool hashed;
+        std::uint64_t inode;
+        std::uint64_t size;
+        std::int64_t mtime;
+        std::uint64_t hash;
+    };
+
+    struct Baselines {
+        State modified;
+        State closed;
+    };
+
+    struct Check {
+        std::string path;
+        std::uint32_t mask;
+        Baselines baselines;
+        State state;
+    };
+
+    static auto unchanged(const State& baseline, const State& state) -> bool;
+
+    auto admit(FileSystemEvent&& event, std::vector<FileSystemEvent>& out) -> bool;
+    auto decide(const Check& check, FileSystemEvent& event) -> bool;
+    auto forget(const std::string& path) -> void;
+    auto work() -> void;
+    auto inspect(Check& check, std::vector<char>& buffer) -> void;
+
+    ContentCheck mCheck;
+    int mCompletedFd;
+    std::unordered_map<std::string, Baselines> mBaselines;
+    std::unordered_map<std::string, std::vector<FileSystemEvent>> mWaiting;
+
+    std::mutex mMutex;
+    std::condition_variable mWakeup;
+    std::deque<Check> mChecks;
+    std::vector<Check> mCompleted;
+    std::vector<Check> mCollected;
+    bool mStopped;
+    std::vector<std::thread> mWorkers;
+};
+}
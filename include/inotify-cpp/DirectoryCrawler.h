@@ -0,0 +1,53 @@
+#pragma once
+#include <boost/filesystem.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <functional>
+
+namespace inotify {
+
+enum class EntryType { directory, symlink, file };
+
+/**
+ * @brief Counters of a single crawl
+ */
+struct CrawlStatistics {
+    std::size_t directories;
+    std::size_t symlinks;
+    std::size_t files;
+    std::size_t skipped;
+    std::size_t errors;
+    std::size_t failedWatches; ///< filled by Inotify, entries that could not be watched
+    std::chrono::milliseconds duration;
+};
+
+/**
+ * @brief Walks a directory tree to find everything that has to be watched.
+ *
+ * Entries are read with getdents64 and classified by their d_type, thus
+ * files are never stat'ed. Ignored directories are skipped before they
+ * are descended. Symlinks are reported and followed if they point to a
+ * directory, every directory is entered only once.
+ *
+ * The walk can be spread over several threads. The visitor is always
+ * called on the thread calling crawl, one entry after the other, while
+ * the workers continue walking.
+ */
+class DirectoryCrawler {
+  public:
+    using Filter = std::function<bool(boost::string_ref path)>;
+    using Visitor = std::function<void(const boost::filesystem::path& path, EntryType type)>;
+
+    explicit DirectoryCrawler(std::size_t threads = 1);
+
+    auto setReportFiles(bool reportFiles) -> DirectoryCrawler&;
+    auto crawl(const boost::filesystem::path& root, Filter isIgnored, Visitor visitor)
+        -> CrawlStatistics;
+
+  private:
+    std::size_t mThreads;
+    bool mReportFiles;
+};
+}
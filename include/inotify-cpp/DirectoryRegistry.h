@@ -0,0 +1,107 @@
+#pragma once
+#include <boost/filesystem.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+namespace inotify {
+
+/**
+ * @brief Registry of watched paths and their watch descriptors.
+ *
+ * Paths are stored as a tree of path components. Each node only keeps
+ * its parent, its siblings and the id of its interned name, thus
+ * common prefixes of deep trees are stored once. Full paths are
+ * rebuilt on demand and cached for recently used watch descriptors.
+ *
+ * Watch descriptors are small dense integers handed out by the kernel,
+ * thus they index a flat table of tree nodes. Children are found by an
+ * open addressing hash of (parent, name).
+ */
+class DirectoryRegistry {
+  public:
+    // Watch was added by a recursive watch
+    static constexpr std::uint32_t recursive = 1;
+    // Watch was removed, the entry is kept until views of it are gone
+    static constexpr std::uint32_t removed = 2;
+
+    DirectoryRegistry();
+
+    void insert(int wd, const boost::filesystem::path& path, std::uint32_t flags = 0);
+    void erase(int wd);
+    bool rename(const boost::filesystem::path& from, const boost::filesystem::path& to);
+    void clear();
+    bool contains(int wd) const;
+    auto flags(int wd) const -> std::uint32_t;
+    void setFlags(int wd, std::uint32_t flags);
+    auto path(int wd) const -> boost::filesystem::path;
+    void assignPath(int wd, boost::filesystem::path& path) const;
+    auto find(const boost::filesystem::path& path) const -> int;
+    auto subtree(const boost::filesystem::path& path) const -> std::vector<int>;
+    auto subtree(int wd) const -> std::vector<int>;
+    auto size() const -> std::size_t;
+    auto removedSize() const -> std::size_t;
+    auto watches() const -> std::vector<int>;
+
+  private:
+    struct Node {
+        std::uint32_t parent;
+        std::uint32_t name;
+        std::uint32_t firstChild;
+        std::uint32_t nextSibling;
+        std::uint32_t previousSibling;
+        int wd;
+    };
+
+    struct CachedPath {
+        int wd;
+        boost::filesystem::path path;
+    };
+
+    struct NameHash {
+        std::size_t operator()(boost::string_ref name) const;
+    };
+
+    auto cachedPath(int wd) const -> const boost::filesystem::path&;
+    auto findNode(const boost::filesystem::path& path) const -> std::uint32_t;
+    auto findChild(std::uint32_t parent, std::uint32_t name) const -> std::uint32_t;
+    auto findName(boost::string_ref name) const -> std::uint32_t;
+    auto addChild(std::uint32_t parent, boost::string_ref name) -> std::uint32_t;
+    auto internName(boost::string_ref name) -> std::uint32_t;
+    void releaseName(std::uint32_t name);
+    void releaseNode(std::uint32_t node);
+    void unlinkNode(std::uint32_t node);
+    void linkNode(std::uint32_t node, std::uint32_t parent);
+    void prune(std::uint32_t node);
+    void buildPath(std::uint32_t node, std::string& path) const;
+    void collectSubtree(std::uint32_t node, std::vector<int>& wds) const;
+
+    auto slot(std::uint32_t parent, std::uint32_t name) const -> std::size_t;
+    void insertSlot(std::uint32_t node);
+    void eraseSlot(std::uint32_t node);
+    void growSlots();
+
+    // Tree of path components, node 0 is the root above all paths
+    std::vector<Node> mNodes;
+    std::vector<std::uint32_t> mFreeNodes;
+    std::vector<std::uint32_t> mSlots;
+    std::size_t mUsedSlots;
+
+    // Interned names, the deque keeps the strings at stable addresses
+    std::deque<std::string> mNames;
+    std::vector<std::uint32_t> mNameReferences;
+    std::vector<std::uint32_t> mFreeNames;
+    std::unordered_map<boost::string_ref, std::uint32_t, NameHash> mNameIds;
+
+    std::vector<std::uint32_t> mWatchNodes;
+    std::vector<std::uint32_t> mWatchFlags;
+    std::size_t mSize;
+    std::size_t mRemovedSize;
+
+    mutable std::vector<CachedPath> mPathCache;
+};
+}
@@ -0,0 +1,60 @@
+#pragma once
+#include <boost/filesystem.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <cstdint>
+#include <functional>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+namespace inotify {
+
+/**
+ * @brief Last known state of a watched path, used to recover from
+ *        lost events.
+ *
+ * A snapshot of a watched directory holds the names, types, sizes and
+ * modification times of its entries, the one of a watched file only
+ * the file itself. Events keep the names up to date, entries an event
+ * reported changes on are marked as touched. After the kernel dropped
+ * events, rescan compares the snapshot with the file system and
+ * reports the differences. Directories whose modification time did not
+ * change are not listed again, only their known entries are stat'ed.
+ */
+class DirectorySnapshots {
+  public:
+    struct Entry {
+        std::uint64_t mtime;
+        std::uint64_t size;
+        bool directory;
+    };
+
+    struct Snapshot {
+        std::uint64_t mtime;
+        std::uint64_t size;
+        bool directory;
+        std::unordered_map<std::string, Entry> entries;
+    };
+
+    using Change = std::function<void(std::uint32_t mask, const std::string& name)>;
+
+    /// Modification time of entries whose change was reported by an event
+    static constexpr std::uint64_t touched = UINT64_MAX;
+
+    auto take(int wd, const boost::filesystem::path& path) -> bool;
+    auto update(int wd, std::uint32_t mask, boost::string_ref name) -> void;
+    auto rescan(int wd, const boost::filesystem::path& path, const Change& onChange) -> bool;
+    auto erase(int wd) -> void;
+    auto clear() -> void;
+    auto contains(int wd) const -> bool;
+    auto watches() const -> std::vector<int>;
+    auto size() const -> std::size_t;
+
+  private:
+    static auto scan(const boost::filesystem::path& path, bool listEntries, Snapshot& snapshot)
+        -> bool;
+
+    std::unordered_map<int, Snapshot> mSnapshots;
+};
+}
@@ -0,0 +1,85 @@
+#pragma once
+#include <inotify-cpp/FileSystemEvent.h>
+
+#include <boost/optional.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace inotify {
+
+/**
+ * @brief Merges bursts of events on the same path into one event.
+ *
+ * Events are keyed by watch descriptor and path. The first event on a
+ * key is held back, later ones within the quiet period are merged into
+ * its mask and restart the period. The merged event is emitted once the
+ * path was quiet for the whole period, or immediately on close_write
+ * and remove events. Move, ignored and overflow events are never
+ * merged, they flush a pending event on their key and pass through.
+ *
+ * Pending events are scheduled on a timing wheel, thus scheduling,
+ * rescheduling and expiring a path is constant time no matter how many
+ * paths are pending. The keys are found by an open addressing hash of
+ * the pending entries, it refers to the events themselves, thus
+ * coalescing does not allocate once the tables have grown.
+ */
+class EventCoalescer {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit EventCoalescer(std::chrono::milliseconds quietPeriod = std::chrono::milliseconds(0));
+
+    auto setQuietPeriod(std::chrono::milliseconds quietPeriod) -> void;
+    auto enabled() const -> bool;
+    auto process(FileSystemEvent&& event, Clock::time_point now, std::vector<FileSystemEvent>& out)
+        -> bool;
+    auto flushExpired(Clock::time_point now, std::vector<FileSystemEvent>& out) -> void;
+    auto flushAll(std::vector<FileSystemEvent>& out) -> void;
+    auto nextDeadline() const -> boost::optional<Clock::time_point>;
+    auto pending() const -> std::size_t;
+
+  private:
+    static constexpr std::size_t wheelSize = 256;
+    static constexpr std::uint32_t noEntry = UINT32_MAX;
+
+    struct Entry {
+        FileSystemEvent event;
+        // Of wd and path, the home slot of the entry
+        std::size_t hash;
+        Clock::time_point deadline;
+        std::uint64_t tick;
+        std::uint32_t previous;
+        std::uint32_t next;
+    };
+
+    struct Slot {
+        std::uint32_t head;
+        std::uint32_t tail;
+    };
+
+    auto tickOf(Clock::time_point time) const -> std::uint64_t;
+    auto schedule(std::uint32_t entry) -> void;
+    auto unschedule(std::uint32_t entry) -> void;
+    auto emit(std::uint32_t entry, std::vector<FileSystemEvent>& out) -> void;
+
+    static auto hashOf(int wd, const std::string& path) -> std::size_t;
+    auto findEntry(int wd, const std::string& path, std::size_t hash) const -> std::uint32_t;
+    auto insertSlot(std::uint32_t entry) -> void;
+    auto eraseSlot(std::uint32_t entry) -> void;
+    auto growSlots() -> void;
+
+    std::chrono::milliseconds mQuietPeriod;
+    Clock::duration mTick;
+    Clock::time_point mOrigin;
+    std::uint64_t mCurrentTick;
+    std::vector<Slot> mWheel;
+    std::vector<Entry> mEntries;
+    std::vector<std::uint32_t> mFreeEntries;
+    // Pending entries by the hash of their key, noEntry marks free slots
+    std::vector<std::uint32_t> mSlots;
+    std::size_t mPending;
+};
+}
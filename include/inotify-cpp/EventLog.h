@@ -0,0 +1,93 @@
+#pragma once
+#include <boost/filesystem.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <chrono>
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+namespace inotify {
+
+/**
+ * @brief How fast recorded events are replayed
+ */
+enum class ReplaySpeed {
+    original, ///< with the delays between the reads they were recorded with
+    maximum ///< every read right after the previous one
+};
+
+/**
+ * @brief Record of an EventLog, a change of the registry of watched
+ *        paths or one buffer of raw events
+ */
+struct EventLogRecord {
+    enum Type : std::uint32_t { watch = 1, remove = 2, events = 3 };
+
+    Type type;
+    std::chrono::nanoseconds time; ///< since the recording started
+    int wd; ///< of watch and remove
+    std::uint32_t flags; ///< DirectoryRegistry flags of watch
+    boost::string_ref path; ///< of watch
+    const char* buffer; ///< of events, inotify_event structs as they were parsed
+    std::size_t length;
+};
+
+/**
+ * @brief Writes the raw event stream of an Inotify and the changes of
+ *        its registry to a binary log, which can be replayed later
+ *        without touching the kernel.
+ *
+ * The file is a header followed by records, each a fixed size header
+ * with the time, type and size of its payload and the payload padded
+ * to 8 bytes, thus the events of a replayed log are aligned in place.
+ * Event buffers are written as they were parsed, their watch
+ * descriptors refer to the preceding watch records. The records are
+ * in the byte order of the machine that wrote them.
+ *
+ * Records are buffered, the log is complete once close returns.
+ */
+class EventLogWriter {
+  public:
+    EventLogWriter();
+    ~EventLogWriter();
+
+    EventLogWriter(const EventLogWriter&) = delete;
+    EventLogWriter& operator=(const EventLogWriter&) = delete;
+
+    auto open(const boost::filesystem::path& file) -> bool;
+    auto watch(int wd, std::uint32_t flags, const boost::filesystem::path& path) -> void;
+    auto remove(int wd) -> void;
+    auto events(const char* buffer, std::size_t length) -> void;
+    auto close() -> bool;
+
+  private:
+    auto appendHeader(EventLogRecord::Type type, std::size_t size) -> void;
+    auto appendBytes(const void* data, std::size_t size) -> void;
+    auto flush() -> void;
+
+    int mFd;
+    bool mFailed;
+    int mError;
+    std::chrono::steady_clock::time_point mStart;
+    std::vector<char> mBuffer;
+};
+
+/**
+ * @brief Reads a log written by EventLogWriter into memory. Every
+ *        record is checked on load, a truncated or foreign file is
+ *        rejected instead of replayed out of bounds.
+ */
+class EventLogReader {
+  public:
+    auto load(const boost::filesystem::path& file) -> bool;
+    auto records() const -> const std::vector<EventLogRecord>&;
+
+  private:
+    auto validate(std::size_t size) -> bool;
+
+    // 8 byte words, the events of the records are aligned
+    std::vector<std::uint64_t> mData;
+    std::vector<EventLogRecord> mRecords;
+};
+}
@@ -0,0 +1,80 @@
+#pragma once
+#include <inotify-cpp/FileSystemEvent.h>
+
+#include <array>
+#include <atomic>
+#include <cstdint>
+#include <deque>
+#include <string>
+#include <unordered_map>
+
+namespace inotify {
+
+/**
+ * @brief Lane of an event in a bounded EventQueue
+ */
+enum class EventPriority {
+    critical, ///< the watch or the queue itself changed, e.g. delete_self, unmount, overflow
+    normal,
+    low ///< access, open and close_nowrite only
+};
+
+/**
+ * @brief What a full EventQueue does with new events
+ */
+enum class Shedding {
+    none, ///< unbounded, a single lane in the order the events were read
+    drop, ///< drop the oldest event of a lower lane, or the new event if there is none
+    collapse ///< merge low events into a queued low event on the same path first, then drop
+};
+
+/**
+ * @brief Queue of the events read but not yet returned by getNextEvent.
+ *
+ * A bounded queue has one lane per EventPriority and returns the
+ * events of higher lanes first, within a lane the events keep their
+ * order. Once it holds its capacity, new events shed low events before
+ * normal ones, critical events are never shed and may exceed the
+ * capacity. Shed and collapsed events are counted.
+ *
+ * Without shedding the queue is a plain FIFO.
+ */
+class EventQueue {
+  public:
+    explicit EventQueue(std::size_t capacity = 0, Shedding shedding = Shedding::none);
+
+    EventQueue(const EventQueue&) = delete;
+    EventQueue& operator=(const EventQueue&) = delete;
+
+    static auto priorityOf(std::uint32_t mask) -> EventPriority;
+
+    auto setCapacity(std::size_t capacity, Shedding shedding) -> void;
+    auto bounded() const -> bool;
+    auto capacity() const -> std::size_t;
+    auto push(FileSystemEvent&& event) -> void;
+    auto pop() -> FileSystemEvent;
+    auto empty() const -> bool;
+    auto size() const -> std::size_t;
+    auto getShedEvents(EventPriority priority) const -> std::uint64_t;
+    auto getCollapsedEvents() const -> std::uint64_t;
+
+  private:
+    static constexpr std::size_t lanes = 3;
+
+    auto collapse(const FileSystemEvent& event) -> bool;
+    auto popLane(std::size_t lane) -> FileSystemEvent;
+
+    std::size_t mCapacity;
+    Shedding mShedding;
+    std::array<std::deque<FileSystemEvent>, lanes> mLanes;
+    std::size_t mSize;
+
+    // Sequence number of the newest low event per path, the low lane
+    // front has mLowFront
+    std::unordered_map<std::string, std::uint64_t> mLowEvents;
+    std::uint64_t mLowFront;
+
+    std::array<std::atomic<std::uint64_t>, lanes> mShed;
+    std::atomic<std::uint64_t> mCollapsed;
+};
+}
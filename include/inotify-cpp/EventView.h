@@ -0,0 +1,52 @@
+#pragma once
+#include <inotify-cpp/DirectoryRegistry.h>
+
+#include <boost/filesystem.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <cstdint>
+
+namespace inotify {
+
+/**
+ * @brief Lightweight, non owning view on a single raw inotify event.
+ *
+ * The name refers directly into the read buffer of Inotify and the
+ * directory is the interned entry in its registry of watched paths,
+ * thus a view is only valid until the next event is read. The
+ * directory and full path are only built on request. Views of events
+ * reported by a fanotify mark refer to the cached directory instead.
+ */
+class EventView {
+  public:
+    EventView(
+        int wd,
+        uint32_t mask,
+        uint32_t cookie,
+        boost::string_ref name,
+        const DirectoryRegistry& directories);
+    EventView(
+        int wd,
+        uint32_t mask,
+        uint32_t cookie,
+        boost::string_ref name,
+        const boost::filesystem::path& directory);
+
+    auto directory() const -> boost::filesystem::path;
+    auto assignDirectory(boost::filesystem::path& directory) const -> void;
+    auto path() const -> boost::filesystem::path;
+    auto assignPath(boost::filesystem::path& path) const -> void;
+
+  public: // Member
+    int wd;
+    uint32_t mask;
+    uint32_t cookie;
+    boost::string_ref name;
+    // Watch group of the watch, 0 for the default group
+    uint32_t group;
+
+  private:
+    const DirectoryRegistry* mDirectories;
+    const boost::filesystem::path* mDirectory;
+};
+}
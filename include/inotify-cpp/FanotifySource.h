@@ -0,0 +1,79 @@
+#pragma once
+#include <boost/filesystem.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+struct file_handle;
+
+namespace inotify {
+
+/**
+ * @brief Reports the events of a whole filesystem or mount through a
+ *        single fanotify mark instead of one inotify watch per
+ *        directory.
+ *
+ * Events identify their directory by a file handle
+ * (FAN_REPORT_DFID_NAME). A handle is resolved to a path only when an
+ * event refers to it, the result is cached. Directories outside of the
+ * root are cached as well, their events are dropped without resolving
+ * them again. Renaming a directory invalidates the whole cache, it is
+ * refilled on demand. Events are translated to inotify masks, merged
+ * events are split into one event per bit.
+ *
+ * Needs CAP_SYS_ADMIN and Linux 5.9. Renames are paired through
+ * FAN_RENAME on Linux 5.17 and later, earlier kernels report unpaired
+ * moved_from and moved_to halves. Mount marks only support access,
+ * modify, open and close events.
+ */
+class FanotifySource {
+  public:
+    enum class Mark {
+        filesystem, ///< FAN_MARK_FILESYSTEM, all mounts of the filesystem
+        mount ///< FAN_MARK_MOUNT, only the mount containing the root
+    };
+
+    struct Event {
+        std::uint32_t mask;
+        std::uint32_t cookie;
+        const boost::filesystem::path* directory; ///< nullptr for overflows
+        boost::string_ref name;
+    };
+
+    /// Watch descriptor of all events reported by a mark
+    static constexpr int markWd = -2;
+
+    FanotifySource(const boost::filesystem::path& root, Mark mark, std::uint32_t eventMask);
+    ~FanotifySource();
+
+    FanotifySource(const FanotifySource&) = delete;
+    FanotifySource& operator=(const FanotifySource&) = delete;
+
+    auto setEventMask(std::uint32_t eventMask) -> void;
+    auto read(std::vector<Event>& events) -> bool;
+    auto getFileDescriptor() const -> int;
+    auto root() const -> const boost::filesystem::path&;
+    auto cachedDirectories() const -> std::size_t;
+
+  private:
+    auto kernelMask(std::uint32_t eventMask) const -> std::uint64_t;
+    auto mark(unsigned int flags, std::uint64_t mask) -> int;
+    auto resolve(const char* fsid, const file_handle* handle) -> const boost::filesystem::path*;
+    auto retireDirectories() -> void;
+
+    int mFanotifyFd;
+    int mMountFd;
+    Mark mMark;
+    boost::filesystem::path mRoot;
+    bool mRenameEvents;
+    std::uint64_t mKernelMask;
+    std::uint32_t mNextCookie;
+    std::vector<char> mBuffer;
+    std::unordered_map<std::string, std::unique_ptr<boost::filesystem::path>> mDirectories;
+    std::vector<std::unique_ptr<boost::filesystem::path>> mRetiredDirectories;
+};
+}
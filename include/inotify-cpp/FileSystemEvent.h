@@ -1,18 +1,41 @@
 #pragma once
 #include <boost/filesystem.hpp>
+#include <boost/optional.hpp>
 
+#include <ctime>
 #include <string>
 
 namespace inotify {
+
+/**
+ * @brief Metadata of the file an event refers to, as
+ *        returned by stat at the time it was requested.
+ */
+struct FileAttributes {
+    boost::filesystem::file_type type;
+    std::uintmax_t size;
+    std::time_t lastWriteTime;
+};
+
 class FileSystemEvent {
   public:
-    FileSystemEvent(int wd, uint32_t mask, const boost::filesystem::path path);
+    FileSystemEvent(int wd, uint32_t mask, boost::filesystem::path path, uint32_t cookie = 0);
 
-    ~FileSystemEvent();
+    auto attributes() const -> const boost::optional<FileAttributes>&;
+    auto reuse(int wd, uint32_t mask, uint32_t cookie) -> void;
 
   public: // Member
     int wd;
     uint32_t mask;
+    uint32_t cookie;
     boost::filesystem::path path;
+    // Source of a paired rename, empty for all other events
+    boost::filesystem::path oldPath;
+    // Watch group of the path, 0 for the default group
+    uint32_t group;
+
+  private:
+    mutable bool mAttributesLoaded;
+    mutable boost::optional<FileAttributes> mAttributes;
 };
-}
\ No newline at end of file
+}
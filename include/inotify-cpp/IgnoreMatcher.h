@@ -0,0 +1,77 @@
+#pragma once
+#include <boost/filesystem.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <cstdint>
+#include <string>
+#include <utility>
+#include <vector>
+
+namespace inotify {
+
+/**
+ * @brief Decides whether paths are ignored.
+ *
+ * Substring rules ignore every path that contains the rule. They are
+ * compiled into an Aho-Corasick automaton, so one match costs
+ * O(path length) independent of the number of rules. Rules added by
+ * ignoreOnce are removed after they matched the first time, matching
+ * once rules take precedence over permanent ones.
+ *
+ * Glob rules (*, ? and [...]) are matched against the file name of
+ * the path.
+ *
+ * The automaton is rebuilt lazily on the next match after the
+ * rules changed. matchesPermanent does not modify the matcher and
+ * can be called from several threads once the matcher is compiled.
+ */
+class IgnoreMatcher {
+  public:
+    IgnoreMatcher();
+
+    void ignore(const std::string& rule);
+    void ignoreOnce(const std::string& rule);
+    void ignorePattern(const std::string& pattern);
+    bool empty() const;
+    bool hasOnceRules() const;
+
+    bool matches(boost::string_ref path);
+    bool matches(const boost::filesystem::path& directory, boost::string_ref name);
+    bool matchesPermanent(boost::string_ref path) const;
+    void compile();
+
+    static bool globMatch(boost::string_ref pattern, boost::string_ref text);
+
+  private:
+    enum class Kind : std::uint8_t { permanent, once, pattern };
+
+    struct Rule {
+        std::string text;
+        Kind kind;
+    };
+
+    struct Node {
+        std::vector<std::pair<unsigned char, int>> next;
+        int fail;
+        int outputLink;
+        std::vector<int> rules;
+    };
+
+    struct MatchState {
+        int node;
+        bool permanent;
+        int firstOnce;
+    };
+
+    int transition(int node, unsigned char c) const;
+    void feed(MatchState& state, boost::string_ref text) const;
+    void collect(MatchState& state, int node) const;
+    bool finish(MatchState& state, boost::string_ref fileName);
+    int findChild(int node, unsigned char c) const;
+
+    std::vector<Rule> mRules;
+    std::vector<Node> mNodes;
+    std::size_t mOnceRules;
+    bool mDirty;
+};
+}
@@ -8,26 +8,43 @@
 #include <assert.h>
 #include <boost/filesystem.hpp>
 #include <boost/optional.hpp>
-#include <boost/bimap.hpp>
+#include <boost/system/error_code.hpp>
 #include <errno.h>
 #include <exception>
+#include <functional>
 #include <map>
 #include <memory>
 #include <queue>
 #include <sstream>
 #include <string>
+#include <sys/epoll.h>
+#include <sys/eventfd.h>
 #include <sys/inotify.h>
 #include <time.h>
+#include <type_traits>
+#include <unordered_map>
+#include <unistd.h>
 #include <vector>
 #include <chrono>
 #include <thread>
 #include <atomic>
 
+#include <inotify-cpp/ContentFilter.h>
+#include <inotify-cpp/DirectoryCrawler.h>
+#include <inotify-cpp/DirectoryRegistry.h>
+#include <inotify-cpp/DirectorySnapshots.h>
+#include <inotify-cpp/EventCoalescer.h>
+#include <inotify-cpp/EventLog.h>
+#include <inotify-cpp/EventQueue.h>
+#include <inotify-cpp/EventView.h>
+#include <inotify-cpp/FanotifySource.h>
 #include <inotify-cpp/FileSystemEvent.h>
+#include <inotify-cpp/IgnoreMatcher.h>
+#include <inotify-cpp/RenameMatcher.h>
+#include <inotify-cpp/Statistics.h>
+#include <inotify-cpp/WatchState.h>
 
-#define MAX_EVENTS     4096
 #define EVENT_SIZE     (sizeof (inotify_event))
-#define EVENT_BUF_LEN  (MAX_EVENTS * (EVENT_SIZE + 16))
 
 namespace fs = boost::filesystem;
 
@@ -40,7 +57,9 @@ namespace fs = boost::filesystem;
  * folders will be watched by watchFolderRecursively or
  * files by watchFile. If there are changes inside this
  * folder or files events will be raised. This events
- * can be get by getNextEvent.
+ * can be get by getNextEvent or in batches by
+ * getNextEvents. getNextEventViews returns non owning
+ * views on the raw events without allocating.
  *
  * @eventMask
  *
@@ -75,36 +94,200 @@ class Inotify {
   Inotify();
   ~Inotify();
   void watchDirectoryRecursively(fs::path path);
+  void watchDirectoryRecursively(fs::path path, boost::system::error_code& error);
   void watchFile(fs::path file);
+  void watchFile(fs::path file, boost::system::error_code& error);
+  std::vector<boost::system::error_code>
+  watchFiles(const std::vector<fs::path>& paths, uint32_t watchMask = 0);
+  void watchFilesystem(fs::path path);
+  void watchMount(fs::path path);
+  void saveWatchState(const fs::path& file);
+  bool restoreWatchState(const fs::path& file);
+  bool restoreWatchState(const fs::path& file, const fs::path& root);
+  void recordEvents(const fs::path& file);
+  void stopRecording();
+  void replayEvents(const fs::path& file, ReplaySpeed speed = ReplaySpeed::original);
+  void setCrawlThreads(std::size_t threads);
+  void setAutoRecursive(bool autoRecursive);
+  void setRenamePairingWindow(std::chrono::milliseconds window);
+  void setCoalescingPeriod(std::chrono::milliseconds quietPeriod);
+  void setContentCheck(ContentCheck check, std::size_t threads = 1);
+  void setEventQueue(std::size_t capacity, Shedding shedding);
+  void setOverflowRecovery(bool recovery);
+  void setOverflowObserver(std::function<void(const QueueOverflow&)> onOverflow);
+  std::size_t getOverflowCount();
+  EventStatistics getStatistics() const;
+  static std::size_t getMaxWatches();
+  static std::size_t getMaxQueuedEvents();
+  void setInotifyInstances(std::size_t instances);
+  std::size_t getInotifyInstances();
+  CrawlStatistics getCrawlStatistics();
   void unwatchFile(fs::path file);
+  void unwatchDirectoryRecursively(fs::path path);
+  std::size_t getWatchCount();
   void ignoreFileOnce(fs::path file);
   void ignoreFile(fs::path file);
+  void ignorePattern(const std::string& pattern);
+  void ignoreFile(fs::path file, std::uint32_t group);
+  void ignorePattern(const std::string& pattern, std::uint32_t group);
+  std::uint32_t addWatchGroup(const std::string& name);
+  void setWatchGroup(const fs::path& path, std::uint32_t group);
+  void setGroupEventMask(std::uint32_t group, uint32_t eventMask);
+  std::uint32_t getWatchGroup(const fs::path& path) const;
+  const std::string& getWatchGroupName(std::uint32_t group) const;
   void setEventMask(uint32_t eventMask);
+  void setEventMask(const fs::path& path, uint32_t eventMask);
   uint32_t getEventMask();
-  void setEventTimeout(std::chrono::milliseconds eventTimeout, std::function<void(FileSystemEvent)> onEventTimeout);
+  uint32_t getEventMask(const fs::path& path);
+  void setMaxEvents(std::size_t maxEvents);
+  std::size_t getMaxEvents();
+  void setEventTimeout(std::chrono::milliseconds eventTimeout, std::function<void(const FileSystemEvent&)> onEventTimeout);
   boost::optional<FileSystemEvent> getNextEvent();
+  std::size_t getNextEvents(std::vector<FileSystemEvent>& events);
+  std::size_t getNextEventViews(std::vector<EventView>& views);
+  std::size_t tryGetEvents(std::vector<FileSystemEvent>& events);
+  int getFileDescriptor();
+  int getNextTimeout();
   void stop();
   bool hasStopped();
 
 private:
+  // Only kernel events change the watches, replayed events only rename them
+  enum class EventOrigin { kernel, synthetic, replay };
+
   fs::path wdToPath(int wd);
-  bool isIgnored(std::string file);
+  bool isIgnored(const EventView& view);
+  bool isIgnored(const fs::path& file);
+  bool isIgnoredPermanently(boost::string_ref path) const;
+  void checkWatchGroup(std::uint32_t group) const;
+  IgnoreMatcher& watchGroupIgnores(std::uint32_t group);
+  void compileIgnoreMatchers();
+  uint32_t groupEventMask(std::uint32_t group) const;
   bool onTimeout(const std::chrono::steady_clock::time_point& eventTime);
+  void addWatch(const fs::path& path, std::uint32_t flags = 0);
+  boost::system::error_code
+  tryAddWatch(const fs::path& path, std::uint32_t flags, std::uint32_t watchMask);
+  void throwWatchError(const fs::path& path, const boost::system::error_code& error);
+  int addWatchDescriptor(const fs::path& path, std::uint32_t flags, std::uint32_t watchMask = 0);
+  void watchNewDirectory(int wd, uint32_t mask, boost::string_ref name);
+  void recoverFromOverflow(std::uint64_t parsed);
+  void reportOverflow(std::uint64_t overflows, std::uint64_t parsed);
+  bool renameDirectory(const inotify_event& event);
+  void appendSyntheticEvent(int wd, uint32_t mask, uint32_t cookie, boost::string_ref name);
+  void restoreDirectory(
+      const WatchState& state,
+      std::uint32_t index,
+      const fs::path& path,
+      std::vector<std::pair<std::uint32_t, fs::path>>& directories);
   void removeWatch(int wd);
+  void removeSubtreeLater(int wd);
+  uint32_t internalEventMask(std::uint32_t flags) const;
+  void applyEventMasks();
   void init();
+  void addInotifyInstance();
+  void addFanotifySource(const fs::path& path, FanotifySource::Mark mark);
+  uint32_t fanotifyEventMask();
+  int shardOf(int wd) const;
+  int kernelWd(int wd) const;
+  int removeKernelWatch(int wd);
+  void translateWatchDescriptors(char* buffer, std::size_t length, std::size_t shard);
+  bool waitForEvents(int timeout);
+  int pendingTimeout() const;
+  int replayTimeout() const;
+  std::size_t findReplayedEvents(std::size_t position) const;
+  void applyReplayedRecords();
+  void replayWatch(const EventLogRecord& record);
+  bool readEvents(std::vector<FileSystemEvent>& events, bool block);
+  bool fillEventQueue();
+  std::size_t takeQueuedEvents(std::vector<FileSystemEvent>& events);
+  FileSystemEvent makeEvent(const EventView& view);
+  void recycleEvents(std::vector<FileSystemEvent>& events);
+  bool readEventViews(std::vector<EventView>& views, int timeout);
+  void parseEvents(
+      const char* buffer,
+      std::size_t length,
+      EventOrigin origin,
+      const std::chrono::steady_clock::time_point& currentEventTime,
+      std::vector<EventView>& views);
+  void parseFanotifyEvents(
+      const std::chrono::steady_clock::time_point& currentEventTime,
+      std::vector<EventView>& views);
+  char* eventBuffer(std::size_t shard);
+
+  struct WatchGroup {
+    std::string name;
+    boost::optional<uint32_t> eventMask;
+    IgnoreMatcher ignores;
+  };
+
+  using EventBufferBlock = std::aligned_storage<EVENT_SIZE, alignof(inotify_event)>::type;
 
   // Member
   int mError;
   std::chrono::milliseconds mEventTimeout;
   std::chrono::steady_clock::time_point mLastEventTime;
   uint32_t mEventMask;
-  uint32_t mThreadSleep;
-  std::vector<std::string> mIgnoredDirectories;
-  std::vector<std::string> mOnceIgnoredDirectories;
-  std::queue<FileSystemEvent> mEventQueue;
-  boost::bimap<int, fs::path> mDirectorieMap;
-  int mInotifyFd;
+  std::vector<std::pair<fs::path, uint32_t>> mPathEventMasks;
+  std::vector<uint32_t> mWatchMasks;
+  std::vector<uint32_t> mKernelMasks;
+  // Events a watch got through IN_MASK_ADD on top of its mask
+  std::vector<uint32_t> mAddedMasks;
+  bool mEventMasksChanged;
+  IgnoreMatcher mIgnoreMatcher;
+  // Directory of the view checked by isIgnored, reused between events
+  fs::path mIgnoredDirectory;
+  // Group 0 is the default group, its mask and rules are the ones above
+  std::vector<WatchGroup> mGroups;
+  std::vector<std::pair<fs::path, std::uint32_t>> mGroupRoots;
+  std::vector<std::uint32_t> mWatchGroups;
+  EventQueue mEventQueue;
+  std::vector<FileSystemEvent> mEventBatch;
+  std::vector<EventView> mEventViews;
+  DirectoryRegistry mDirectories;
+  std::size_t mCrawlThreads;
+  CrawlStatistics mCrawlStatistics;
+  bool mAutoRecursive;
+  bool mOverflowRecovery;
+  std::function<void(const QueueOverflow&)> mOnOverflow;
+  std::chrono::steady_clock::time_point mLastOverflowTime;
+  std::uint64_t mLastOverflowEvents;
+  EventCounters mCounters;
+  bool mGrowEventBuffer;
+  DirectorySnapshots mSnapshots;
+  std::vector<int> mInotifyFds;
+  std::size_t mNextShard;
+  std::vector<std::size_t> mReadLengths;
+  std::vector<std::size_t> mReadyShards;
+  std::vector<epoll_event> mEpollEvents;
+  std::vector<std::unique_ptr<FanotifySource>> mFanotifySources;
+  std::vector<FanotifySource::Event> mFanotifyEvents;
+  int mEpollFd;
+  int mStopFd;
   std::atomic<bool> stopped;
-  std::function<void(FileSystemEvent)> mOnEventTimeout;
+  std::size_t mMaxEvents;
+  std::size_t mEventBufferSize;
+  std::vector<EventBufferBlock> mEventBuffer;
+  std::vector<char> mSyntheticEvents;
+  std::vector<char> mRestoredEvents;
+  std::vector<char> mPendingRestoredEvents;
+  std::vector<int> mPendingRemovals;
+  std::unordered_map<uint32_t, fs::path> mDirectoryMoves;
+  std::unordered_map<uint32_t, fs::path> mPreviousDirectoryMoves;
+  RenameMatcher mRenameMatcher;
+  EventCoalescer mEventCoalescer;
+  std::vector<FileSystemEvent> mStagedEvents;
+  std::unique_ptr<ContentFilter> mContentFilter;
+  std::vector<FileSystemEvent> mCheckedEvents;
+  bool mContentChecksReady;
+  std::vector<FileSystemEvent> mSpareEvents;
+  std::unique_ptr<EventLogWriter> mEventLogWriter;
+  std::unique_ptr<EventLogReader> mEventLogReader;
+  ReplaySpeed mReplaySpeed;
+  std::chrono::steady_clock::time_point mReplayStart;
+  // Next registry record to apply and next buffer of events to parse
+  std::size_t mReplayPosition;
+  std::size_t mNextReplayedEvents;
+  bool mReplayReady;
+  std::function<void(const FileSystemEvent&)> mOnEventTimeout;
 };
 }
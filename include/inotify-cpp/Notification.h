@@ -4,10 +4,16 @@
 
 #include <boost/filesystem.hpp>
 
+#include <cstdint>
+
 namespace inotify {
 
 struct Notification {
     Event event;
     boost::filesystem::path path;
+    // Source path of a paired rename (Event::move)
+    boost::filesystem::path oldPath;
+    // Watch group of the path, 0 for the default group
+    std::uint32_t group = 0;
 };
 }
\ No newline at end of file
@@ -0,0 +1,72 @@
+#pragma once
+#include <inotify-cpp/Notification.h>
+
+#include <boost/lockfree/spsc_queue.hpp>
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace inotify {
+
+/**
+ * @brief What submit does if the queue of a worker is full
+ */
+enum class Backpressure {
+    block, ///< wait until the worker made space
+    drop ///< drop the notification and count it
+};
+
+/**
+ * @brief Runs observers on a pool of worker threads.
+ *
+ * Every worker owns a bounded single producer single consumer queue
+ * fed by the reading thread. Notifications are sharded by the hash of
+ * their path, thus the notifications of one path are handled by the
+ * same worker in the order they were read, while slow observers on one
+ * path do not hold back the reading thread or other paths.
+ *
+ * submit must always be called by the same thread.
+ */
+class NotificationExecutor {
+  public:
+    using Dispatch = std::function<void(std::size_t worker, const Notification&)>;
+
+    NotificationExecutor(
+        std::size_t threads, std::size_t queueDepth, Backpressure backpressure, Dispatch dispatch);
+    ~NotificationExecutor();
+
+    NotificationExecutor(const NotificationExecutor&) = delete;
+    NotificationExecutor& operator=(const NotificationExecutor&) = delete;
+
+    auto submit(const Notification& notification) -> bool;
+    auto stop() -> void;
+    auto getDroppedNotifications() const -> std::size_t;
+
+  private:
+    struct Worker {
+        explicit Worker(std::size_t queueDepth);
+
+        boost::lockfree::spsc_queue<Notification> queue;
+        std::mutex mutex;
+        std::condition_variable wakeup;
+        std::condition_variable space;
+        std::atomic<bool> sleeping;
+        std::atomic<bool> blocked;
+        std::thread thread;
+    };
+
+    auto work(std::size_t index) -> void;
+
+    Backpressure mBackpressure;
+    Dispatch mDispatch;
+    std::vector<std::unique_ptr<Worker>> mWorkers;
+    std::atomic<bool> mStopped;
+    std::atomic<std::size_t> mDropped;
+};
+}
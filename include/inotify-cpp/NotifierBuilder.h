@@ -2,15 +2,20 @@
 
 #include <inotify-cpp/Inotify.h>
 #include <inotify-cpp/Notification.h>
+#include <inotify-cpp/NotificationExecutor.h>
 
 #include <boost/filesystem.hpp>
 
+#include <array>
+#include <deque>
 #include <memory>
 #include <string>
+#include <vector>
 
 namespace inotify {
 
-using EventObserver = std::function<void(Notification)>;
+using EventObserver = std::function<void(const Notification&)>;
+using EventBatchObserver = std::function<void(const std::vector<Notification>&)>;
 
 class NotifierBuilder {
   public:
@@ -18,22 +23,105 @@ class NotifierBuilder {
 
     auto run() -> void;
     auto runOnce() -> void;
+    auto runBatch() -> void;
+    auto processReady() -> std::size_t;
     auto stop() -> void;
+    auto hasStopped() -> bool;
+    auto getFileDescriptor() -> int;
+    auto getNextTimeout() -> int;
     auto watchPathRecursively(boost::filesystem::path path) -> NotifierBuilder&;
     auto watchFile(boost::filesystem::path file) -> NotifierBuilder&;
+    auto watchFiles(const std::vector<boost::filesystem::path>& files,
+        std::vector<boost::system::error_code>& errors) -> NotifierBuilder&;
+    auto watchFilesystem(boost::filesystem::path path) -> NotifierBuilder&;
+    auto watchMount(boost::filesystem::path path) -> NotifierBuilder&;
+    auto restoreWatchState(boost::filesystem::path stateFile, boost::filesystem::path path)
+        -> NotifierBuilder&;
+    auto saveWatchState(boost::filesystem::path stateFile) -> void;
+    auto recordEvents(boost::filesystem::path logFile) -> NotifierBuilder&;
+    auto stopRecording() -> void;
+    auto replayEvents(boost::filesystem::path logFile, ReplaySpeed speed = ReplaySpeed::original)
+        -> NotifierBuilder&;
     auto unwatchFile(boost::filesystem::path file) -> NotifierBuilder&;
+    auto unwatchPathRecursively(boost::filesystem::path path) -> NotifierBuilder&;
     auto ignoreFileOnce(boost::filesystem::path file) -> NotifierBuilder&;
     auto ignoreFile(boost::filesystem::path file) -> NotifierBuilder&;
+    auto ignorePattern(const std::string& pattern) -> NotifierBuilder&;
+    auto group(const std::string& name) -> NotifierBuilder&;
     auto onEvent(Event event, EventObserver) -> NotifierBuilder&;
     auto onEvents(std::vector<Event> event, EventObserver) -> NotifierBuilder&;
     auto onUnexpectedEvent(EventObserver) -> NotifierBuilder&;
+    auto onEventBatch(EventBatchObserver) -> NotifierBuilder&;
     auto setEventTimeout(std::chrono::milliseconds timeout, EventObserver eventObserver)
         -> NotifierBuilder&;
+    auto setEventMask(boost::filesystem::path path, Event events) -> NotifierBuilder&;
+    auto setMaxEvents(std::size_t maxEvents) -> NotifierBuilder&;
+    auto setCrawlThreads(std::size_t threads) -> NotifierBuilder&;
+    auto setAutoRecursive(bool autoRecursive) -> NotifierBuilder&;
+    auto setRenamePairingWindow(std::chrono::milliseconds window) -> NotifierBuilder&;
+    auto setCoalescingPeriod(std::chrono::milliseconds quietPeriod) -> NotifierBuilder&;
+    auto setContentCheck(ContentCheck check, std::size_t threads = 1) -> NotifierBuilder&;
+    auto setEventQueue(std::size_t capacity, Shedding shedding) -> NotifierBuilder&;
+    auto setOverflowRecovery(bool recovery) -> NotifierBuilder&;
+    auto setOverflowObserver(std::function<void(const QueueOverflow&)> onOverflow)
+        -> NotifierBuilder&;
+    auto setInotifyInstances(std::size_t instances) -> NotifierBuilder&;
+    auto setObserverThreads(std::size_t threads, std::size_t queueDepth = 1024,
+        Backpressure backpressure = Backpressure::block) -> NotifierBuilder&;
+    auto getDroppedNotifications() const -> std::size_t;
+    auto setObserverStatistics(bool enabled) -> NotifierBuilder&;
+    auto getStatistics() const -> EventStatistics;
+    auto getObserverStatistics() const -> std::vector<ObserverStatistics>;
 
   private:
+    struct Registration {
+        Event event;
+        std::size_t observer;
+    };
+
+    // Observers of the events of one watch group
+    struct ObserverTable {
+        std::vector<Registration> registrations;
+        std::array<std::vector<std::size_t>, 32> dispatchTable;
+        std::vector<std::size_t> directoryRegistrations;
+        EventObserver unexpectedEventObserver;
+    };
+
+    // Shared by copies of the builder, observers may run on several threads
+    struct DispatchCounters {
+        std::atomic<std::uint64_t> dispatched { 0 };
+        std::deque<ObserverCounters> observers;
+    };
+
+    struct DispatchState {
+        std::vector<std::uint64_t> called;
+        std::uint64_t generation = 0;
+    };
+
+    auto addObserver(Event event, std::size_t observer) -> void;
+    auto assignGroup(const boost::filesystem::path& path) -> void;
+    auto buildDispatchTable() -> void;
+    auto updateEventMask() -> void;
+    auto dispatchBatch() -> void;
+    auto notify(const Notification& notification) -> void;
+    auto notify(const Notification& notification, DispatchState& state) const -> void;
+    auto runExecutor() -> void;
+
     std::shared_ptr<Inotify> mInotify;
-    std::map<Event, EventObserver> mEventObserver;
-    EventObserver mUnexpectedEventObserver;
+    std::vector<EventObserver> mEventObservers;
+    std::vector<ObserverTable> mObserverTables;
+    std::uint32_t mGroup;
+    DispatchState mDispatchState;
+    std::size_t mObserverThreads;
+    std::size_t mQueueDepth;
+    Backpressure mBackpressure;
+    std::shared_ptr<NotificationExecutor> mExecutor;
+    EventBatchObserver mEventBatchObserver;
+    bool mEventTimeoutObserved;
+    bool mObserverStatistics;
+    std::shared_ptr<DispatchCounters> mCounters;
+    std::vector<FileSystemEvent> mEventBatch;
+    std::vector<Notification> mNotificationBatch;
 };
 
 NotifierBuilder BuildNotifier();
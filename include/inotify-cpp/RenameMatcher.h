@@ -0,0 +1,48 @@
+#pragma once
+#include <inotify-cpp/FileSystemEvent.h>
+
+#include <boost/optional.hpp>
+
+#include <chrono>
+#include <cstdint>
+#include <deque>
+#include <unordered_map>
+#include <vector>
+
+namespace inotify {
+
+/**
+ * @brief Joins the moved_from and moved_to halves of a rename.
+ *
+ * Both halves carry the same inotify cookie. A moved_from is held back
+ * for the pairing window. If the matching moved_to arrives in time, a
+ * single event with mask IN_MOVE is emitted, carrying the new path in
+ * path and the old one in oldPath. Unpaired moved_from halves are
+ * emitted as IN_DELETE once the window expired, unpaired moved_to
+ * halves immediately as IN_CREATE.
+ */
+class RenameMatcher {
+  public:
+    using Clock = std::chrono::steady_clock;
+
+    explicit RenameMatcher(std::chrono::milliseconds window = std::chrono::milliseconds(0));
+
+    auto setWindow(std::chrono::milliseconds window) -> void;
+    auto enabled() const -> bool;
+    auto process(FileSystemEvent&& event, Clock::time_point now, std::vector<FileSystemEvent>& out)
+        -> void;
+    auto flushExpired(Clock::time_point now, std::vector<FileSystemEvent>& out) -> void;
+    auto nextDeadline() const -> boost::optional<Clock::time_point>;
+    auto pending() const -> std::size_t;
+
+  private:
+    struct Pending {
+        Clock::time_point deadline;
+        uint32_t cookie;
+    };
+
+    std::chrono::milliseconds mWindow;
+    std::unordered_map<uint32_t, FileSystemEvent> mMovedFrom;
+    std::deque<Pending> mDeadlines;
+};
+}
@@ -0,0 +1,243 @@
+#pragma once
+#include <inotify-cpp/Inotify.h>
+#include <inotify-cpp/Notification.h>
+
+#include <boost/filesystem.hpp>
+
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+namespace inotify {
+
+namespace detail {
+    template <Event... Events> struct EventBits;
+
+    template <> struct EventBits<> {
+        static constexpr std::uint32_t value = 0;
+    };
+
+    template <Event First, Event... Rest> struct EventBits<First, Rest...> {
+        static constexpr std::uint32_t value
+            = static_cast<std::uint32_t>(First) | EventBits<Rest...>::value;
+    };
+
+    /**
+     * @brief Events the kernel has to report for the events of an
+     *        observer, is_dir alone matches every directory event
+     */
+    constexpr auto kernelEvents(std::uint32_t events) -> std::uint32_t
+    {
+        return events == IN_ISDIR ? IN_ALL_EVENTS : events & IN_ALL_EVENTS;
+    }
+
+    template <typename... Observers> struct ObservedEvents;
+
+    template <> struct ObservedEvents<> {
+        static constexpr std::uint32_t value = 0;
+    };
+
+    template <typename First, typename... Rest> struct ObservedEvents<First, Rest...> {
+        static constexpr std::uint32_t value
+            = kernelEvents(First::events) | ObservedEvents<Rest...>::value;
+    };
+}
+
+/**
+ * @brief Observer of a StaticNotifier, created by on. The events are
+ *        part of the type, thus matching an event against them only
+ *        tests constants.
+ */
+template <std::uint32_t Events, typename Callback> struct StaticObserver {
+    static constexpr std::uint32_t events = Events;
+
+    /**
+     * @brief Same rules as NotifierBuilder::onEvent, an event matches
+     *        if it shares a bit with the events. With is_dir only
+     *        directory events match.
+     */
+    static auto matches(std::uint32_t mask) -> bool
+    {
+        return (!(Events & IN_ISDIR) || (mask & IN_ISDIR))
+            && (!(Events & ~IN_ISDIR) || (mask & Events & ~IN_ISDIR));
+    }
+
+    Callback callback;
+};
+
+template <std::uint32_t Events, typename Callback>
+constexpr std::uint32_t StaticObserver<Events, Callback>::events;
+
+/**
+ * @brief Registers callback on the events, e.g.
+ *        on<Event::create, Event::moved_to>(onNewFile). The events
+ *        are combined like with operator|, on<Event::open,
+ *        Event::is_dir> observes opened directories.
+ */
+template <Event... Events, typename Callback>
+auto on(Callback callback) -> StaticObserver<detail::EventBits<Events...>::value, Callback>
+{
+    static_assert(sizeof...(Events) > 0, "Observers need at least one event");
+    return { std::move(callback) };
+}
+
+/**
+ * @brief Notifier for a set of observers known at compile time.
+ *
+ * Unlike NotifierBuilder the observers are not type erased. The event
+ * mask is built at compile time and dispatching an event tests the
+ * constant events of every observer in turn, the calls are inlined.
+ * Meant for hot watchers with a fixed set of handlers, everything
+ * that is not set up through the notifier is set on inotify(). Events
+ * no observer matches are dropped. Header only.
+ */
+template <typename... Observers> class StaticNotifier {
+  public:
+    static constexpr std::uint32_t eventMask = detail::ObservedEvents<Observers...>::value;
+
+    explicit StaticNotifier(Observers... observers)
+        : mInotify(std::make_shared<Inotify>())
+        , mObservers(std::move(observers)...)
+    {
+        mInotify->setEventMask(eventMask);
+    }
+
+    auto watchPathRecursively(boost::filesystem::path path) -> StaticNotifier&
+    {
+        mInotify->watchDirectoryRecursively(path);
+        return *this;
+    }
+
+    auto watchFile(boost::filesystem::path file) -> StaticNotifier&
+    {
+        mInotify->watchFile(file);
+        return *this;
+    }
+
+    auto unwatchFile(boost::filesystem::path file) -> StaticNotifier&
+    {
+        mInotify->unwatchFile(file);
+        return *this;
+    }
+
+    auto unwatchPathRecursively(boost::filesystem::path path) -> StaticNotifier&
+    {
+        mInotify->unwatchDirectoryRecursively(path);
+        return *this;
+    }
+
+    auto ignoreFile(boost::filesystem::path file) -> StaticNotifier&
+    {
+        mInotify->ignoreFile(file);
+        return *this;
+    }
+
+    auto ignorePattern(const std::string& pattern) -> StaticNotifier&
+    {
+        mInotify->ignorePattern(pattern);
+        return *this;
+    }
+
+    /**
+     * @brief Event masks of paths, watch groups, the rename pairing and
+     *        the other settings of NotifierBuilder are made here
+     */
+    auto inotify() -> Inotify&
+    {
+        return *mInotify;
+    }
+
+    auto run() -> void
+    {
+        while (!mInotify->hasStopped() && mInotify->getNextEvents(mEventBatch)) {
+            dispatchBatch();
+        }
+    }
+
+    /**
+     * @brief Dispatches the events that are ready without blocking,
+     *        like NotifierBuilder::processReady
+     *
+     * @return number of dispatched events
+     */
+    auto processReady() -> std::size_t
+    {
+        if (!mInotify->tryGetEvents(mEventBatch)) {
+            return 0;
+        }
+
+        dispatchBatch();
+        return mEventBatch.size();
+    }
+
+    auto stop() -> void
+    {
+        mInotify->stop();
+    }
+
+    auto hasStopped() -> bool
+    {
+        return mInotify->hasStopped();
+    }
+
+    auto getFileDescriptor() -> int
+    {
+        return mInotify->getFileDescriptor();
+    }
+
+    auto getNextTimeout() -> int
+    {
+        return mInotify->getNextTimeout();
+    }
+
+  private:
+    auto dispatchBatch() -> void
+    {
+        // Swapped, the storage goes back to Inotify with the events
+        for (auto& event : mEventBatch) {
+            mNotification.event = static_cast<Event>(event.mask);
+            mNotification.group = event.group;
+            mNotification.path.swap(event.path);
+            mNotification.oldPath.swap(event.oldPath);
+            notify<0>(event.mask);
+        }
+    }
+
+    template <std::size_t Index>
+    auto notify(std::uint32_t) -> typename std::enable_if<Index == sizeof...(Observers)>::type
+    {
+    }
+
+    template <std::size_t Index>
+    auto notify(std::uint32_t mask) -> typename std::enable_if<(Index < sizeof...(Observers))>::type
+    {
+        using Observer = typename std::tuple_element<Index, std::tuple<Observers...>>::type;
+        if (Observer::matches(mask)) {
+            std::get<Index>(mObservers).callback(static_cast<const Notification&>(mNotification));
+        }
+        notify<Index + 1>(mask);
+    }
+
+    std::shared_ptr<Inotify> mInotify;
+    std::tuple<Observers...> mObservers;
+    std::vector<FileSystemEvent> mEventBatch;
+    Notification mNotification;
+};
+
+template <typename... Observers>
+constexpr std::uint32_t StaticNotifier<Observers...>::eventMask;
+
+/**
+ * @brief Builds a notifier of the observers, e.g.
+ *        makeNotifier(on<Event::close_write>(f), on<Event::create>(g))
+ */
+template <typename... Observers>
+auto makeNotifier(Observers... observers) -> StaticNotifier<Observers...>
+{
+    return StaticNotifier<Observers...>(std::move(observers)...);
+}
+}
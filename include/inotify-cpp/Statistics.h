@@ -0,0 +1,105 @@
+#pragma once
+#include <inotify-cpp/Event.h>
+
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <ostream>
+#include <vector>
+
+namespace inotify {
+
+/**
+ * @brief Counters of an Inotify instance since it was created
+ */
+struct EventStatistics {
+    std::uint64_t wakeups; ///< waits that returned with readable fds
+    std::uint64_t reads; ///< reads that returned events
+    std::uint64_t bytesRead; ///< of inotify fds, fanotify reads are not included
+    std::uint64_t eventsParsed; ///< read from the kernel or synthesized
+    std::uint64_t eventsIgnored; ///< dropped by the ignore rules
+    std::uint64_t eventsTimedOut; ///< passed to the event timeout observer instead
+    std::uint64_t eventsUnchanged; ///< dropped by the content check, the file was not changed
+    std::uint64_t eventsReturned; ///< by getNextEvent(s), getNextEventViews and tryGetEvents
+    std::uint64_t eventsShedLow; ///< dropped by the bounded event queue, access, open and close_nowrite
+    std::uint64_t eventsShedNormal; ///< dropped by the bounded event queue, all other events
+    std::uint64_t eventsCollapsed; ///< merged into a queued event on the same path
+    std::uint64_t eventsDispatched; ///< filled by NotifierBuilder, events some observer got
+    std::uint64_t overflows;
+    std::size_t watches;
+    std::size_t maxWatches; ///< /proc/sys/fs/inotify/max_user_watches
+    std::size_t queuedEvents; ///< waiting in the queue of getNextEvent
+};
+
+/**
+ * @brief Passed to the overflow observer of Inotify. The kernel queue
+ *        of max_queued_events was too small for the events at this
+ *        rate, raise /proc/sys/fs/inotify/max_queued_events or read
+ *        faster.
+ */
+struct QueueOverflow {
+    std::size_t maxQueuedEvents; ///< /proc/sys/fs/inotify/max_queued_events, 0 if unknown
+    std::uint64_t eventsPerSecond; ///< parsed since the previous overflow or the creation
+    std::uint64_t overflows; ///< including this one
+};
+
+/**
+ * @brief Log2 histogram of durations. Bucket 0 counts durations below
+ *        one microsecond, bucket i the ones below 2^i microseconds and
+ *        the last bucket all longer ones.
+ */
+struct DurationHistogram {
+    static constexpr std::size_t buckets = 24;
+
+    static auto bucketOf(std::chrono::nanoseconds duration) -> std::size_t;
+    static auto upperBound(std::size_t bucket) -> std::chrono::microseconds;
+
+    std::array<std::uint64_t, buckets> counts;
+    std::chrono::nanoseconds total;
+};
+
+struct ObserverStatistics {
+    Event events; ///< all events the observer is registered on
+    std::uint64_t calls;
+    DurationHistogram durations;
+};
+
+/**
+ * @brief Updated by the reading thread with relaxed atomics, any
+ *        thread can take a snapshot. Single counters are exact, the
+ *        snapshot as a whole is not taken atomically.
+ */
+struct EventCounters {
+    auto snapshot() const -> EventStatistics;
+
+    std::atomic<std::uint64_t> wakeups { 0 };
+    std::atomic<std::uint64_t> reads { 0 };
+    std::atomic<std::uint64_t> bytesRead { 0 };
+    std::atomic<std::uint64_t> eventsParsed { 0 };
+    std::atomic<std::uint64_t> eventsIgnored { 0 };
+    std::atomic<std::uint64_t> eventsTimedOut { 0 };
+    std::atomic<std::uint64_t> eventsUnchanged { 0 };
+    std::atomic<std::uint64_t> eventsReturned { 0 };
+    std::atomic<std::uint64_t> overflows { 0 };
+    std::atomic<std::size_t> watches { 0 };
+    std::atomic<std::size_t> queuedEvents { 0 };
+};
+
+/**
+ * @brief Durations of the calls of one observer, recorded by the
+ *        threads running it
+ */
+struct ObserverCounters {
+    auto record(std::chrono::nanoseconds duration) -> void;
+    auto snapshot(Event events) const -> ObserverStatistics;
+
+    std::atomic<std::uint64_t> calls { 0 };
+    std::atomic<std::uint64_t> totalNanoseconds { 0 };
+    std::array<std::atomic<std::uint64_t>, DurationHistogram::buckets> counts {};
+};
+
+auto writePrometheus(std::ostream& stream, const EventStatistics& statistics) -> void;
+auto writePrometheus(std::ostream& stream, const std::vector<ObserverStatistics>& observers)
+    -> void;
+}
@@ -0,0 +1,77 @@
+#pragma once
+#include <boost/filesystem.hpp>
+#include <boost/utility/string_ref.hpp>
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+#include <vector>
+
+namespace inotify {
+
+/**
+ * @brief Saved state of recursively watched trees, read back after a
+ *        restart to restore the watches without crawling unchanged
+ *        directories again.
+ *
+ * The file is a header followed by a flat table of fixed size records
+ * and a table of names, it is used in place through a read only
+ * memory mapping. Every record is an entry of a watched directory. The
+ * first records are the roots, named by their full path; the children
+ * of a directory are consecutive and follow the directory. Watched
+ * directories carry the modification time and inode they had when
+ * they were listed. The records are in the byte order of the machine
+ * that wrote them.
+ */
+class WatchState {
+  public:
+    struct Record {
+        std::uint64_t mtime;
+        std::uint64_t inode;
+        std::uint32_t name;
+        std::uint32_t firstChild;
+        std::uint32_t children;
+        std::uint16_t nameLength;
+        std::uint16_t flags;
+    };
+
+    static constexpr std::uint16_t directory = 1;
+    // Directory that was watched and listed
+    static constexpr std::uint16_t watched = 2;
+    // Changed while it was listed, its modification time can not be trusted
+    static constexpr std::uint16_t racy = 4;
+
+    WatchState();
+    ~WatchState();
+
+    WatchState(const WatchState&) = delete;
+    WatchState& operator=(const WatchState&) = delete;
+
+    auto add(boost::string_ref name, std::uint16_t flags) -> std::uint32_t;
+    auto mutableRecord(std::uint32_t index) -> Record&;
+    auto setRoots(std::uint32_t roots) -> void;
+    auto save(const boost::filesystem::path& file) const -> bool;
+
+    auto load(const boost::filesystem::path& file) -> bool;
+    auto roots() const -> std::uint32_t;
+    auto size() const -> std::uint32_t;
+    auto record(std::uint32_t index) const -> const Record&;
+    auto name(const Record& record) const -> boost::string_ref;
+
+  private:
+    auto validate() -> bool;
+    auto unmap() -> void;
+
+    std::vector<Record> mRecords;
+    std::string mNames;
+    std::uint32_t mRoots;
+
+    // A loaded state refers to the mapping instead
+    const void* mMapping;
+    std::size_t mMappingSize;
+    const Record* mMappedRecords;
+    const char* mMappedNames;
+    std::uint32_t mMappedSize;
+    std::uint64_t mMappedNamesSize;
+};
+}
@@ -0,0 +1,461 @@
+#include <inotify-cpp/ContentFilter.h>
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <time.h>
+#include <unistd.h>
+
+#include <algorithm>
+#include <iterator>
+#include <sstream>
+#include <stdexcept>
+
+namespace inotify {
+
+namespace {
+    const std::uint32_t checkedMask = IN_MODIFY | IN_CLOSE_WRITE;
+    const std::uint32_t removalMask = IN_DELETE | IN_DELETE_SELF | IN_MOVE | IN_MOVE_SELF;
+
+    // Bigger files are compared by their metadata only
+    const std::uint64_t maxHashedSize = 256ull << 20;
+    // Reads of whole 32 byte stripes, every read but the last fills it
+    const std::size_t readBufferSize = 64 << 10;
+    // Forgotten all at once when exceeded, like the path caches
+    const std::size_t maxBaselines = 1 << 16;
+
+    const std::uint64_t prime1 = 0x9e3779b185ebca87ull;
+    const std::uint64_t prime2 = 0xc2b2ae3d27d4eb4full;
+    const std::uint64_t prime3 = 0x165667b19e3779f9ull;
+
+    std::uint64_t rotate(std::uint64_t value, int bits)
+    {
+        return (value << bits) | (value >> (64 - bits));
+    }
+
+    std::uint64_t mix(std::uint64_t lane, std::uint64_t word)
+    {
+        return rotate(lane + word * prime2, 31) * prime1;
+    }
+
+    std::uint64_t load(const char* data)
+    {
+        std::uint64_t word;
+        memcpy(&word, data, sizeof(word));
+        return word;
+    }
+
+    /**
+     * @brief 64 bit hash of a stream of chunks in the spirit of xxHash,
+     *        four independent lanes consume 32 bytes per round. Only
+     *        detects changes, it is no cryptographic hash.
+     */
+    class ContentHash {
+      public:
+        ContentHash()
+            : mLanes { prime1 + prime2, prime2, 0, 0 - prime1 }
+            , mTail(prime3)
+            , mLength(0)
+        {
+        }
+
+        // Every chunk but the last has to be a multiple of 32 bytes
+        void update(const char* data, std::size_t size)
+        {
+            mLength += size;
+            for (; size >= 32; data += 32, size -= 32) {
+                for (std::size_t lane = 0; lane < 4; ++lane) {
+                    mLanes[lane] = mix(mLanes[lane], load(data + lane * 8));
+                }
+            }
+            for (; size >= 8; data += 8, size -= 8) {
+                mTail = rotate(mTail ^ mix(0, load(data)), 27) * prime1 + prime3;
+            }
+            for (; size > 0; ++data, --size) {
+                mTail = rotate(mTail ^ (static_cast<unsigned char>(*data) * prime3), 11) * prime1;
+            }
+        }
+
+        std::uint64_t digest() const
+        {
+            std::uint64_t hash = rotate(mLanes[0], 1) + rotate(mLanes[1], 7)
+                + rotate(mLanes[2], 12) + rotate(mLanes[3], 18);
+            hash = (hash ^ mTail) + mLength;
+            hash = (hash ^ (hash >> 33)) * prime2;
+            hash = (hash ^ (hash >> 29)) * prime3;
+            return hash ^ (hash >> 32);
+        }
+
+      private:
+        std::uint64_t mLanes[4];
+        std::uint64_t mTail;
+        std::uint64_t mLength;
+    };
+
+    /**
+     * @return bytes read into the buffer, less than its size only at
+     *         the end of the file, -1 on errors
+     */
+    ssize_t fill(int fd, std::vector<char>& buffer)
+    {
+        std::size_t filled = 0;
+        while (filled < buffer.size()) {
+            ssize_t length = read(fd, buffer.data() + filled, buffer.size() - filled);
+            if (length == -1 && errno == EINTR) {
+                continue;
+            }
+            if (length == -1) {
+                return -1;
+            }
+            if (length == 0) {
+                break;
+            }
+            filled += static_cast<std::size_t>(length);
+        }
+        return static_cast<ssize_t>(filled);
+    }
+
+    std::int64_t nanoseconds(const timespec& time)
+    {
+        return static_cast<std::int64_t>(time.tv_sec) * 1000000000 + time.tv_nsec;
+    }
+}
+
+/**
+ * @param threads number of workers stat'ing and hashing files, at
+ *        least one
+ */
+ContentFilter::ContentFilter(ContentCheck check, std::size_t threads)
+    : mCheck(check)
+    , mCompletedFd(eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC))
+    , mStopped(false)
+{
+    if (mCompletedFd == -1) {
+        std::stringstream errorStream;
+        errorStream << "Can't initialize content filter ! " << strerror(errno) << ".";
+        throw std::runtime_error(errorStream.str());
+    }
+
+    for (std::size_t i = 0; i < std::max<std::size_t>(1, threads); ++i) {
+        mWorkers.emplace_back(&ContentFilter::work, this);
+    }
+}
+
+ContentFilter::~ContentFilter()
+{
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mStopped = true;
+    }
+    mWakeup.notify_all();
+    for (auto& worker : mWorkers) {
+        worker.join();
+    }
+    close(mCompletedFd);
+}
+
+/**
+ * @brief The fd becomes readable when checks completed, collect
+ *        returns their events. Meant to be polled edge triggered.
+ */
+auto ContentFilter::getFileDescriptor() const -> int
+{
+    return mCompletedFd;
+}
+
+auto ContentFilter::process(FileSystemEvent&& event, std::vector<FileSystemEvent>& out) -> void
+{
+    auto waiting = mWaiting.find(event.path.native());
+    if (waiting != mWaiting.end()) {
+        waiting->second.push_back(std::move(event));
+        return;
+    }
+
+    admit(std::move(event), out);
+}
+
+/**
+ * @brief Appends the events of completed checks that changed their
+ *        files and the events that waited behind them, up to the next
+ *        event that has to be checked
+ *
+ * @return number of dropped events
+ */
+auto ContentFilter::collect(std::vector<FileSystemEvent>& out) -> std::size_t
+{
+    // Drained before taking the checks, a check completing later
+    // makes the fd readable again
+    std::uint64_t completed;
+    if (read(mCompletedFd, &completed, sizeof(completed)) == -1) {
+        completed = 0;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mCollected.swap(mCompleted);
+    }
+
+    std::size_t dropped = 0;
+    for (auto& check : mCollected) {
+        auto waiting = mWaiting.find(check.path);
+        if (waiting == mWaiting.end()) {
+            continue;
+        }
+
+        std::vector<FileSystemEvent> events;
+        events.swap(waiting->second);
+        mWaiting.erase(waiting);
+
+        auto event = events.begin();
+        if (decide(check, *event)) {
+            out.push_back(std::move(*event));
+        } else {
+            ++dropped;
+        }
+
+        for (++event; event != events.end(); ++event) {
+            if (admit(std::move(*event), out)) {
+                auto& queued = mWaiting[check.path];
+                std::move(event + 1, events.end(), std::back_inserter(queued));
+                break;
+            }
+        }
+    }
+    mCollected.clear();
+    return dropped;
+}
+
+/**
+ * @brief Appends all waiting events unchecked, before the filter is
+ *        destroyed
+ */
+auto ContentFilter::flushAll(std::vector<FileSystemEvent>& out) -> void
+{
+    for (auto& waiting : mWaiting) {
+        for (auto& event : waiting.second) {
+            out.push_back(std::move(event));
+        }
+    }
+    mWaiting.clear();
+}
+
+/**
+ * @return number of paths with a check in flight
+ */
+auto ContentFilter::pending() const -> std::size_t
+{
+    return mWaiting.size();
+}
+
+/**
+ * @brief Same file, size and either modification time or hash. A
+ *        racy baseline or a file hashed while it changed never
+ *        matches.
+ */
+auto ContentFilter::unchanged(const State& baseline, const State& state) -> bool
+{
+    if (!baseline.valid || !state.valid || baseline.inode != state.inode
+        || baseline.size != state.size) {
+        return false;
+    }
+    if (baseline.mtime == state.mtime && !baseline.racy) {
+        return true;
+    }
+    return baseline.hashed && state.hashed && baseline.hash == state.hash;
+}
+
+/**
+ * @brief Hands a modify or close_write event to the workers, other
+ *        events pass and forget the baselines they invalidate
+ *
+ * @return true if the event waits for its check
+ */
+auto ContentFilter::admit(FileSystemEvent&& event, std::vector<FileSystemEvent>& out) -> bool
+{
+    if (!(event.mask & checkedMask) || (event.mask & (IN_ISDIR | removalMask))) {
+        if (event.mask & IN_Q_OVERFLOW) {
+            mBaselines.clear();
+        } else if (event.mask & removalMask) {
+            forget(event.path.native());
+            forget(event.oldPath.native());
+        }
+        out.push_back(std::move(event));
+        return false;
+    }
+
+    Check check {};
+    check.path = event.path.native();
+    check.mask = event.mask;
+    auto baselines = mBaselines.find(check.path);
+    if (baselines != mBaselines.end()) {
+        check.baselines = baselines->second;
+    }
+
+    mWaiting[check.path].push_back(std::move(event));
+    {
+        std::lock_guard<std::mutex> lock(mMutex);
+        mChecks.push_back(std::move(check));
+    }
+    mWakeup.notify_one();
+    return true;
+}
+
+/**
+ * @brief Clears the bits of the event whose baseline matches the
+ *        checked file and moves the others baselines to it
+ *
+ * @return false if no event bit is left
+ */
+auto ContentFilter::decide(const Check& check, FileSystemEvent& event) -> bool
+{
+    if (!check.state.valid) {
+        forget(check.path);
+        return true;
+    }
+
+    if (mBaselines.size() >= maxBaselines && !mBaselines.count(check.path)) {
+        mBaselines.clear();
+    }
+
+    auto& baselines = mBaselines[check.path];
+    std::uint32_t unchangedMask = 0;
+    if (event.mask & IN_MODIFY) {
+        if (unchanged(baselines.modified, check.state)) {
+            unchangedMask |= IN_MODIFY;
+        } else {
+            baselines.modified = check.state;
+        }
+    }
+    if (event.mask & IN_CLOSE_WRITE) {
+        if (unchanged(baselines.closed, check.state)) {
+            unchangedMask |= IN_CLOSE_WRITE;
+        } else {
+            baselines.closed = check.state;
+        }
+    }
+
+    event.mask &= ~unchangedMask;
+    return (event.mask & IN_ALL_EVENTS) != 0;
+}
+
+auto ContentFilter::forget(const std::string& path) -> void
+{
+    if (!path.empty()) {
+        mBaselines.erase(path);
+    }
+}
+
+auto ContentFilter::work() -> void
+{
+    std::vector<char> buffer(readBufferSize);
+    while (true) {
+        Check check;
+        {
+            std::unique_lock<std::mutex> lock(mMutex);
+            mWakeup.wait(lock, [this]() { return mStopped || !mChecks.empty(); });
+            if (mStopped) {
+                return;
+            }
+            check = std::move(mChecks.front());
+            mChecks.pop_front();
+        }
+
+        inspect(check, buffer);
+
+        {
+            std::lock_guard<std::mutex> lock(mMutex);
+            mCompleted.push_back(std::move(check));
+        }
+        std::uint64_t completed = 1;
+        if (write(mCompletedFd, &completed, sizeof(completed)) == -1) {
+            // Only fails once 2^64 - 2 checks were not collected
+        }
+    }
+}
+
+/**
+ * @brief Fills the state of the checked file, runs on a worker. The
+ *        file is only read if a hash is needed to compare it against
+ *        a baseline of the event. Files are read instead of mapped, a
+ *        file truncated while it is mapped would raise SIGBUS.
+ */
+auto ContentFilter::inspect(Check& check, std::vector<char>& buffer) -> void
+{
+    auto& state = check.state;
+    struct stat status;
+    int fd = -1;
+    if (mCheck == ContentCheck::hash) {
+        fd = open(check.path.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK | O_NOATIME);
+        if (fd == -1 && errno == EPERM) {
+            // O_NOATIME is only allowed to the owner
+            fd = open(check.path.c_str(), O_RDONLY | O_CLOEXEC | O_NOCTTY | O_NONBLOCK);
+        }
+        state.valid = fd != -1 && fstat(fd, &status) == 0;
+    } else {
+        state.valid = stat(check.path.c_str(), &status) == 0;
+    }
+
+    state.valid = state.valid && S_ISREG(status.st_mode);
+    if (!state.valid) {
+        if (fd != -1) {
+            close(fd);
+        }
+        return;
+    }
+
+    // The kernel stamps files with the coarse clock, a file written in
+    // the tick it was stat'ed in may change again without a new time
+    timespec now {};
+    clock_gettime(CLOCK_REALTIME_COARSE, &now);
+    state.inode = status.st_ino;
+    state.size = static_cast<std::uint64_t>(status.st_size);
+    state.mtime = nanoseconds(status.st_mtim);
+    state.racy = state.mtime >= nanoseconds(now);
+
+    if (fd == -1) {
+        return;
+    }
+
+    // Hashed unless the metadata matches every baseline to compare with
+    const State* same = nullptr;
+    bool needsHash = false;
+    for (auto kind : { IN_MODIFY, IN_CLOSE_WRITE }) {
+        const auto& baseline
+            = kind == IN_MODIFY ? check.baselines.modified : check.baselines.closed;
+        if (!(check.mask & kind)) {
+            continue;
+        }
+        if (baseline.valid && !baseline.racy && baseline.inode == state.inode
+            && baseline.size == state.size && baseline.mtime == state.mtime) {
+            same = baseline.hashed ? &baseline : same;
+        } else {
+            needsHash = true;
+        }
+    }
+
+    if (!needsHash || state.size > maxHashedSize) {
+        state.hashed = same != nullptr;
+        state.hash = same ? same->hash : 0;
+        close(fd);
+        return;
+    }
+
+    ContentHash hash;
+    ssize_t length;
+    while ((length = fill(fd, buffer)) > 0) {
+        hash.update(buffer.data(), static_cast<std::size_t>(length));
+        if (static_cast<std::size_t>(length) < buffer.size()) {
+            break;
+        }
+    }
+
+    // A file written while it was read has no valid hash
+    struct stat after;
+    state.hashed = length != -1 && fstat(fd, &after) == 0 && after.st_size == status.st_size
+        && nanoseconds(after.st_mtim) == state.mtime;
+    state.hash = hash.digest();
+    close(fd);
+}
+}
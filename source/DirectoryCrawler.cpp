@@ -0,0 +1,304 @@
+#include <inotify-cpp/DirectoryCrawler.h>
+
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <exception>
+#include <mutex>
+#include <set>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <unistd.h>
+
+namespace inotify {
+
+namespace {
+struct LinuxDirent64 {
+    std::uint64_t d_ino;
+    std::int64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[1];
+};
+
+struct Entry {
+    boost::filesystem::path path;
+    EntryType type;
+};
+
+/**
+ * @brief State shared by all threads of one crawl
+ */
+class Crawl {
+  public:
+    Crawl(bool reportFiles, const DirectoryCrawler::Filter& isIgnored)
+        : mReportFiles(reportFiles)
+        , mIsIgnored(isIgnored)
+    {
+    }
+
+    /**
+     * @brief Reads all entries of one directory and classifies them
+     *        by their d_type. Entries that have to be watched are
+     *        appended to entries, directories to descend to
+     *        directories.
+     */
+    void readDirectory(
+        const std::string& directory,
+        std::vector<Entry>& entries,
+        std::vector<std::string>& directories,
+        CrawlStatistics& statistics)
+    {
+        int fd = open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (fd == -1) {
+            ++statistics.errors;
+            return;
+        }
+
+        struct stat status;
+        if (fstat(fd, &status) == -1 || !enter(status.st_dev, status.st_ino)) {
+            close(fd);
+            return;
+        }
+
+        alignas(LinuxDirent64) char buffer[16384];
+        while (true) {
+            long length = syscall(SYS_getdents64, fd, buffer, sizeof(buffer));
+            if (length <= 0) {
+                if (length == -1) {
+                    ++statistics.errors;
+                }
+                break;
+            }
+
+            for (long offset = 0; offset < length;) {
+                auto entry = reinterpret_cast<LinuxDirent64*>(buffer + offset);
+                offset += entry->d_reclen;
+
+                boost::string_ref name(entry->d_name);
+                if (name == "." || name == "..") {
+                    continue;
+                }
+
+                std::string path = directory;
+                if (path.empty() || path.back() != '/') {
+                    path += '/';
+                }
+                path.append(name.begin(), name.end());
+
+                unsigned char type = entry->d_type;
+                if (type == DT_UNKNOWN) {
+                    // Some filesystems do not fill d_type
+                    struct stat entryStatus;
+                    if (fstatat(fd, entry->d_name, &entryStatus, AT_SYMLINK_NOFOLLOW) == -1) {
+                        ++statistics.errors;
+                        continue;
+                    }
+                    type = S_ISDIR(entryStatus.st_mode) ? DT_DIR
+                        : S_ISLNK(entryStatus.st_mode)  ? DT_LNK
+                                                        : DT_REG;
+                }
+
+                if (type == DT_DIR || type == DT_LNK) {
+                    if (mIsIgnored && mIsIgnored(path)) {
+                        ++statistics.skipped;
+                        continue;
+                    }
+                }
+
+                if (type == DT_DIR) {
+                    ++statistics.directories;
+                    entries.push_back({ path, EntryType::directory });
+                    directories.push_back(std::move(path));
+                } else if (type == DT_LNK) {
+                    ++statistics.symlinks;
+                    entries.push_back({ path, EntryType::symlink });
+
+                    struct stat target;
+                    if (stat(path.c_str(), &target) == 0 && S_ISDIR(target.st_mode)) {
+                        directories.push_back(std::move(path));
+                    }
+                } else {
+                    ++statistics.files;
+                    if (mReportFiles) {
+                        entries.push_back({ path, EntryType::file });
+                    }
+                }
+            }
+        }
+
+        close(fd);
+    }
+
+  private:
+    bool enter(dev_t device, ino_t inode)
+    {
+        std::lock_guard<std::mutex> lock(mVisitedMutex);
+        return mVisited.emplace(device, inode).second;
+    }
+
+    bool mReportFiles;
+    const DirectoryCrawler::Filter& mIsIgnored;
+    std::mutex mVisitedMutex;
+    std::set<std::pair<dev_t, ino_t>> mVisited;
+};
+
+void merge(CrawlStatistics& statistics, const CrawlStatistics& other)
+{
+    statistics.directories += other.directories;
+    statistics.symlinks += other.symlinks;
+    statistics.files += other.files;
+    statistics.skipped += other.skipped;
+    statistics.errors += other.errors;
+}
+}
+
+DirectoryCrawler::DirectoryCrawler(std::size_t threads)
+    : mThreads(threads == 0 ? 1 : threads)
+    , mReportFiles(false)
+{
+}
+
+/**
+ * @brief Files are only counted by default. Enabling this reports
+ *        them to the visitor as well.
+ */
+auto DirectoryCrawler::setReportFiles(bool reportFiles) -> DirectoryCrawler&
+{
+    mReportFiles = reportFiles;
+    return *this;
+}
+
+/**
+ * @brief Walks all directories below root. The root itself is not
+ *        reported to the visitor. Unreadable directories are
+ *        counted as errors and skipped.
+ *
+ * @param isIgnored decides which directories and symlinks are skipped
+ *        together with their subtree. It is called from the worker
+ *        threads and must be thread safe.
+ * @param visitor is called for every directory and symlink below root
+ *
+ */
+auto DirectoryCrawler::crawl(
+    const boost::filesystem::path& root, Filter isIgnored, Visitor visitor) -> CrawlStatistics
+{
+    auto start = std::chrono::steady_clock::now();
+    CrawlStatistics statistics {};
+    Crawl crawl(mReportFiles, isIgnored);
+
+    if (mThreads == 1) {
+        std::vector<std::string> directories { root.native() };
+        std::vector<Entry> entries;
+        while (!directories.empty()) {
+            auto directory = std::move(directories.back());
+            directories.pop_back();
+            crawl.readDirectory(directory, entries, directories, statistics);
+
+            for (const auto& entry : entries) {
+                visitor(entry.path, entry.type);
+            }
+            entries.clear();
+        }
+    } else {
+        std::mutex mutex;
+        std::condition_variable workAvailable;
+        std::condition_variable entriesAvailable;
+        std::deque<std::string> work { root.native() };
+        std::vector<Entry> results;
+        std::size_t busy = 0;
+        bool aborted = false;
+
+        auto finished = [&]() { return work.empty() && busy == 0; };
+
+        auto worker = [&]() {
+            CrawlStatistics workerStatistics {};
+            std::vector<Entry> entries;
+            std::vector<std::string> directories;
+
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                workAvailable.wait(lock, [&]() { return aborted || !work.empty() || finished(); });
+                if (aborted || finished()) {
+                    break;
+                }
+
+                auto directory = std::move(work.front());
+                work.pop_front();
+                ++busy;
+                lock.unlock();
+
+                crawl.readDirectory(directory, entries, directories, workerStatistics);
+
+                lock.lock();
+                --busy;
+                for (auto& subdirectory : directories) {
+                    work.push_back(std::move(subdirectory));
+                }
+                for (auto& entry : entries) {
+                    results.push_back(std::move(entry));
+                }
+                directories.clear();
+                entries.clear();
+                workAvailable.notify_all();
+                entriesAvailable.notify_one();
+            }
+
+            merge(statistics, workerStatistics);
+            entriesAvailable.notify_one();
+        };
+
+        std::vector<std::thread> workers;
+        for (std::size_t i = 0; i < mThreads; ++i) {
+            workers.emplace_back(worker);
+        }
+
+        // Watches are added serialized on this thread while the workers crawl
+        std::exception_ptr error;
+        std::vector<Entry> entries;
+        try {
+            std::unique_lock<std::mutex> lock(mutex);
+            while (true) {
+                entriesAvailable.wait(lock, [&]() { return !results.empty() || finished(); });
+                bool done = finished();
+                entries.swap(results);
+                lock.unlock();
+
+                for (const auto& entry : entries) {
+                    visitor(entry.path, entry.type);
+                }
+                entries.clear();
+
+                lock.lock();
+                if (done && results.empty()) {
+                    break;
+                }
+            }
+        } catch (...) {
+            error = std::current_exception();
+            std::lock_guard<std::mutex> lock(mutex);
+            aborted = true;
+            workAvailable.notify_all();
+        }
+
+        for (auto& thread : workers) {
+            thread.join();
+        }
+
+        if (error) {
+            std::rethrow_exception(error);
+        }
+    }
+
+    statistics.duration = std::chrono::duration_cast<std::chrono::milliseconds>(
+        std::chrono::steady_clock::now() - start);
+    return statistics;
+}
+}
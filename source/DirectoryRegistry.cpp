@@ -0,0 +1,544 @@
+#include <inotify-cpp/DirectoryRegistry.h>
+
+#include <boost/functional/hash.hpp>
+
+#include <algorithm>
+#include <stdexcept>
+#include <string>
+
+namespace inotify {
+
+namespace {
+const std::uint32_t noNode = 0;
+const std::uint32_t rootNode = 0;
+const std::size_t pathCacheSize = 1024;
+
+template <typename Visitor> void forEachComponent(const std::string& path, Visitor visitor)
+{
+    // Splitting on every separator keeps empty components, thus joining
+    // the components again yields exactly the original path
+    std::size_t begin = 0;
+    while (true) {
+        auto end = path.find('/', begin);
+        if (end == std::string::npos) {
+            visitor(boost::string_ref(path).substr(begin));
+            return;
+        }
+        visitor(boost::string_ref(path).substr(begin, end - begin));
+        begin = end + 1;
+    }
+}
+}
+
+constexpr std::uint32_t DirectoryRegistry::recursive;
+constexpr std::uint32_t DirectoryRegistry::removed;
+
+std::size_t DirectoryRegistry::NameHash::operator()(boost::string_ref name) const
+{
+    return boost::hash_range(name.begin(), name.end());
+}
+
+DirectoryRegistry::DirectoryRegistry()
+    : mUsedSlots(0)
+    , mSize(0)
+    , mRemovedSize(0)
+    , mPathCache(pathCacheSize, CachedPath { -1, {} })
+{
+    clear();
+}
+
+/**
+ * @brief Stores path and flags for the watch descriptor. A watch
+ *        descriptor that is already known is reassigned to the
+ *        new path.
+ */
+void DirectoryRegistry::insert(int wd, const boost::filesystem::path& path, std::uint32_t flags)
+{
+    if (wd < 0) {
+        throw std::invalid_argument("Invalid watch descriptor " + std::to_string(wd) + ".");
+    }
+
+    erase(wd);
+
+    std::uint32_t node = rootNode;
+    forEachComponent(path.native(), [this, &node](boost::string_ref component) {
+        node = addChild(node, component);
+    });
+
+    if (mNodes[node].wd >= 0) {
+        // The path was registered before under another watch descriptor
+        mWatchNodes[mNodes[node].wd] = noNode;
+        mRemovedSize -= (mWatchFlags[mNodes[node].wd] & removed) ? 1 : 0;
+        --mSize;
+    }
+    mPathCache[wd % pathCacheSize].wd = -1;
+
+    std::size_t index = static_cast<std::size_t>(wd);
+    if (index >= mWatchNodes.size()) {
+        mWatchNodes.resize(index + 1, noNode);
+        mWatchFlags.resize(index + 1, 0);
+    }
+    mWatchNodes[index] = node;
+    mWatchFlags[index] = flags;
+    mNodes[node].wd = wd;
+    ++mSize;
+}
+
+void DirectoryRegistry::erase(int wd)
+{
+    if (!contains(wd)) {
+        return;
+    }
+
+    std::uint32_t node = mWatchNodes[wd];
+    mWatchNodes[wd] = noNode;
+    mNodes[node].wd = -1;
+    mPathCache[wd % pathCacheSize].wd = -1;
+    mRemovedSize -= (mWatchFlags[wd] & removed) ? 1 : 0;
+    --mSize;
+
+    prune(node);
+}
+
+/**
+ * @brief Moves the registered path from and everything below it to
+ *        path to, e.g. after a directory was renamed. Only the
+ *        moved node changes, thus the cost does not depend on the
+ *        size of the subtree. Registered paths at to are replaced.
+ *
+ * @return false if from is not registered
+ */
+bool DirectoryRegistry::rename(
+    const boost::filesystem::path& from, const boost::filesystem::path& to)
+{
+    std::uint32_t node = findNode(from);
+    if (node == noNode || from == to) {
+        return node != noNode;
+    }
+
+    // The target was replaced by the rename, its watches are stale
+    for (int wd : subtree(to)) {
+        erase(wd);
+    }
+
+    std::vector<boost::string_ref> components;
+    forEachComponent(to.native(), [&components](boost::string_ref component) {
+        components.push_back(component);
+    });
+
+    // The unlinked node is not reachable while the old parents are pruned
+    std::uint32_t oldParent = mNodes[node].parent;
+    std::uint32_t oldName = mNodes[node].name;
+    unlinkNode(node);
+    prune(oldParent);
+
+    std::uint32_t parent = rootNode;
+    for (std::size_t i = 0; i + 1 < components.size(); ++i) {
+        parent = addChild(parent, components[i]);
+    }
+    mNodes[node].name = internName(components.back());
+    releaseName(oldName);
+    linkNode(node, parent);
+
+    // Paths of the whole subtree changed
+    for (auto& cachedPath : mPathCache) {
+        cachedPath.wd = -1;
+    }
+    return true;
+}
+
+/**
+ * @brief Drops the components which are not needed by any registered
+ *        path anymore, starting at node up to the root
+ */
+void DirectoryRegistry::prune(std::uint32_t node)
+{
+    while (node != rootNode && mNodes[node].wd == -1 && mNodes[node].firstChild == noNode) {
+        std::uint32_t parent = mNodes[node].parent;
+        releaseNode(node);
+        node = parent;
+    }
+}
+
+void DirectoryRegistry::clear()
+{
+    mNodes.assign(1, Node { rootNode, 0, noNode, noNode, noNode, -1 });
+    mFreeNodes.clear();
+    mSlots.assign(16, noNode);
+    mUsedSlots = 0;
+    mNames.clear();
+    mNameReferences.clear();
+    mFreeNames.clear();
+    mNameIds.clear();
+    mWatchNodes.clear();
+    mWatchFlags.clear();
+    mSize = 0;
+    mRemovedSize = 0;
+    for (auto& cachedPath : mPathCache) {
+        cachedPath.wd = -1;
+    }
+}
+
+bool DirectoryRegistry::contains(int wd) const
+{
+    return wd >= 0 && static_cast<std::size_t>(wd) < mWatchNodes.size()
+        && mWatchNodes[wd] != noNode;
+}
+
+/**
+ * @return flags the watch descriptor was inserted with, 0 if unknown
+ */
+auto DirectoryRegistry::flags(int wd) const -> std::uint32_t
+{
+    return contains(wd) ? mWatchFlags[wd] : 0;
+}
+
+/**
+ * @brief Replaces the flags of a registered watch descriptor, unknown
+ *        ones are left alone
+ */
+void DirectoryRegistry::setFlags(int wd, std::uint32_t flags)
+{
+    if (!contains(wd)) {
+        return;
+    }
+
+    mRemovedSize -= (mWatchFlags[wd] & removed) ? 1 : 0;
+    mRemovedSize += (flags & removed) ? 1 : 0;
+    mWatchFlags[wd] = flags;
+}
+
+/**
+ * @brief Returns the path of a watch descriptor. The path is
+ *        rebuilt from its components unless it is cached.
+ *
+ * @throws std::out_of_range if the watch descriptor is not registered
+ */
+auto DirectoryRegistry::path(int wd) const -> boost::filesystem::path
+{
+    return cachedPath(wd);
+}
+
+/**
+ * @brief Copies the path of a watch descriptor into path like
+ *        path(wd). Its storage is reused, thus this does not allocate
+ *        once path has grown to the length of the watched paths.
+ *
+ * @throws std::out_of_range if the watch descriptor is not registered
+ */
+void DirectoryRegistry::assignPath(int wd, boost::filesystem::path& path) const
+{
+    path = cachedPath(wd);
+}
+
+/**
+ * @brief Entry of the path cache, overwritten by the next lookup of a
+ *        watch descriptor in the same slot
+ */
+auto DirectoryRegistry::cachedPath(int wd) const -> const boost::filesystem::path&
+{
+    if (!contains(wd)) {
+        throw std::out_of_range("Unknown watch descriptor " + std::to_string(wd) + ".");
+    }
+
+    auto& cachedPath = mPathCache[wd % pathCacheSize];
+    if (cachedPath.wd != wd) {
+        std::string path;
+        buildPath(mWatchNodes[wd], path);
+        cachedPath.path = std::move(path);
+        cachedPath.wd = wd;
+    }
+
+    return cachedPath.path;
+}
+
+/**
+ * @brief Looks up the watch descriptor of a path
+ *
+ * @return watch descriptor or -1 if the path is not registered
+ */
+auto DirectoryRegistry::find(const boost::filesystem::path& path) const -> int
+{
+    std::uint32_t node = findNode(path);
+    return node == noNode ? -1 : mNodes[node].wd;
+}
+
+/**
+ * @brief Collects the watch descriptors of path and of all
+ *        registered paths below it. Takes time proportional
+ *        to the size of the subtree.
+ *
+ * @return watch descriptors, children before their parents
+ */
+auto DirectoryRegistry::subtree(const boost::filesystem::path& path) const -> std::vector<int>
+{
+    std::vector<int> wds;
+    std::uint32_t node = findNode(path);
+    if (node != noNode) {
+        collectSubtree(node, wds);
+    }
+    return wds;
+}
+
+auto DirectoryRegistry::subtree(int wd) const -> std::vector<int>
+{
+    std::vector<int> wds;
+    if (contains(wd)) {
+        collectSubtree(mWatchNodes[wd], wds);
+    }
+    return wds;
+}
+
+void DirectoryRegistry::collectSubtree(std::uint32_t node, std::vector<int>& wds) const
+{
+    std::vector<std::uint32_t> nodes { node };
+    std::size_t first = wds.size();
+    while (!nodes.empty()) {
+        std::uint32_t current = nodes.back();
+        nodes.pop_back();
+
+        if (mNodes[current].wd >= 0) {
+            wds.push_back(mNodes[current].wd);
+        }
+        for (std::uint32_t child = mNodes[current].firstChild; child != noNode;
+             child = mNodes[child].nextSibling) {
+            nodes.push_back(child);
+        }
+    }
+
+    // Preorder reversed: every child comes before its parent
+    std::reverse(wds.begin() + first, wds.end());
+}
+
+auto DirectoryRegistry::size() const -> std::size_t
+{
+    return mSize;
+}
+
+/**
+ * @return number of registered watch descriptors marked as removed
+ */
+auto DirectoryRegistry::removedSize() const -> std::size_t
+{
+    return mRemovedSize;
+}
+
+/**
+ * @return all registered watch descriptors in ascending order
+ */
+auto DirectoryRegistry::watches() const -> std::vector<int>
+{
+    std::vector<int> wds;
+    wds.reserve(mSize);
+    for (std::size_t wd = 0; wd < mWatchNodes.size(); ++wd) {
+        if (mWatchNodes[wd] != noNode) {
+            wds.push_back(static_cast<int>(wd));
+        }
+    }
+    return wds;
+}
+
+auto DirectoryRegistry::findNode(const boost::filesystem::path& path) const -> std::uint32_t
+{
+    std::uint32_t node = rootNode;
+    bool found = true;
+    forEachComponent(path.native(), [this, &node, &found](boost::string_ref component) {
+        if (found) {
+            std::uint32_t name = findName(component);
+            node = name == noNode ? noNode : findChild(node, name);
+            found = node != noNode;
+        }
+    });
+    return found ? node : noNode;
+}
+
+void DirectoryRegistry::buildPath(std::uint32_t node, std::string& path) const
+{
+    if (mNodes[node].parent != rootNode) {
+        buildPath(mNodes[node].parent, path);
+        path += '/';
+    }
+    path += mNames[mNodes[node].name - 1];
+}
+
+auto DirectoryRegistry::addChild(std::uint32_t parent, boost::string_ref name) -> std::uint32_t
+{
+    std::uint32_t nameId = findName(name);
+    if (nameId != noNode) {
+        std::uint32_t child = findChild(parent, nameId);
+        if (child != noNode) {
+            return child;
+        }
+    }
+
+    nameId = internName(name);
+
+    std::uint32_t child;
+    if (mFreeNodes.empty()) {
+        child = static_cast<std::uint32_t>(mNodes.size());
+        mNodes.push_back(Node {});
+    } else {
+        child = mFreeNodes.back();
+        mFreeNodes.pop_back();
+    }
+
+    mNodes[child] = Node { parent, nameId, noNode, noNode, noNode, -1 };
+    linkNode(child, parent);
+    return child;
+}
+
+void DirectoryRegistry::releaseNode(std::uint32_t node)
+{
+    unlinkNode(node);
+    releaseName(mNodes[node].name);
+    mFreeNodes.push_back(node);
+}
+
+/**
+ * @brief Adds node to the children of parent
+ */
+void DirectoryRegistry::linkNode(std::uint32_t node, std::uint32_t parent)
+{
+    std::uint32_t sibling = mNodes[parent].firstChild;
+    mNodes[node].parent = parent;
+    mNodes[node].previousSibling = noNode;
+    mNodes[node].nextSibling = sibling;
+    if (sibling != noNode) {
+        mNodes[sibling].previousSibling = node;
+    }
+    mNodes[parent].firstChild = node;
+
+    insertSlot(node);
+}
+
+/**
+ * @brief Removes node from the children of its parent
+ */
+void DirectoryRegistry::unlinkNode(std::uint32_t node)
+{
+    eraseSlot(node);
+
+    Node& entry = mNodes[node];
+    if (entry.previousSibling != noNode) {
+        mNodes[entry.previousSibling].nextSibling = entry.nextSibling;
+    } else {
+        mNodes[entry.parent].firstChild = entry.nextSibling;
+    }
+    if (entry.nextSibling != noNode) {
+        mNodes[entry.nextSibling].previousSibling = entry.previousSibling;
+    }
+}
+
+/**
+ * @return id of the interned name starting at 1, 0 if unknown
+ */
+auto DirectoryRegistry::findName(boost::string_ref name) const -> std::uint32_t
+{
+    auto id = mNameIds.find(name);
+    return id == mNameIds.end() ? noNode : id->second;
+}
+
+auto DirectoryRegistry::internName(boost::string_ref name) -> std::uint32_t
+{
+    std::uint32_t id = findName(name);
+    if (id == noNode) {
+        if (mFreeNames.empty()) {
+            mNames.emplace_back(name.begin(), name.end());
+            mNameReferences.push_back(0);
+            id = static_cast<std::uint32_t>(mNames.size());
+        } else {
+            id = mFreeNames.back();
+            mFreeNames.pop_back();
+            mNames[id - 1].assign(name.begin(), name.end());
+        }
+        mNameIds.emplace(boost::string_ref(mNames[id - 1]), id);
+    }
+
+    ++mNameReferences[id - 1];
+    return id;
+}
+
+void DirectoryRegistry::releaseName(std::uint32_t name)
+{
+    if (--mNameReferences[name - 1] == 0) {
+        mNameIds.erase(boost::string_ref(mNames[name - 1]));
+        std::string().swap(mNames[name - 1]);
+        mFreeNames.push_back(name);
+    }
+}
+
+auto DirectoryRegistry::slot(std::uint32_t parent, std::uint32_t name) const -> std::size_t
+{
+    std::uint64_t key = (static_cast<std::uint64_t>(parent) << 32) | name;
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return static_cast<std::size_t>(key) & (mSlots.size() - 1);
+}
+
+auto DirectoryRegistry::findChild(std::uint32_t parent, std::uint32_t name) const
+    -> std::uint32_t
+{
+    std::size_t mask = mSlots.size() - 1;
+    for (std::size_t i = slot(parent, name); mSlots[i] != noNode; i = (i + 1) & mask) {
+        const Node& node = mNodes[mSlots[i]];
+        if (node.parent == parent && node.name == name) {
+            return mSlots[i];
+        }
+    }
+    return noNode;
+}
+
+void DirectoryRegistry::insertSlot(std::uint32_t node)
+{
+    if ((mUsedSlots + 1) * 2 > mSlots.size()) {
+        growSlots();
+    }
+
+    std::size_t mask = mSlots.size() - 1;
+    std::size_t i = slot(mNodes[node].parent, mNodes[node].name);
+    while (mSlots[i] != noNode) {
+        i = (i + 1) & mask;
+    }
+    mSlots[i] = node;
+    ++mUsedSlots;
+}
+
+void DirectoryRegistry::eraseSlot(std::uint32_t node)
+{
+    std::size_t mask = mSlots.size() - 1;
+    std::size_t i = slot(mNodes[node].parent, mNodes[node].name);
+    while (mSlots[i] != node) {
+        i = (i + 1) & mask;
+    }
+
+    // Backward shift deletion keeps the probe sequences intact without tombstones
+    std::size_t j = i;
+    while (true) {
+        j = (j + 1) & mask;
+        if (mSlots[j] == noNode) {
+            break;
+        }
+        std::size_t home = slot(mNodes[mSlots[j]].parent, mNodes[mSlots[j]].name);
+        bool between = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+        if (!between) {
+            mSlots[i] = mSlots[j];
+            i = j;
+        }
+    }
+    mSlots[i] = noNode;
+    --mUsedSlots;
+}
+
+void DirectoryRegistry::growSlots()
+{
+    std::vector<std::uint32_t> slots(mSlots.size() * 2, noNode);
+    slots.swap(mSlots);
+    mUsedSlots = 0;
+    for (std::uint32_t node : slots) {
+        if (node != noNode) {
+            insertSlot(node);
+        }
+    }
+}
+}
@@ -0,0 +1,233 @@
+#include <inotify-cpp/DirectorySnapshots.h>
+
+#include <dirent.h>
+#include <fcntl.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+
+namespace inotify {
+
+namespace {
+    std::uint64_t modificationTime(const struct stat& status)
+    {
+        return static_cast<std::uint64_t>(status.st_mtim.tv_sec) * 1000000000u
+            + static_cast<std::uint64_t>(status.st_mtim.tv_nsec);
+    }
+
+    bool statPath(const boost::filesystem::path& path, DirectorySnapshots::Snapshot& snapshot)
+    {
+        struct stat status;
+        if (stat(path.c_str(), &status) == -1) {
+            return false;
+        }
+
+        snapshot.mtime = modificationTime(status);
+        snapshot.size = static_cast<std::uint64_t>(status.st_size);
+        snapshot.directory = S_ISDIR(status.st_mode);
+        return true;
+    }
+
+    bool statEntry(int directoryFd, const char* name, DirectorySnapshots::Entry& entry)
+    {
+        struct stat status;
+        if (fstatat(directoryFd, name, &status, AT_SYMLINK_NOFOLLOW) == -1) {
+            return false;
+        }
+
+        entry.mtime = modificationTime(status);
+        entry.size = static_cast<std::uint64_t>(status.st_size);
+        entry.directory = S_ISDIR(status.st_mode);
+        return true;
+    }
+}
+
+constexpr std::uint64_t DirectorySnapshots::touched;
+
+/**
+ * @brief Records the current state of the watched path
+ *
+ * @return false if the path could not be read
+ *
+ */
+auto DirectorySnapshots::take(int wd, const boost::filesystem::path& path) -> bool
+{
+    Snapshot snapshot;
+    if (!statPath(path, snapshot) || !scan(path, snapshot.directory, snapshot)) {
+        return false;
+    }
+
+    mSnapshots[wd] = std::move(snapshot);
+    return true;
+}
+
+/**
+ * @brief Applies an event of the watch to its snapshot
+ */
+auto DirectorySnapshots::update(int wd, std::uint32_t mask, boost::string_ref name) -> void
+{
+    auto found = mSnapshots.find(wd);
+    if (found == mSnapshots.end()) {
+        return;
+    }
+
+    auto& snapshot = found->second;
+    const std::uint32_t changeMask = IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE;
+    if (name.empty()) {
+        if (!snapshot.directory && (mask & changeMask)) {
+            snapshot.mtime = touched;
+        }
+        return;
+    }
+
+    std::string entryName(name.begin(), name.end());
+    if (mask & (IN_DELETE | IN_MOVED_FROM)) {
+        snapshot.entries.erase(entryName);
+    } else if (mask & (IN_CREATE | IN_MOVED_TO)) {
+        snapshot.entries[entryName] = Entry { touched, 0, (mask & IN_ISDIR) != 0 };
+    } else if (mask & changeMask) {
+        auto entry = snapshot.entries.find(entryName);
+        if (entry != snapshot.entries.end()) {
+            entry->second.mtime = touched;
+        }
+    }
+}
+
+/**
+ * @brief Compares the snapshot of the watch with the file system,
+ *        reports the differences as create, remove and modify
+ *        events and stores the current state.
+ *
+ *        Entries marked as touched are reported as modified if they
+ *        still exist, their changes after the mark are unknown.
+ *
+ * @return false if the watched path itself is gone
+ *
+ */
+auto DirectorySnapshots::rescan(
+    int wd, const boost::filesystem::path& path, const Change& onChange) -> bool
+{
+    auto found = mSnapshots.find(wd);
+    if (found == mSnapshots.end()) {
+        return true;
+    }
+
+    auto& previous = found->second;
+    Snapshot current;
+    if (!statPath(path, current)) {
+        mSnapshots.erase(found);
+        return false;
+    }
+
+    if (!previous.directory) {
+        if (previous.mtime == touched || previous.mtime != current.mtime
+            || previous.size != current.size) {
+            onChange(IN_MODIFY, std::string());
+        }
+        previous = std::move(current);
+        return true;
+    }
+
+    // Entries were only added or removed if the directory changed
+    if (current.mtime == previous.mtime) {
+        current.entries = previous.entries;
+    }
+    if (!scan(path, current.mtime != previous.mtime, current)) {
+        mSnapshots.erase(found);
+        return false;
+    }
+
+    for (const auto& entry : current.entries) {
+        auto known = previous.entries.find(entry.first);
+        if (known == previous.entries.end()) {
+            onChange(IN_CREATE | (entry.second.directory ? IN_ISDIR : 0), entry.first);
+        } else if (!entry.second.directory
+            && (known->second.mtime == touched || known->second.mtime != entry.second.mtime
+                || known->second.size != entry.second.size)) {
+            onChange(IN_MODIFY, entry.first);
+        }
+    }
+    for (const auto& entry : previous.entries) {
+        if (!current.entries.count(entry.first)) {
+            onChange(IN_DELETE | (entry.second.directory ? IN_ISDIR : 0), entry.first);
+        }
+    }
+
+    previous = std::move(current);
+    return true;
+}
+
+auto DirectorySnapshots::erase(int wd) -> void
+{
+    mSnapshots.erase(wd);
+}
+
+auto DirectorySnapshots::clear() -> void
+{
+    mSnapshots.clear();
+}
+
+auto DirectorySnapshots::contains(int wd) const -> bool
+{
+    return mSnapshots.count(wd) != 0;
+}
+
+auto DirectorySnapshots::watches() const -> std::vector<int>
+{
+    std::vector<int> wds;
+    wds.reserve(mSnapshots.size());
+    for (const auto& snapshot : mSnapshots) {
+        wds.push_back(snapshot.first);
+    }
+    return wds;
+}
+
+auto DirectorySnapshots::size() const -> std::size_t
+{
+    return mSnapshots.size();
+}
+
+/**
+ * @brief Fills the entries of a directory snapshot. Without listing
+ *        only the entries already in the snapshot are stat'ed again,
+ *        the ones that vanished are dropped.
+ */
+auto DirectorySnapshots::scan(
+    const boost::filesystem::path& path, bool listEntries, Snapshot& snapshot) -> bool
+{
+    if (!snapshot.directory) {
+        return true;
+    }
+
+    DIR* directory = opendir(path.c_str());
+    if (!directory) {
+        return false;
+    }
+    int directoryFd = dirfd(directory);
+
+    if (listEntries) {
+        snapshot.entries.clear();
+        while (dirent* entry = readdir(directory)) {
+            if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..")) {
+                continue;
+            }
+
+            Entry status;
+            if (statEntry(directoryFd, entry->d_name, status)) {
+                snapshot.entries.emplace(entry->d_name, status);
+            }
+        }
+    } else {
+        for (auto entry = snapshot.entries.begin(); entry != snapshot.entries.end();) {
+            if (statEntry(directoryFd, entry->first.c_str(), entry->second)) {
+                ++entry;
+            } else {
+                entry = snapshot.entries.erase(entry);
+            }
+        }
+    }
+
+    closedir(directory);
+    return true;
+}
+}
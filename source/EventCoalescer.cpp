@@ -0,0 +1,321 @@
+#include <inotify-cpp/EventCoalescer.h>
+
+#include <sys/inotify.h>
+
+#include <algorithm>
+#include <functional>
+
+namespace inotify {
+
+namespace {
+    // Close and remove events end a burst, nothing is merged after them
+    const std::uint32_t flushMask = IN_CLOSE_WRITE | IN_DELETE | IN_DELETE_SELF;
+    const std::uint32_t passMask = IN_MOVE | IN_MOVE_SELF | IN_IGNORED | IN_Q_OVERFLOW | IN_UNMOUNT;
+
+    // The quiet period spans this many ticks, deadlines never wrap the wheel
+    const std::int64_t ticksPerPeriod = 64;
+}
+
+constexpr std::size_t EventCoalescer::wheelSize;
+constexpr std::uint32_t EventCoalescer::noEntry;
+
+EventCoalescer::EventCoalescer(std::chrono::milliseconds quietPeriod)
+    : mQuietPeriod(0)
+    , mTick(std::chrono::milliseconds(1))
+    , mOrigin(Clock::now())
+    , mCurrentTick(0)
+    , mWheel(wheelSize, Slot { noEntry, noEntry })
+    , mSlots(16, noEntry)
+    , mPending(0)
+{
+    setQuietPeriod(quietPeriod);
+}
+
+/**
+ * @brief Sets the time a path has to be quiet before its merged event
+ *        is emitted. A period of zero disables the coalescing. Pending
+ *        events keep their deadlines.
+ */
+auto EventCoalescer::setQuietPeriod(std::chrono::milliseconds quietPeriod) -> void
+{
+    mQuietPeriod = quietPeriod;
+    mTick = std::max<Clock::duration>(
+        std::chrono::milliseconds(1), Clock::duration(quietPeriod) / ticksPerPeriod);
+
+    // Rebuild the wheel for the new tick length
+    std::fill(mWheel.begin(), mWheel.end(), Slot { noEntry, noEntry });
+    mOrigin = Clock::now();
+    mCurrentTick = 0;
+    for (auto entry : mSlots) {
+        if (entry != noEntry) {
+            schedule(entry);
+        }
+    }
+}
+
+auto EventCoalescer::enabled() const -> bool
+{
+    return mQuietPeriod.count() > 0;
+}
+
+/**
+ * @brief Merges the event into the pending event of its key or holds
+ *        it back as the next pending one
+ *
+ * @return false if the event was merged, it is not moved from then
+ *         and its storage can be reused
+ */
+auto EventCoalescer::process(
+    FileSystemEvent&& event, Clock::time_point now, std::vector<FileSystemEvent>& out) -> bool
+{
+    auto hash = hashOf(event.wd, event.path.native());
+    auto key = findEntry(event.wd, event.path.native(), hash);
+    bool pending = key != noEntry;
+
+    if (event.mask & passMask) {
+        if (pending) {
+            emit(key, out);
+        }
+        out.push_back(std::move(event));
+        return true;
+    }
+
+    std::uint32_t entry;
+    if (pending) {
+        entry = key;
+        unschedule(entry);
+        mEntries[entry].tick = 0;
+        mEntries[entry].event.mask |= event.mask;
+    } else {
+        if (mFreeEntries.empty()) {
+            entry = static_cast<std::uint32_t>(mEntries.size());
+            mEntries.push_back(Entry { std::move(event), hash, now, 0, noEntry, noEntry });
+        } else {
+            entry = mFreeEntries.back();
+            mFreeEntries.pop_back();
+            mEntries[entry].event = std::move(event);
+            mEntries[entry].hash = hash;
+        }
+        insertSlot(entry);
+    }
+
+    if (mEntries[entry].event.mask & flushMask) {
+        emit(entry, out);
+        return !pending;
+    }
+
+    mEntries[entry].deadline = now + mQuietPeriod;
+    schedule(entry);
+    return !pending;
+}
+
+/**
+ * @brief Emits the events of all paths that were quiet for the whole
+ *        period, in the order of their deadlines
+ */
+auto EventCoalescer::flushExpired(Clock::time_point now, std::vector<FileSystemEvent>& out) -> void
+{
+    if (now < mOrigin) {
+        return;
+    }
+
+    // Ticks completely elapsed until now
+    auto nowTick = static_cast<std::uint64_t>((now - mOrigin) / mTick);
+    if (mPending == 0) {
+        mCurrentTick = std::max(mCurrentTick, nowTick);
+        return;
+    }
+
+    auto steps = std::min<std::uint64_t>(nowTick - std::min(nowTick, mCurrentTick), wheelSize);
+    for (std::uint64_t step = 1; step <= steps; ++step) {
+        auto& slot = mWheel[(mCurrentTick + step) % wheelSize];
+        auto entry = slot.head;
+        while (entry != noEntry) {
+            auto next = mEntries[entry].next;
+            if (mEntries[entry].tick <= nowTick) {
+                emit(entry, out);
+            }
+            entry = next;
+        }
+    }
+    mCurrentTick = std::max(mCurrentTick, nowTick);
+}
+
+/**
+ * @brief Emits all pending events regardless of their deadlines
+ */
+auto EventCoalescer::flushAll(std::vector<FileSystemEvent>& out) -> void
+{
+    for (std::uint64_t step = 1; step <= wheelSize && mPending != 0; ++step) {
+        auto& slot = mWheel[(mCurrentTick + step) % wheelSize];
+        while (slot.head != noEntry) {
+            emit(slot.head, out);
+        }
+    }
+}
+
+/**
+ * @return end of the tick in which the earliest pending path expires
+ */
+auto EventCoalescer::nextDeadline() const -> boost::optional<Clock::time_point>
+{
+    if (mPending == 0) {
+        return boost::none;
+    }
+
+    // Entries of later rounds share slots with the ones of this round
+    auto lastTick = mCurrentTick + wheelSize;
+    for (std::uint64_t step = 1; step <= wheelSize; ++step) {
+        const auto& slot = mWheel[(mCurrentTick + step) % wheelSize];
+        for (auto entry = slot.head; entry != noEntry; entry = mEntries[entry].next) {
+            if (mEntries[entry].tick <= lastTick) {
+                return mOrigin + mTick * static_cast<Clock::rep>(mEntries[entry].tick);
+            }
+        }
+    }
+    return mOrigin + mTick * static_cast<Clock::rep>(lastTick);
+}
+
+auto EventCoalescer::pending() const -> std::size_t
+{
+    return mPending;
+}
+
+/**
+ * @return first tick that completely elapsed after time
+ */
+auto EventCoalescer::tickOf(Clock::time_point time) const -> std::uint64_t
+{
+    if (time <= mOrigin) {
+        return 0;
+    }
+    return static_cast<std::uint64_t>((time - mOrigin + mTick - Clock::duration(1)) / mTick);
+}
+
+auto EventCoalescer::schedule(std::uint32_t entry) -> void
+{
+    auto& scheduled = mEntries[entry];
+    scheduled.tick = std::max(tickOf(scheduled.deadline), mCurrentTick + 1);
+
+    auto& slot = mWheel[scheduled.tick % wheelSize];
+    scheduled.previous = slot.tail;
+    scheduled.next = noEntry;
+    if (slot.tail == noEntry) {
+        slot.head = entry;
+    } else {
+        mEntries[slot.tail].next = entry;
+    }
+    slot.tail = entry;
+}
+
+auto EventCoalescer::unschedule(std::uint32_t entry) -> void
+{
+    auto& scheduled = mEntries[entry];
+    auto& slot = mWheel[scheduled.tick % wheelSize];
+    if (scheduled.previous == noEntry) {
+        slot.head = scheduled.next;
+    } else {
+        mEntries[scheduled.previous].next = scheduled.next;
+    }
+    if (scheduled.next == noEntry) {
+        slot.tail = scheduled.previous;
+    } else {
+        mEntries[scheduled.next].previous = scheduled.previous;
+    }
+}
+
+/**
+ * @brief Moves the merged event of entry to out and releases the entry
+ */
+auto EventCoalescer::emit(std::uint32_t entry, std::vector<FileSystemEvent>& out) -> void
+{
+    auto& pending = mEntries[entry];
+    if (findEntry(pending.event.wd, pending.event.path.native(), pending.hash) != entry) {
+        return;
+    }
+    eraseSlot(entry);
+
+    // Entries flushed before they were scheduled are not linked yet
+    if (pending.tick != 0) {
+        unschedule(entry);
+    }
+    pending.tick = 0;
+    out.push_back(std::move(pending.event));
+    mFreeEntries.push_back(entry);
+}
+
+auto EventCoalescer::hashOf(int wd, const std::string& path) -> std::size_t
+{
+    std::uint64_t key = std::hash<std::string>()(path) ^ static_cast<std::uint32_t>(wd);
+    key ^= key >> 33;
+    key *= 0xff51afd7ed558ccdULL;
+    key ^= key >> 33;
+    return static_cast<std::size_t>(key);
+}
+
+auto EventCoalescer::findEntry(int wd, const std::string& path, std::size_t hash) const
+    -> std::uint32_t
+{
+    std::size_t mask = mSlots.size() - 1;
+    for (std::size_t i = hash & mask; mSlots[i] != noEntry; i = (i + 1) & mask) {
+        const auto& event = mEntries[mSlots[i]].event;
+        if (event.wd == wd && event.path.native() == path) {
+            return mSlots[i];
+        }
+    }
+    return noEntry;
+}
+
+auto EventCoalescer::insertSlot(std::uint32_t entry) -> void
+{
+    if ((mPending + 1) * 2 > mSlots.size()) {
+        growSlots();
+    }
+
+    std::size_t mask = mSlots.size() - 1;
+    std::size_t i = mEntries[entry].hash & mask;
+    while (mSlots[i] != noEntry) {
+        i = (i + 1) & mask;
+    }
+    mSlots[i] = entry;
+    ++mPending;
+}
+
+auto EventCoalescer::eraseSlot(std::uint32_t entry) -> void
+{
+    std::size_t mask = mSlots.size() - 1;
+    std::size_t i = mEntries[entry].hash & mask;
+    while (mSlots[i] != entry) {
+        i = (i + 1) & mask;
+    }
+
+    // Backward shift deletion keeps the probe sequences intact without tombstones
+    std::size_t j = i;
+    while (true) {
+        j = (j + 1) & mask;
+        if (mSlots[j] == noEntry) {
+            break;
+        }
+        std::size_t home = mEntries[mSlots[j]].hash & mask;
+        bool between = (i <= j) ? (i < home && home <= j) : (i < home || home <= j);
+        if (!between) {
+            mSlots[i] = mSlots[j];
+            i = j;
+        }
+    }
+    mSlots[i] = noEntry;
+    --mPending;
+}
+
+auto EventCoalescer::growSlots() -> void
+{
+    std::vector<std::uint32_t> slots(mSlots.size() * 2, noEntry);
+    slots.swap(mSlots);
+    mPending = 0;
+    for (auto entry : slots) {
+        if (entry != noEntry) {
+            insertSlot(entry);
+        }
+    }
+}
+}
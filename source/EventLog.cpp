@@ -0,0 +1,319 @@
+#include <inotify-cpp/EventLog.h>
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/inotify.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace inotify {
+
+namespace {
+    const char magic[8] = { 'I', 'N', 'O', 'T', 'I', 'F', 'Y', 'L' };
+    const std::uint32_t version = 1;
+
+    // Buffered records are written once they exceed this size
+    const std::size_t flushSize = 64 * 1024;
+
+    // Bounds the tables indexed by the watch descriptors of a replay
+    const int maxWatchDescriptor = 1 << 26;
+
+    struct Header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t reserved;
+    };
+
+    struct RecordHeader {
+        std::uint64_t time;
+        std::uint32_t type;
+        std::uint32_t size;
+    };
+
+    struct WatchRecord {
+        std::int32_t wd;
+        std::uint32_t flags;
+    };
+
+    const char zeros[8] = {};
+
+    std::size_t padding(std::size_t size)
+    {
+        return (8 - size % 8) % 8;
+    }
+
+    bool writeAll(int fd, const void* data, std::size_t size)
+    {
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0) {
+            ssize_t written = write(fd, bytes, size);
+            if (written == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            bytes += written;
+            size -= static_cast<std::size_t>(written);
+        }
+        return true;
+    }
+
+    bool readAll(int fd, void* data, std::size_t size)
+    {
+        char* bytes = static_cast<char*>(data);
+        while (size > 0) {
+            ssize_t read = ::read(fd, bytes, size);
+            if (read == -1 && errno == EINTR) {
+                continue;
+            }
+            if (read <= 0) {
+                return false;
+            }
+            bytes += read;
+            size -= static_cast<std::size_t>(read);
+        }
+        return true;
+    }
+
+    bool validEvents(const char* events, std::size_t length)
+    {
+        std::size_t i = 0;
+        while (i < length) {
+            if (length - i < sizeof(inotify_event)) {
+                return false;
+            }
+            const auto* event = reinterpret_cast<const inotify_event*>(events + i);
+            if (event->len > length - i - sizeof(inotify_event) || event->wd < -1
+                || event->wd >= maxWatchDescriptor
+                || ((event->mask & IN_Q_OVERFLOW) && event->wd != -1)) {
+                return false;
+            }
+            i += sizeof(inotify_event) + event->len;
+        }
+        return true;
+    }
+}
+
+EventLogWriter::EventLogWriter()
+    : mFd(-1)
+    , mFailed(false)
+    , mError(0)
+{
+}
+
+EventLogWriter::~EventLogWriter()
+{
+    close();
+}
+
+/**
+ * @brief Starts a new log, the times of the records are relative to
+ *        this call
+ *
+ * @return false if the file could not be created, errno is set
+ */
+auto EventLogWriter::open(const boost::filesystem::path& file) -> bool
+{
+    close();
+    mFd = ::open(file.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (mFd == -1) {
+        return false;
+    }
+
+    Header header {};
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    mFailed = false;
+    mStart = std::chrono::steady_clock::now();
+    appendBytes(&header, sizeof(header));
+    return true;
+}
+
+auto EventLogWriter::watch(int wd, std::uint32_t flags, const boost::filesystem::path& path)
+    -> void
+{
+    WatchRecord record { wd, flags };
+    const std::string& native = path.native();
+    auto size = sizeof(record) + native.size();
+    appendHeader(EventLogRecord::watch, size);
+    appendBytes(&record, sizeof(record));
+    appendBytes(native.data(), native.size());
+    appendBytes(zeros, padding(size));
+}
+
+auto EventLogWriter::remove(int wd) -> void
+{
+    WatchRecord record { wd, 0 };
+    appendHeader(EventLogRecord::remove, sizeof(record));
+    appendBytes(&record, sizeof(record));
+}
+
+auto EventLogWriter::events(const char* buffer, std::size_t length) -> void
+{
+    if (length == 0) {
+        return;
+    }
+
+    appendHeader(EventLogRecord::events, length);
+    appendBytes(buffer, length);
+    appendBytes(zeros, padding(length));
+}
+
+/**
+ * @brief Writes the buffered records and closes the file
+ *
+ * @return false if a record could not be written, errno is set
+ */
+auto EventLogWriter::close() -> bool
+{
+    if (mFd == -1) {
+        return true;
+    }
+
+    flush();
+    if (::close(mFd) == -1 && !mFailed) {
+        mFailed = true;
+        mError = errno;
+    }
+    mFd = -1;
+    errno = mError;
+    return !mFailed;
+}
+
+auto EventLogWriter::appendHeader(EventLogRecord::Type type, std::size_t size) -> void
+{
+    if (mBuffer.size() >= flushSize) {
+        flush();
+    }
+
+    RecordHeader header {};
+    header.time = static_cast<std::uint64_t>(
+        std::chrono::duration_cast<std::chrono::nanoseconds>(
+            std::chrono::steady_clock::now() - mStart)
+            .count());
+    header.type = type;
+    header.size = static_cast<std::uint32_t>(size);
+    appendBytes(&header, sizeof(header));
+}
+
+auto EventLogWriter::appendBytes(const void* data, std::size_t size) -> void
+{
+    const char* bytes = static_cast<const char*>(data);
+    mBuffer.insert(mBuffer.end(), bytes, bytes + size);
+}
+
+auto EventLogWriter::flush() -> void
+{
+    // A failed log stays truncated, the records after the failure are dropped
+    if (!mFailed && !writeAll(mFd, mBuffer.data(), mBuffer.size())) {
+        mFailed = true;
+        mError = errno;
+    }
+    mBuffer.clear();
+}
+
+/**
+ * @return false if the file does not exist or is no valid log
+ */
+auto EventLogReader::load(const boost::filesystem::path& file) -> bool
+{
+    mData.clear();
+    mRecords.clear();
+
+    int fd = ::open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) == -1 || static_cast<std::size_t>(status.st_size) < sizeof(Header)) {
+        ::close(fd);
+        return false;
+    }
+
+    auto size = static_cast<std::size_t>(status.st_size);
+    mData.resize((size + 7) / 8);
+    bool read = readAll(fd, mData.data(), size);
+    ::close(fd);
+    if (!read || !validate(size)) {
+        mData.clear();
+        mRecords.clear();
+        return false;
+    }
+    return true;
+}
+
+auto EventLogReader::records() const -> const std::vector<EventLogRecord>&
+{
+    return mRecords;
+}
+
+/**
+ * @brief Checks the header and every record and indexes the records.
+ *        Records are padded, watch descriptors are bounded and the
+ *        events of a buffer end at its end.
+ */
+auto EventLogReader::validate(std::size_t size) -> bool
+{
+    const char* data = reinterpret_cast<const char*>(mData.data());
+    const auto& header = *reinterpret_cast<const Header*>(data);
+    if (memcmp(header.magic, magic, sizeof(magic)) || header.version != version) {
+        return false;
+    }
+
+    std::uint64_t lastTime = 0;
+    std::size_t offset = sizeof(Header);
+    while (offset < size) {
+        if (size - offset < sizeof(RecordHeader)) {
+            return false;
+        }
+        const auto& recordHeader = *reinterpret_cast<const RecordHeader*>(data + offset);
+        offset += sizeof(RecordHeader);
+        if (recordHeader.size > size - offset
+            || padding(recordHeader.size) > size - offset - recordHeader.size
+            || recordHeader.time < lastTime) {
+            return false;
+        }
+        lastTime = recordHeader.time;
+
+        EventLogRecord record {};
+        record.type = static_cast<EventLogRecord::Type>(recordHeader.type);
+        record.time = std::chrono::nanoseconds(recordHeader.time);
+        const char* payload = data + offset;
+        switch (recordHeader.type) {
+        case EventLogRecord::watch:
+        case EventLogRecord::remove: {
+            if (recordHeader.size < sizeof(WatchRecord)) {
+                return false;
+            }
+            const auto& watchRecord = *reinterpret_cast<const WatchRecord*>(payload);
+            if (watchRecord.wd < 0 || watchRecord.wd >= maxWatchDescriptor) {
+                return false;
+            }
+            record.wd = watchRecord.wd;
+            record.flags = watchRecord.flags;
+            record.path = boost::string_ref(
+                payload + sizeof(WatchRecord), recordHeader.size - sizeof(WatchRecord));
+            if (record.type == EventLogRecord::watch && record.path.empty()) {
+                return false;
+            }
+            break;
+        }
+        case EventLogRecord::events:
+            if (!validEvents(payload, recordHeader.size)) {
+                return false;
+            }
+            record.buffer = payload;
+            record.length = recordHeader.size;
+            break;
+        default:
+            return false;
+        }
+
+        mRecords.push_back(record);
+        offset += recordHeader.size + padding(recordHeader.size);
+    }
+    return true;
+}
+}
@@ -0,0 +1,179 @@
+#include <inotify-cpp/EventQueue.h>
+
+#include <sys/inotify.h>
+
+#include <vector>
+
+namespace inotify {
+
+namespace {
+    const std::uint32_t criticalMask
+        = IN_DELETE_SELF | IN_MOVE_SELF | IN_UNMOUNT | IN_Q_OVERFLOW | IN_IGNORED;
+    const std::uint32_t lowMask = IN_ACCESS | IN_OPEN | IN_CLOSE_NOWRITE;
+
+    const std::size_t normalLane = static_cast<std::size_t>(EventPriority::normal);
+    const std::size_t lowLane = static_cast<std::size_t>(EventPriority::low);
+}
+
+constexpr std::size_t EventQueue::lanes;
+
+EventQueue::EventQueue(std::size_t capacity, Shedding shedding)
+    : mCapacity(capacity)
+    , mShedding(shedding)
+    , mSize(0)
+    , mLowFront(0)
+    , mCollapsed(0)
+{
+    for (auto& shed : mShed) {
+        shed = 0;
+    }
+}
+
+/**
+ * @brief Events on the watch or the queue itself are critical, events
+ *        of reads only are low, everything else is normal
+ */
+auto EventQueue::priorityOf(std::uint32_t mask) -> EventPriority
+{
+    if (mask & criticalMask) {
+        return EventPriority::critical;
+    }
+    if ((mask & IN_ALL_EVENTS) && !(mask & IN_ALL_EVENTS & ~lowMask)) {
+        return EventPriority::low;
+    }
+    return EventPriority::normal;
+}
+
+/**
+ * @brief Bounds the queue, queued events are sorted into the lanes and
+ *        shed if they exceed the new capacity
+ *
+ * @param shedding Shedding::none removes the bound
+ */
+auto EventQueue::setCapacity(std::size_t capacity, Shedding shedding) -> void
+{
+    std::vector<FileSystemEvent> events;
+    while (!empty()) {
+        events.push_back(pop());
+    }
+
+    mCapacity = capacity;
+    mShedding = shedding;
+    mLowEvents.clear();
+    for (auto& event : events) {
+        push(std::move(event));
+    }
+}
+
+auto EventQueue::bounded() const -> bool
+{
+    return mShedding != Shedding::none;
+}
+
+auto EventQueue::capacity() const -> std::size_t
+{
+    return mCapacity;
+}
+
+auto EventQueue::push(FileSystemEvent&& event) -> void
+{
+    if (!bounded()) {
+        mLanes[normalLane].push_back(std::move(event));
+        ++mSize;
+        return;
+    }
+
+    auto lane = static_cast<std::size_t>(priorityOf(event.mask));
+    if (mSize >= mCapacity) {
+        if (mShedding == Shedding::collapse && lane == lowLane && collapse(event)) {
+            mCollapsed.fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+
+        // The oldest event of the lowest lane below the new event makes
+        // room, otherwise the new event is the least important one
+        std::size_t victim = lanes - 1;
+        while (victim > lane && mLanes[victim].empty()) {
+            --victim;
+        }
+        if (victim > lane) {
+            popLane(victim);
+            mShed[victim].fetch_add(1, std::memory_order_relaxed);
+        } else if (lane != static_cast<std::size_t>(EventPriority::critical)) {
+            mShed[lane].fetch_add(1, std::memory_order_relaxed);
+            return;
+        }
+    }
+
+    if (lane == lowLane && mShedding == Shedding::collapse) {
+        mLowEvents[event.path.native()] = mLowFront + mLanes[lowLane].size();
+    }
+    mLanes[lane].push_back(std::move(event));
+    ++mSize;
+}
+
+/**
+ * @brief Removes the next event, the queue must not be empty
+ */
+auto EventQueue::pop() -> FileSystemEvent
+{
+    std::size_t lane = 0;
+    while (mLanes[lane].empty()) {
+        ++lane;
+    }
+    return popLane(lane);
+}
+
+auto EventQueue::empty() const -> bool
+{
+    return mSize == 0;
+}
+
+auto EventQueue::size() const -> std::size_t
+{
+    return mSize;
+}
+
+auto EventQueue::getShedEvents(EventPriority priority) const -> std::uint64_t
+{
+    return mShed[static_cast<std::size_t>(priority)].load(std::memory_order_relaxed);
+}
+
+auto EventQueue::getCollapsedEvents() const -> std::uint64_t
+{
+    return mCollapsed.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Merges the mask of a low event into the newest queued low
+ *        event on its path
+ *
+ * @return false if no low event on the path is queued
+ */
+auto EventQueue::collapse(const FileSystemEvent& event) -> bool
+{
+    auto queued = mLowEvents.find(event.path.native());
+    if (queued == mLowEvents.end()) {
+        return false;
+    }
+
+    mLanes[lowLane][queued->second - mLowFront].mask |= event.mask;
+    return true;
+}
+
+auto EventQueue::popLane(std::size_t lane) -> FileSystemEvent
+{
+    FileSystemEvent event = std::move(mLanes[lane].front());
+    mLanes[lane].pop_front();
+    --mSize;
+
+    if (lane == lowLane && mShedding == Shedding::collapse) {
+        auto queued = mLowEvents.find(event.path.native());
+        if (queued != mLowEvents.end() && queued->second == mLowFront) {
+            mLowEvents.erase(queued);
+        }
+        ++mLowFront;
+    }
+    return event;
+}
+}
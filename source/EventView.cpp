@@ -0,0 +1,93 @@
+#include <inotify-cpp/EventView.h>
+
+namespace inotify {
+EventView::EventView(
+    int wd,
+    uint32_t mask,
+    uint32_t cookie,
+    boost::string_ref name,
+    const DirectoryRegistry& directories)
+    : wd(wd)
+    , mask(mask)
+    , cookie(cookie)
+    , name(name)
+    , group(0)
+    , mDirectories(&directories)
+    , mDirectory(nullptr)
+{
+}
+
+EventView::EventView(
+    int wd,
+    uint32_t mask,
+    uint32_t cookie,
+    boost::string_ref name,
+    const boost::filesystem::path& directory)
+    : wd(wd)
+    , mask(mask)
+    , cookie(cookie)
+    , name(name)
+    , group(0)
+    , mDirectories(nullptr)
+    , mDirectory(&directory)
+{
+}
+
+/**
+ * @brief Overflow events have no watch, their directory is empty.
+ */
+auto EventView::directory() const -> boost::filesystem::path
+{
+    boost::filesystem::path directory;
+    assignDirectory(directory);
+    return directory;
+}
+
+/**
+ * @brief Copies the directory like directory() into an existing path,
+ *        reusing its storage
+ */
+auto EventView::assignDirectory(boost::filesystem::path& directory) const -> void
+{
+    if (mDirectory) {
+        directory = *mDirectory;
+    } else if (wd == -1) {
+        directory.clear();
+    } else {
+        mDirectories->assignPath(wd, directory);
+    }
+}
+
+/**
+ * @brief Builds the full path of the event. Events on the
+ *        watched file/directory itself have no name, their
+ *        path is the watched path.
+ */
+auto EventView::path() const -> boost::filesystem::path
+{
+    boost::filesystem::path path;
+    assignPath(path);
+    return path;
+}
+
+/**
+ * @brief Builds the full path like path(), but into an existing
+ *        path. Its storage is reused, thus this does not allocate
+ *        once the path has grown to the length of the event paths.
+ */
+auto EventView::assignPath(boost::filesystem::path& path) const -> void
+{
+    assignDirectory(path);
+    if (name.empty()) {
+        return;
+    }
+
+    // Appended by character, the range overloads of path copy the name first
+    if (!path.empty() && path.native().back() != '/') {
+        path += '/';
+    }
+    for (char character : name) {
+        path += character;
+    }
+}
+}
@@ -0,0 +1,339 @@
+#include <inotify-cpp/FanotifySource.h>
+
+#include <fcntl.h>
+#include <limits.h>
+#include <string.h>
+#include <sys/fanotify.h>
+#include <sys/inotify.h>
+#include <unistd.h>
+
+#include <sstream>
+#include <stdexcept>
+
+namespace inotify {
+
+namespace {
+    const std::size_t bufferSize = 256 * 1024;
+
+    // A full cache is dropped and refilled on demand
+    const std::size_t maxCachedDirectories = 65536;
+
+    // Above the cookies of inotify, both are paired by the same matcher
+    const std::uint32_t firstCookie = 1u << 31;
+
+    // Merged events are split in the order the changes usually happen
+    const std::uint32_t splitOrder[] = { IN_CREATE,      IN_MOVED_TO,     IN_OPEN,
+                                         IN_ACCESS,      IN_MODIFY,       IN_ATTRIB,
+                                         IN_CLOSE_WRITE, IN_CLOSE_NOWRITE, IN_MOVED_FROM,
+                                         IN_DELETE,      IN_DELETE_SELF,  IN_MOVE_SELF };
+
+    std::uint32_t supportedEvents(FanotifySource::Mark mark)
+    {
+        // Directory entry and self events need inode or filesystem marks
+        return mark == FanotifySource::Mark::filesystem
+            ? IN_ALL_EVENTS
+            : IN_ACCESS | IN_MODIFY | IN_OPEN | IN_CLOSE;
+    }
+
+    std::runtime_error fanotifyError(const std::string& message, const boost::filesystem::path& path)
+    {
+        std::stringstream errorStream;
+        errorStream << message << " " << strerror(errno) << ". Path: " << path.string();
+        return std::runtime_error(errorStream.str());
+    }
+}
+
+constexpr int FanotifySource::markWd;
+
+/**
+ * @brief Marks the filesystem or mount containing root. Only events
+ *        below root are reported, with absolute paths.
+ *
+ */
+FanotifySource::FanotifySource(
+    const boost::filesystem::path& root, Mark mark, std::uint32_t eventMask)
+    : mFanotifyFd(-1)
+    , mMountFd(-1)
+    , mMark(mark)
+#ifdef FAN_RENAME
+    , mRenameEvents(mark == Mark::filesystem)
+#else
+    , mRenameEvents(false)
+#endif
+    , mKernelMask(0)
+    , mNextCookie(firstCookie)
+    , mBuffer(bufferSize)
+{
+    boost::system::error_code error;
+    mRoot = boost::filesystem::canonical(root, error);
+    if (error) {
+        throw std::invalid_argument(
+            "Can´t watch Path! Path does not exist. Path: " + root.string());
+    }
+
+    mFanotifyFd = fanotify_init(
+        FAN_CLASS_NOTIF | FAN_REPORT_DFID_NAME | FAN_CLOEXEC | FAN_NONBLOCK, O_RDONLY | O_LARGEFILE);
+    if (mFanotifyFd == -1) {
+        throw fanotifyError("Can't initialize fanotify !", mRoot);
+    }
+
+    // Handles are opened relative to the root, it lives on the marked filesystem
+    mMountFd = open(mRoot.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (mMountFd == -1) {
+        auto openError = fanotifyError("Can't open root of fanotify mark !", mRoot);
+        close(mFanotifyFd);
+        throw openError;
+    }
+
+    mKernelMask = kernelMask(eventMask);
+    int marked = mKernelMask ? this->mark(FAN_MARK_ADD, mKernelMask) : 0;
+    if (marked == -1 && errno == EINVAL && mRenameEvents) {
+        // FAN_RENAME needs Linux 5.17
+        mRenameEvents = false;
+        mKernelMask = kernelMask(eventMask);
+        marked = this->mark(FAN_MARK_ADD, mKernelMask);
+    }
+    if (marked == -1) {
+        auto markError = fanotifyError("Failed to mark filesystem!", mRoot);
+        close(mMountFd);
+        close(mFanotifyFd);
+        throw markError;
+    }
+}
+
+FanotifySource::~FanotifySource()
+{
+    close(mMountFd);
+    close(mFanotifyFd);
+}
+
+/**
+ * @brief Replaces the events of the mark, events the mark type does
+ *        not support are left out
+ */
+auto FanotifySource::setEventMask(std::uint32_t eventMask) -> void
+{
+    auto newMask = kernelMask(eventMask);
+    if (newMask == mKernelMask) {
+        return;
+    }
+
+    if ((newMask && mark(FAN_MARK_ADD, newMask) == -1)
+        || ((mKernelMask & ~newMask) && mark(FAN_MARK_REMOVE, mKernelMask & ~newMask) == -1)) {
+        throw fanotifyError("Failed to change fanotify mark!", mRoot);
+    }
+    mKernelMask = newMask;
+}
+
+/**
+ * @brief Reads one buffer of events and appends them to events. The
+ *        events refer to the read buffer and the directory cache,
+ *        they are valid until the next read.
+ *
+ * @return false if nothing could be read
+ *
+ */
+auto FanotifySource::read(std::vector<Event>& events) -> bool
+{
+    mRetiredDirectories.clear();
+
+    ssize_t length = ::read(mFanotifyFd, mBuffer.data(), mBuffer.size());
+    if (length <= 0) {
+        return false;
+    }
+
+    auto metadata = reinterpret_cast<fanotify_event_metadata*>(mBuffer.data());
+    for (; FAN_EVENT_OK(metadata, length); metadata = FAN_EVENT_NEXT(metadata, length)) {
+        auto mask = metadata->mask;
+        if (mask & FAN_Q_OVERFLOW) {
+            events.push_back(Event { IN_Q_OVERFLOW, 0, nullptr, boost::string_ref() });
+            continue;
+        }
+
+        Event event { 0, 0, nullptr, boost::string_ref() };
+        Event movedFrom = event;
+        Event movedTo = event;
+
+        const char* record = reinterpret_cast<const char*>(metadata) + metadata->metadata_len;
+        const char* end = reinterpret_cast<const char*>(metadata) + metadata->event_len;
+        while (record + sizeof(fanotify_event_info_fid) <= end) {
+            auto info = reinterpret_cast<const fanotify_event_info_fid*>(record);
+            if (info->hdr.len == 0) {
+                break;
+            }
+
+            auto handle = reinterpret_cast<const file_handle*>(info->handle);
+            const char* name = reinterpret_cast<const char*>(info->handle) + sizeof(file_handle)
+                + handle->handle_bytes;
+            const char* recordEnd = record + info->hdr.len;
+            boost::string_ref recordName;
+            if (info->hdr.info_type != FAN_EVENT_INFO_TYPE_DFID && name < recordEnd) {
+                recordName = boost::string_ref(name, strnlen(name, recordEnd - name));
+            }
+            if (recordName == ".") {
+                // Event of the directory itself
+                recordName.clear();
+            }
+
+            Event* target = nullptr;
+            switch (info->hdr.info_type) {
+            case FAN_EVENT_INFO_TYPE_DFID_NAME:
+            case FAN_EVENT_INFO_TYPE_DFID:
+                target = &event;
+                break;
+#ifdef FAN_RENAME
+            case FAN_EVENT_INFO_TYPE_OLD_DFID_NAME:
+                target = &movedFrom;
+                break;
+            case FAN_EVENT_INFO_TYPE_NEW_DFID_NAME:
+                target = &movedTo;
+                break;
+#endif
+            default:
+                break;
+            }
+            if (target) {
+                target->directory
+                    = resolve(reinterpret_cast<const char*>(&info->fsid), handle);
+                target->name = recordName;
+            }
+            record = recordEnd;
+        }
+
+        std::uint32_t directoryBit = (mask & FAN_ONDIR) ? IN_ISDIR : 0;
+#ifdef FAN_RENAME
+        if (mask & FAN_RENAME) {
+            std::uint32_t cookie = mNextCookie++;
+            if (mNextCookie == 0) {
+                mNextCookie = firstCookie;
+            }
+
+            // Moved in from or out to outside of the root, only one half is known
+            if (movedFrom.directory) {
+                movedFrom.mask = IN_MOVED_FROM | directoryBit;
+                movedFrom.cookie = cookie;
+                events.push_back(movedFrom);
+            }
+            if (movedTo.directory) {
+                movedTo.mask = IN_MOVED_TO | directoryBit;
+                movedTo.cookie = cookie;
+                events.push_back(movedTo);
+            }
+        }
+#endif
+
+        if (event.directory) {
+            for (std::uint32_t bit : splitOrder) {
+                if (mask & bit) {
+                    event.mask = bit | directoryBit;
+                    events.push_back(event);
+                }
+            }
+        }
+
+        // Cached paths below a renamed directory are stale now
+        if (directoryBit && (mask & (FAN_MOVED_FROM | FAN_MOVED_TO | FAN_MOVE_SELF))) {
+            retireDirectories();
+        }
+#ifdef FAN_RENAME
+        if (directoryBit && (mask & FAN_RENAME)) {
+            retireDirectories();
+        }
+#endif
+    }
+    return true;
+}
+
+auto FanotifySource::getFileDescriptor() const -> int
+{
+    return mFanotifyFd;
+}
+
+auto FanotifySource::root() const -> const boost::filesystem::path&
+{
+    return mRoot;
+}
+
+auto FanotifySource::cachedDirectories() const -> std::size_t
+{
+    return mDirectories.size();
+}
+
+auto FanotifySource::kernelMask(std::uint32_t eventMask) const -> std::uint64_t
+{
+    std::uint64_t mask = eventMask & supportedEvents(mMark);
+#ifdef FAN_RENAME
+    if (mRenameEvents && (mask & IN_MOVE)) {
+        mask = (mask & ~static_cast<std::uint64_t>(IN_MOVE)) | FAN_RENAME;
+    }
+#endif
+    return mask ? mask | FAN_ONDIR : 0;
+}
+
+auto FanotifySource::mark(unsigned int flags, std::uint64_t mask) -> int
+{
+    flags |= mMark == Mark::filesystem ? FAN_MARK_FILESYSTEM : FAN_MARK_MOUNT;
+    return fanotify_mark(mFanotifyFd, flags, mask, AT_FDCWD, mRoot.c_str());
+}
+
+/**
+ * @return path of the directory, nullptr if it is outside of the
+ *         root or already removed
+ */
+auto FanotifySource::resolve(const char* fsid, const file_handle* handle)
+    -> const boost::filesystem::path*
+{
+    std::string key(fsid, sizeof(__kernel_fsid_t));
+    key.append(reinterpret_cast<const char*>(handle), sizeof(file_handle) + handle->handle_bytes);
+    auto cached = mDirectories.find(key);
+    if (cached != mDirectories.end()) {
+        return cached->second.get();
+    }
+
+    int directoryFd = open_by_handle_at(mMountFd, const_cast<file_handle*>(handle), O_PATH);
+    if (directoryFd == -1) {
+        return nullptr;
+    }
+
+    char target[PATH_MAX];
+    std::string link = "/proc/self/fd/" + std::to_string(directoryFd);
+    ssize_t length = readlink(link.c_str(), target, sizeof(target));
+    close(directoryFd);
+    if (length <= 0 || static_cast<std::size_t>(length) == sizeof(target)) {
+        return nullptr;
+    }
+
+    boost::string_ref path(target, static_cast<std::size_t>(length));
+    if (path.ends_with(" (deleted)")) {
+        return nullptr;
+    }
+
+    const std::string& root = mRoot.native();
+    bool inside = root == "/"
+        || (path.starts_with(root)
+            && (path.size() == root.size() || path[root.size()] == '/'));
+
+    if (mDirectories.size() >= maxCachedDirectories) {
+        retireDirectories();
+    }
+    auto& directory = mDirectories[key];
+    if (inside) {
+        directory.reset(new boost::filesystem::path(path.begin(), path.end()));
+    }
+    return directory.get();
+}
+
+/**
+ * @brief Empties the cache, paths handed out by the current read
+ *        stay valid until the next one
+ */
+auto FanotifySource::retireDirectories() -> void
+{
+    for (auto& directory : mDirectories) {
+        if (directory.second) {
+            mRetiredDirectories.push_back(std::move(directory.second));
+        }
+    }
+    mDirectories.clear();
+}
+}
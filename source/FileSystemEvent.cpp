@@ -1,16 +1,80 @@
 #include <inotify-cpp/FileSystemEvent.h>
 
 #include <sys/inotify.h>
+#include <sys/stat.h>
+
+#include <utility>
 
 namespace inotify {
-FileSystemEvent::FileSystemEvent(const int wd, uint32_t mask, const boost::filesystem::path path)
+FileSystemEvent::FileSystemEvent(
+    const int wd, uint32_t mask, boost::filesystem::path path, uint32_t cookie)
     : wd(wd)
     , mask(mask)
-    , path(path)
+    , cookie(cookie)
+    , path(std::move(path))
+    , group(0)
+    , mAttributesLoaded(false)
+{
+}
+
+namespace {
+boost::filesystem::file_type toFileType(mode_t mode)
 {
+    if (S_ISREG(mode))
+        return boost::filesystem::regular_file;
+    if (S_ISDIR(mode))
+        return boost::filesystem::directory_file;
+    if (S_ISLNK(mode))
+        return boost::filesystem::symlink_file;
+    if (S_ISBLK(mode))
+        return boost::filesystem::block_file;
+    if (S_ISCHR(mode))
+        return boost::filesystem::character_file;
+    if (S_ISFIFO(mode))
+        return boost::filesystem::fifo_file;
+    if (S_ISSOCK(mode))
+        return boost::filesystem::socket_file;
+    return boost::filesystem::type_unknown;
+}
 }
 
-FileSystemEvent::~FileSystemEvent()
+/**
+ * @brief Stats the path of the event on first access and caches
+ *        the result. Events never pay for the stat unless this
+ *        is called.
+ *
+ * @return attributes of the file or none if it does not exist
+ *         anymore
+ */
+auto FileSystemEvent::attributes() const -> const boost::optional<FileAttributes>&
 {
+    if (!mAttributesLoaded) {
+        mAttributesLoaded = true;
+
+        struct stat status;
+        if (stat(path.c_str(), &status) == 0) {
+            mAttributes = FileAttributes { toFileType(status.st_mode),
+                                           static_cast<std::uintmax_t>(status.st_size),
+                                           status.st_mtime };
+        }
+    }
+
+    return mAttributes;
+}
+
+/**
+ * @brief Turns a handled event into a new one with the given values.
+ *        The paths keep their storage, the caller assigns the new
+ *        path, the old path is cleared.
+ */
+auto FileSystemEvent::reuse(int wd, uint32_t mask, uint32_t cookie) -> void
+{
+    this->wd = wd;
+    this->mask = mask;
+    this->cookie = cookie;
+    oldPath.clear();
+    group = 0;
+    mAttributesLoaded = false;
+    mAttributes = boost::none;
+}
 }
-}
\ No newline at end of file
@@ -0,0 +1,321 @@
+#include <inotify-cpp/IgnoreMatcher.h>
+
+#include <queue>
+#include <stdexcept>
+
+namespace inotify {
+
+IgnoreMatcher::IgnoreMatcher()
+    : mOnceRules(0)
+    , mDirty(true)
+{
+}
+
+void IgnoreMatcher::ignore(const std::string& rule)
+{
+    mRules.push_back({ rule, Kind::permanent });
+    mDirty = true;
+}
+
+void IgnoreMatcher::ignoreOnce(const std::string& rule)
+{
+    mRules.push_back({ rule, Kind::once });
+    ++mOnceRules;
+    mDirty = true;
+}
+
+void IgnoreMatcher::ignorePattern(const std::string& pattern)
+{
+    mRules.push_back({ pattern, Kind::pattern });
+    mDirty = true;
+}
+
+bool IgnoreMatcher::empty() const
+{
+    return mRules.empty();
+}
+
+bool IgnoreMatcher::hasOnceRules() const
+{
+    return mOnceRules != 0;
+}
+
+/**
+ * @brief Checks a complete path against all rules
+ */
+bool IgnoreMatcher::matches(boost::string_ref path)
+{
+    if (mRules.empty()) {
+        return false;
+    }
+    compile();
+
+    MatchState state { 0, false, -1 };
+    collect(state, 0);
+    feed(state, path);
+
+    auto separator = path.rfind('/');
+    auto fileName = separator == boost::string_ref::npos ? path : path.substr(separator + 1);
+    return finish(state, fileName);
+}
+
+/**
+ * @brief Checks the path directory / name against all rules without
+ *        building it. An empty name checks the directory itself.
+ */
+bool IgnoreMatcher::matches(const boost::filesystem::path& directory, boost::string_ref name)
+{
+    if (mRules.empty()) {
+        return false;
+    }
+    compile();
+
+    const std::string& native = directory.native();
+    MatchState state { 0, false, -1 };
+    collect(state, 0);
+    feed(state, native);
+
+    if (name.empty()) {
+        boost::string_ref directoryName(native);
+        while (directoryName.size() > 1 && directoryName.ends_with('/')) {
+            directoryName.remove_suffix(1);
+        }
+        auto separator = directoryName.rfind('/');
+        if (separator != boost::string_ref::npos) {
+            directoryName = directoryName.substr(separator + 1);
+        }
+        return finish(state, directoryName);
+    }
+
+    if (!native.empty() && native.back() != '/') {
+        feed(state, "/");
+    }
+    feed(state, name);
+    return finish(state, name);
+}
+
+/**
+ * @brief Checks a complete path against all rules except the once
+ *        rules, which are neither matched nor removed.
+ *
+ * @throws std::logic_error if rules changed since the last compile
+ */
+bool IgnoreMatcher::matchesPermanent(boost::string_ref path) const
+{
+    if (mRules.empty()) {
+        return false;
+    }
+    if (mDirty) {
+        throw std::logic_error("Ignore rules changed since they were compiled.");
+    }
+
+    MatchState state { 0, false, -1 };
+    collect(state, 0);
+    feed(state, path);
+    if (state.permanent) {
+        return true;
+    }
+
+    auto separator = path.rfind('/');
+    auto fileName = separator == boost::string_ref::npos ? path : path.substr(separator + 1);
+    for (const auto& rule : mRules) {
+        if (rule.kind == Kind::pattern && globMatch(rule.text, fileName)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+bool IgnoreMatcher::finish(MatchState& state, boost::string_ref fileName)
+{
+    if (state.firstOnce >= 0) {
+        mRules.erase(mRules.begin() + state.firstOnce);
+        --mOnceRules;
+        mDirty = true;
+        return true;
+    }
+
+    if (state.permanent) {
+        return true;
+    }
+
+    for (const auto& rule : mRules) {
+        if (rule.kind == Kind::pattern && globMatch(rule.text, fileName)) {
+            return true;
+        }
+    }
+
+    return false;
+}
+
+void IgnoreMatcher::feed(MatchState& state, boost::string_ref text) const
+{
+    for (char c : text) {
+        state.node = transition(state.node, static_cast<unsigned char>(c));
+        collect(state, state.node);
+
+        if (state.permanent && !mOnceRules) {
+            return;
+        }
+    }
+}
+
+void IgnoreMatcher::collect(MatchState& state, int node) const
+{
+    for (; node >= 0; node = mNodes[node].outputLink) {
+        for (int rule : mNodes[node].rules) {
+            if (mRules[rule].kind == Kind::once) {
+                if (state.firstOnce < 0 || rule < state.firstOnce) {
+                    state.firstOnce = rule;
+                }
+            } else {
+                state.permanent = true;
+            }
+        }
+    }
+}
+
+int IgnoreMatcher::findChild(int node, unsigned char c) const
+{
+    for (const auto& edge : mNodes[node].next) {
+        if (edge.first == c) {
+            return edge.second;
+        }
+    }
+    return -1;
+}
+
+int IgnoreMatcher::transition(int node, unsigned char c) const
+{
+    while (true) {
+        int child = findChild(node, c);
+        if (child >= 0) {
+            return child;
+        }
+        if (node == 0) {
+            return 0;
+        }
+        node = mNodes[node].fail;
+    }
+}
+
+/**
+ * @brief Builds the trie of all substring rules and links it to
+ *        an Aho-Corasick automaton
+ */
+void IgnoreMatcher::compile()
+{
+    if (!mDirty) {
+        return;
+    }
+    mDirty = false;
+
+    mNodes.assign(1, Node { {}, 0, -1, {} });
+    for (std::size_t i = 0; i < mRules.size(); ++i) {
+        if (mRules[i].kind == Kind::pattern) {
+            continue;
+        }
+
+        int node = 0;
+        for (char c : mRules[i].text) {
+            int child = findChild(node, static_cast<unsigned char>(c));
+            if (child < 0) {
+                child = static_cast<int>(mNodes.size());
+                mNodes[node].next.emplace_back(static_cast<unsigned char>(c), child);
+                mNodes.push_back(Node { {}, 0, -1, {} });
+            }
+            node = child;
+        }
+        mNodes[node].rules.push_back(static_cast<int>(i));
+    }
+
+    // Breadth first: failure links of a node only depend on shallower nodes
+    std::queue<int> nodes;
+    for (const auto& edge : mNodes[0].next) {
+        nodes.push(edge.second);
+    }
+
+    while (!nodes.empty()) {
+        int node = nodes.front();
+        nodes.pop();
+
+        int fail = mNodes[node].fail;
+        mNodes[node].outputLink = mNodes[fail].rules.empty() ? mNodes[fail].outputLink : fail;
+
+        for (const auto& edge : mNodes[node].next) {
+            mNodes[edge.second].fail = transition(fail, edge.first);
+            nodes.push(edge.second);
+        }
+    }
+}
+
+/**
+ * @brief Matches text against a glob pattern supporting *, ? and
+ *        character classes like [abc], [a-z] or [!a-z]
+ */
+bool IgnoreMatcher::globMatch(boost::string_ref pattern, boost::string_ref text)
+{
+    std::size_t p = 0;
+    std::size_t t = 0;
+    std::size_t starPattern = boost::string_ref::npos;
+    std::size_t starText = 0;
+
+    while (t < text.size()) {
+        bool matched = false;
+        std::size_t nextPattern = p + 1;
+
+        if (p < pattern.size()) {
+            char c = pattern[p];
+            if (c == '*') {
+                starPattern = p++;
+                starText = t;
+                continue;
+            } else if (c == '?') {
+                matched = true;
+            } else if (c == '[') {
+                std::size_t i = p + 1;
+                bool negate = i < pattern.size() && (pattern[i] == '!' || pattern[i] == '^');
+                if (negate) {
+                    ++i;
+                }
+                bool inClass = false;
+                std::size_t first = i;
+                while (i < pattern.size() && (pattern[i] != ']' || i == first)) {
+                    if (i + 2 < pattern.size() && pattern[i + 1] == '-' && pattern[i + 2] != ']') {
+                        inClass |= pattern[i] <= text[t] && text[t] <= pattern[i + 2];
+                        i += 3;
+                    } else {
+                        inClass |= pattern[i] == text[t];
+                        ++i;
+                    }
+                }
+                if (i < pattern.size()) {
+                    matched = inClass != negate;
+                    nextPattern = i + 1;
+                } else {
+                    // Unterminated class, match the bracket literally
+                    matched = text[t] == '[';
+                }
+            } else {
+                matched = c == text[t];
+            }
+        }
+
+        if (matched) {
+            p = nextPattern;
+            ++t;
+        } else if (starPattern != boost::string_ref::npos) {
+            p = starPattern + 1;
+            t = ++starText;
+        } else {
+            return false;
+        }
+    }
+
+    while (p < pattern.size() && pattern[p] == '*') {
+        ++p;
+    }
+    return p == pattern.size();
+}
+}
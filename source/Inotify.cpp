@@ -1,75 +1,405 @@
 #include <inotify-cpp/Inotify.h>
 
+#include <dirent.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+
+#include <algorithm>
+#include <climits>
+#include <fstream>
 #include <string>
 #include <vector>
 
 namespace inotify {
 
+namespace {
+    // Overflows grow the read buffer up to this many events
+    const std::size_t maxGrownEvents = 65536;
+
+    // Handled events kept for their path storage
+    const std::size_t maxSpareEvents = 4096;
+
+    std::uint64_t modificationTime(const struct stat& status)
+    {
+        return static_cast<std::uint64_t>(status.st_mtim.tv_sec) * 1000000000u
+            + static_cast<std::uint64_t>(status.st_mtim.tv_nsec);
+    }
+
+    /**
+     * @brief Calls onEntry(name, isDirectory) for every entry of the
+     *        directory, symlinks are no directories
+     */
+    template <typename OnEntry> bool listDirectory(const fs::path& path, OnEntry onEntry)
+    {
+        DIR* directory = opendir(path.c_str());
+        if (!directory) {
+            return false;
+        }
+
+        while (dirent* entry = readdir(directory)) {
+            if (!strcmp(entry->d_name, ".") || !strcmp(entry->d_name, "..")) {
+                continue;
+            }
+
+            bool isDirectory = entry->d_type == DT_DIR;
+            struct stat status;
+            if (entry->d_type == DT_UNKNOWN
+                && fstatat(dirfd(directory), entry->d_name, &status, AT_SYMLINK_NOFOLLOW) == 0) {
+                isDirectory = S_ISDIR(status.st_mode);
+            }
+            onEntry(entry->d_name, isDirectory);
+        }
+
+        closedir(directory);
+        return true;
+    }
+
+    // Swaps the buffers back when it goes out of scope
+    struct SwappedBuffers {
+        SwappedBuffers(std::vector<char>& first, std::vector<char>& second)
+            : first(first)
+            , second(second)
+        {
+            first.swap(second);
+        }
+        ~SwappedBuffers()
+        {
+            first.swap(second);
+        }
+
+        std::vector<char>& first;
+        std::vector<char>& second;
+    };
+
+    /**
+     * @brief Whether path is prefix or below it, prefixes are compared
+     *        as they were passed in
+     */
+    bool isPathBelow(const std::string& path, const std::string& prefix)
+    {
+        return path.compare(0, prefix.size(), prefix) == 0
+            && (path.size() == prefix.size() || path[prefix.size()] == '/'
+                || (!prefix.empty() && prefix.back() == '/'));
+    }
+}
+
 Inotify::Inotify()
     : mError(0)
     , mEventTimeout(0)
-    , mLastEventTime(std::chrono::steady_clock::now())
+    , mLastEventTime()
     , mEventMask(IN_ALL_EVENTS)
-    , mThreadSleep(250)
-    , mIgnoredDirectories(std::vector<std::string>())
-    , mInotifyFd(0)
-    , mOnEventTimeout([](FileSystemEvent) {})
+    , mEventMasksChanged(false)
+    , mGroups(1)
+    , mCrawlThreads(1)
+    , mCrawlStatistics()
+    , mAutoRecursive(false)
+    , mOverflowRecovery(false)
+    , mOnOverflow()
+    , mLastOverflowTime(std::chrono::steady_clock::now())
+    , mLastOverflowEvents(0)
+    , mGrowEventBuffer(false)
+    , mInotifyFds()
+    , mNextShard(0)
+    , mReadLengths()
+    , mReadyShards()
+    , mEpollEvents()
+    , mEpollFd(0)
+    , mStopFd(0)
+    , mMaxEvents(0)
+    , mEventBufferSize(0)
+    , mContentChecksReady(false)
+    , mReplaySpeed(ReplaySpeed::original)
+    , mReplayPosition(0)
+    , mNextReplayedEvents(0)
+    , mReplayReady(false)
+    , mOnEventTimeout([](const FileSystemEvent&) {})
 {
 
     // Initialize inotify
     init();
+    setMaxEvents(4096);
 }
 
 Inotify::~Inotify()
 {
-    if (!close(mInotifyFd)) {
-        mError = errno;
+    close(mEpollFd);
+    close(mStopFd);
+    for (int inotifyFd : mInotifyFds) {
+        close(inotifyFd);
     }
 }
 
 void Inotify::init()
 {
     stopped = false;
-    mInotifyFd = inotify_init1(IN_NONBLOCK);
-    if (mInotifyFd == -1) {
+
+    // The stop eventfd wakes up a blocking wait on the inotify fd
+    mStopFd = eventfd(0, EFD_NONBLOCK);
+    mEpollFd = epoll_create1(0);
+    if (mStopFd == -1 || mEpollFd == -1) {
+        mError = errno;
+        std::stringstream errorStream;
+        errorStream << "Can't initialize epoll ! " << strerror(mError) << ".";
+        throw std::runtime_error(errorStream.str());
+    }
+
+    epoll_event stopEvent {};
+    stopEvent.events = EPOLLIN;
+    stopEvent.data.fd = mStopFd;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, mStopFd, &stopEvent) == -1) {
+        mError = errno;
+        std::stringstream errorStream;
+        errorStream << "Can't initialize epoll ! " << strerror(mError) << ".";
+        throw std::runtime_error(errorStream.str());
+    }
+
+    addInotifyInstance();
+}
+
+/**
+ * @brief Creates one more inotify instance and lets the epoll
+ *        instance wait on it
+ *
+ */
+void Inotify::addInotifyInstance()
+{
+    int inotifyFd = inotify_init1(IN_NONBLOCK);
+    if (inotifyFd == -1) {
         mError = errno;
         std::stringstream errorStream;
         errorStream << "Can't initialize inotify ! " << strerror(mError) << ".";
         throw std::runtime_error(errorStream.str());
     }
+
+    epoll_event inotifyEvent {};
+    inotifyEvent.events = EPOLLIN;
+    inotifyEvent.data.fd = inotifyFd;
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, inotifyFd, &inotifyEvent) == -1) {
+        mError = errno;
+        close(inotifyFd);
+        std::stringstream errorStream;
+        errorStream << "Can't initialize epoll ! " << strerror(mError) << ".";
+        throw std::runtime_error(errorStream.str());
+    }
+
+    mInotifyFds.push_back(inotifyFd);
+    mReadLengths.push_back(0);
+}
+
+/**
+ * @brief Watches the whole filesystem containing path through a
+ *        single fanotify mark. Nothing is crawled and no inotify
+ *        watch is used, events below path are reported with
+ *        absolute paths and the watch descriptor
+ *        FanotifySource::markWd. Needs CAP_SYS_ADMIN and Linux 5.9.
+ *
+ * @param path directory below which events are reported, / reports
+ *        every event of the filesystem
+ *
+ */
+void Inotify::watchFilesystem(fs::path path)
+{
+    addFanotifySource(path, FanotifySource::Mark::filesystem);
+}
+
+/**
+ * @brief Like watchFilesystem, but only for the mount containing
+ *        path. The kernel only reports access, modify, open and close
+ *        events for mounts.
+ *
+ */
+void Inotify::watchMount(fs::path path)
+{
+    addFanotifySource(path, FanotifySource::Mark::mount);
+}
+
+void Inotify::addFanotifySource(const fs::path& path, FanotifySource::Mark mark)
+{
+    std::unique_ptr<FanotifySource> source(new FanotifySource(path, mark, fanotifyEventMask()));
+
+    epoll_event fanotifyEvent {};
+    fanotifyEvent.events = EPOLLIN;
+    fanotifyEvent.data.fd = source->getFileDescriptor();
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, source->getFileDescriptor(), &fanotifyEvent) == -1) {
+        mError = errno;
+        std::stringstream errorStream;
+        errorStream << "Can't initialize epoll ! " << strerror(mError) << ".";
+        throw std::runtime_error(errorStream.str());
+    }
+
+    mFanotifySources.push_back(std::move(source));
+}
+
+/**
+ * @brief A mark covers paths with different masks, it reports the
+ *        union of them and the events are filtered per path
+ *
+ */
+uint32_t Inotify::fanotifyEventMask()
+{
+    uint32_t eventMask = mEventMask;
+    for (const auto& pathEventMask : mPathEventMasks) {
+        eventMask |= pathEventMask.second;
+    }
+    if (mRenameMatcher.enabled() && (eventMask & IN_MOVE)) {
+        eventMask |= IN_MOVE;
+    }
+    return eventMask;
+}
+
+/**
+ * @brief Spreads the watches over several inotify instances. Every
+ *        instance has its own kernel queue, thus each queue stays
+ *        below max_queued_events under higher event rates. All
+ *        instances are read through the same epoll instance and
+ *        share one registry, watch descriptors stay unique.
+ *
+ * @param instances has to be set before anything is watched
+ *
+ */
+void Inotify::setInotifyInstances(std::size_t instances)
+{
+    if (instances == 0) {
+        throw std::invalid_argument("At least one inotify instance is required");
+    }
+    if (mDirectories.size() != 0) {
+        throw std::runtime_error("Can't change the inotify instances of active watches");
+    }
+
+    while (mInotifyFds.size() < instances) {
+        addInotifyInstance();
+    }
+    while (mInotifyFds.size() > instances) {
+        close(mInotifyFds.back());
+        mInotifyFds.pop_back();
+        mReadLengths.pop_back();
+    }
+    setMaxEvents(mMaxEvents);
+}
+
+std::size_t Inotify::getInotifyInstances()
+{
+    return mInotifyFds.size();
+}
+
+/**
+ * @brief Watch descriptors of the instances are interleaved into
+ *        one range: wd = kernel wd * instances + instance
+ *
+ */
+int Inotify::shardOf(int wd) const
+{
+    return wd % static_cast<int>(mInotifyFds.size());
+}
+
+int Inotify::kernelWd(int wd) const
+{
+    return wd / static_cast<int>(mInotifyFds.size());
+}
+
+int Inotify::removeKernelWatch(int wd)
+{
+    return inotify_rm_watch(mInotifyFds[shardOf(wd)], kernelWd(wd));
+}
+
+/**
+ * @brief Translates the kernel watch descriptors of a read buffer
+ *        in place into the watch descriptors of the registry
+ *
+ */
+void Inotify::translateWatchDescriptors(char* buffer, std::size_t length, std::size_t shard)
+{
+    int instances = static_cast<int>(mInotifyFds.size());
+    if (instances == 1) {
+        return;
+    }
+
+    std::size_t i = 0;
+    while (i < length) {
+        inotify_event* event = reinterpret_cast<inotify_event*>(&buffer[i]);
+        i += EVENT_SIZE + event->len;
+        if (event->wd != -1) {
+            event->wd = event->wd * instances + static_cast<int>(shard);
+        }
+    }
 }
 
 /**
  * @brief Adds the given path and all files and subdirectories
  *        to the set of watched files/directories.
- *        Symlinks will be followed!
+ *        Symlinks will be followed! Ignored directories
+ *        are not descended.
  *
  * @param path that will be watched recursively
  *
  */
 void Inotify::watchDirectoryRecursively(fs::path path)
 {
-    if (fs::exists(path)) {
-        if (fs::is_directory(path)) {
-            fs::recursive_directory_iterator it(path, fs::symlink_option::recurse);
-            fs::recursive_directory_iterator end;
+    boost::system::error_code error;
+    watchDirectoryRecursively(path, error);
+    throwWatchError(path, error);
+}
 
-            while (it != end) {
-                fs::path currentPath = *it;
+/**
+ * @brief Like watchDirectoryRecursively, but errors are reported
+ *        through error instead of exceptions. Only errors of path
+ *        itself or running out of watches are reported, entries
+ *        removed or unreadable while the tree is crawled are
+ *        skipped and counted in CrawlStatistics::failedWatches.
+ *
+ */
+void Inotify::watchDirectoryRecursively(fs::path path, boost::system::error_code& error)
+{
+    // Crawling a file or missing path fails right away, no stat required
+    compileIgnoreMatchers();
+    std::size_t failedWatches = 0;
+    error.clear();
+    auto watchEntry = [&](const fs::path& currentPath, EntryType type, bool matchOnce) {
+        uint32_t watchMask = type == EntryType::directory ? IN_ONLYDIR : 0;
+        boost::system::error_code watchError;
+        if (matchOnce) {
+            watchError = tryAddWatch(currentPath, DirectoryRegistry::recursive, watchMask);
+        } else if (!isIgnoredPermanently(currentPath.native())
+            && addWatchDescriptor(currentPath, DirectoryRegistry::recursive, watchMask) == -1) {
+            watchError = boost::system::error_code(mError, boost::system::system_category());
+        }
 
-                if (fs::is_directory(currentPath)) {
-                    watchFile(currentPath);
-                }
-                if (fs::is_symlink(currentPath)) {
-                    watchFile(currentPath);
-                }
-                ++it;
+        if (watchError) {
+            ++failedWatches;
+            if (watchError.value() == ENOSPC && !error) {
+                error = watchError;
             }
         }
-        watchFile(path);
-    } else {
-        throw std::invalid_argument(
-            "Can´t watch Path! Path does not exist. Path: " + path.string());
+    };
+
+    // Matching once rules removes them while the crawl threads match
+    // the compiled rules, they are matched after the crawl instead
+    bool matchOnce = mIgnoreMatcher.hasOnceRules();
+    std::vector<std::pair<fs::path, EntryType>> entries;
+    DirectoryCrawler crawler(mCrawlThreads);
+    mCrawlStatistics = crawler.crawl(
+        path,
+        [this](boost::string_ref currentPath) { return isIgnoredPermanently(currentPath); },
+        [&](const fs::path& currentPath, EntryType type) {
+            if (matchOnce) {
+                entries.emplace_back(currentPath, type);
+                return;
+            }
+            watchEntry(currentPath, type, false);
+        });
+    for (const auto& entry : entries) {
+        watchEntry(entry.first, entry.second, true);
+    }
+    mCrawlStatistics.failedWatches = failedWatches;
+    if (error) {
+        return;
+    }
+
+    // Watched last, the crawl itself causes no events. The kernel
+    // checks the type while adding the watch.
+    error = tryAddWatch(path, DirectoryRegistry::recursive, IN_ONLYDIR);
+    if (error.value() == ENOTDIR) {
+        error = tryAddWatch(path, 0, 0);
     }
 }
 
@@ -85,208 +415,1992 @@ void Inotify::watchDirectoryRecursively(fs::path path)
  */
 void Inotify::watchFile(fs::path filePath)
 {
-    if (fs::exists(filePath)) {
-        mError = 0;
-        int wd = 0;
-        if (!isIgnored(filePath.string())) {
-            wd = inotify_add_watch(mInotifyFd, filePath.string().c_str(), mEventMask);
-        }
+    addWatch(filePath);
+}
 
-        if (wd == -1) {
-            mError = errno;
-            std::stringstream errorStream;
-            if (mError == 28) {
-                errorStream << "Failed to watch! " << strerror(mError)
-                            << ". Please increase number of watches in "
-                               "\"/proc/sys/fs/inotify/max_user_watches\".";
-                throw std::runtime_error(errorStream.str());
-            }
+/**
+ * @brief Like watchFile, but errors are reported through error
+ *        instead of exceptions
+ *
+ */
+void Inotify::watchFile(fs::path filePath, boost::system::error_code& error)
+{
+    error = tryAddWatch(filePath, 0, 0);
+}
 
-            errorStream << "Failed to watch! " << strerror(mError)
-                        << ". Path: " << filePath.string();
-            throw std::runtime_error(errorStream.str());
-        }
-        mDirectorieMap.left.insert({wd, filePath});
-    } else {
+/**
+ * @brief Watches all paths with a single inotify_add_watch call
+ *        each. Nothing is stat'ed before, a path that does not
+ *        exist or has the wrong type only fails on its own.
+ *
+ * @param paths that will be watched
+ * @param watchMask IN_ONLYDIR, IN_DONT_FOLLOW and IN_MASK_ADD are
+ *        passed on to inotify_add_watch. Events added to a watched
+ *        path by IN_MASK_ADD are kept after later mask changes.
+ *
+ * @return one error code per path, ignored paths are no errors
+ *
+ */
+std::vector<boost::system::error_code>
+Inotify::watchFiles(const std::vector<fs::path>& paths, uint32_t watchMask)
+{
+    if (watchMask & ~static_cast<uint32_t>(IN_ONLYDIR | IN_DONT_FOLLOW | IN_MASK_ADD)) {
         throw std::invalid_argument(
-            "Can´t watch Path! Path does not exist. Path: " + filePath.string());
+            "Only IN_ONLYDIR, IN_DONT_FOLLOW and IN_MASK_ADD can be passed as watch mask");
+    }
+
+    std::vector<boost::system::error_code> errors;
+    errors.reserve(paths.size());
+    for (const auto& path : paths) {
+        errors.push_back(tryAddWatch(path, 0, watchMask));
     }
+    return errors;
 }
 
-void Inotify::ignoreFileOnce(fs::path file)
+void Inotify::addWatch(const fs::path& filePath, std::uint32_t flags)
 {
-    mOnceIgnoredDirectories.push_back(file.string());
+    throwWatchError(filePath, tryAddWatch(filePath, flags, 0));
 }
 
-void Inotify::ignoreFile(fs::path file)
+/**
+ * @brief Watches the path unless it is ignored
+ *
+ * @param watchMask inotify_add_watch flags added to the event mask
+ *
+ * @return the error of inotify_add_watch
+ *
+ */
+boost::system::error_code
+Inotify::tryAddWatch(const fs::path& filePath, std::uint32_t flags, std::uint32_t watchMask)
 {
-    mIgnoredDirectories.push_back(file.string());
-}
+    mError = 0;
+    if (isIgnored(filePath)) {
+        return boost::system::error_code();
+    }
 
+    if (addWatchDescriptor(filePath, flags, watchMask) == -1) {
+        return boost::system::error_code(mError, boost::system::system_category());
+    }
+    return boost::system::error_code();
+}
 
-void Inotify::unwatchFile(fs::path file)
+void Inotify::throwWatchError(const fs::path& filePath, const boost::system::error_code& error)
 {
-    removeWatch(mDirectorieMap.right.at(file));
+    if (!error) {
+        return;
+    }
+
+    if (error.value() == ENOENT) {
+        throw std::invalid_argument(
+            "Can´t watch Path! Path does not exist. Path: " + filePath.string());
+    }
+
+    std::stringstream errorStream;
+    if (error.value() == ENOSPC) {
+        errorStream << "Failed to watch! " << error.message()
+                    << ". Please increase number of watches in "
+                       "\"/proc/sys/fs/inotify/max_user_watches\".";
+        throw std::runtime_error(errorStream.str());
+    }
+
+    errorStream << "Failed to watch! " << error.message() << ". Path: " << filePath.string();
+    throw std::runtime_error(errorStream.str());
 }
 
 /**
- * @brief Removes watch from set of watches. This
- *        is not done recursively!
+ * @brief Adds the watch and registers it without checking the
+ *        ignore rules.
  *
- * @param wd watchdescriptor
+ * @return watch descriptor or -1 on failure, the error is in mError
  *
  */
-void Inotify::removeWatch(int wd)
+int Inotify::addWatchDescriptor(
+    const fs::path& filePath, std::uint32_t flags, std::uint32_t watchMask)
 {
-    int result = inotify_rm_watch(mInotifyFd, wd);
-    if (result == -1) {
+    // Replayed watch descriptors belong to no instance
+    if (mEventLogReader) {
+        mError = EBUSY;
+        return -1;
+    }
+
+    // A path watched again has to stay on its instance
+    int watchedWd = mDirectories.find(filePath);
+    std::size_t shard
+        = watchedWd == -1 ? mNextShard++ % mInotifyFds.size() : shardOf(watchedWd);
+
+    uint32_t eventMask = getEventMask(filePath) | (watchMask & IN_ALL_EVENTS);
+    uint32_t kernelMask = eventMask | internalEventMask(flags);
+    int wd = inotify_add_watch(mInotifyFds[shard], filePath.c_str(), kernelMask | watchMask);
+    if (wd == -1) {
         mError = errno;
-        std::stringstream errorStream;
-        errorStream << "Failed to remove watch! " << strerror(mError) << ".";
-        throw std::runtime_error(errorStream.str());
+        return -1;
     }
-}
+    wd = wd * static_cast<int>(mInotifyFds.size()) + static_cast<int>(shard);
 
-fs::path Inotify::wdToPath(int wd)
-{
-    return mDirectorieMap.left.at(wd);
+    if (static_cast<std::size_t>(wd) >= mWatchMasks.size()) {
+        mWatchMasks.resize(wd + 1, 0);
+        mKernelMasks.resize(wd + 1, 0);
+        mAddedMasks.resize(wd + 1, 0);
+        mWatchGroups.resize(wd + 1, 0);
+    }
+    mWatchGroups[wd] = getWatchGroup(filePath);
+    if (!(watchMask & IN_MASK_ADD) || wd != watchedWd) {
+        mWatchMasks[wd] = 0;
+        mKernelMasks[wd] = 0;
+        mAddedMasks[wd] = 0;
+    }
+    // The kernel keeps the events of the earlier mask, they stay when
+    // the masks are applied again
+    mAddedMasks[wd] |= mWatchMasks[wd] & IN_ALL_EVENTS;
+    mWatchMasks[wd] |= eventMask;
+    mKernelMasks[wd] |= kernelMask;
+
+    mDirectories.insert(wd, filePath, flags);
+    mCounters.watches.store(getWatchCount(), std::memory_order_relaxed);
+    if (mEventLogWriter) {
+        mEventLogWriter->watch(wd, flags, filePath);
+    }
+    if (mOverflowRecovery) {
+        mSnapshots.take(wd, filePath);
+    }
+    return wd;
 }
 
-void Inotify::setEventMask(uint32_t eventMask)
+/**
+ * @brief Automatically watches directories which are created in
+ *        or moved into a recursively watched directory. The new
+ *        subtree is crawled and create events are emitted for
+ *        everything that was created before its watch was added.
+ *
+ * @param autoRecursive enables watching new directories
+ *
+ */
+void Inotify::setAutoRecursive(bool autoRecursive)
 {
-    mEventMask = eventMask;
+    mAutoRecursive = autoRecursive;
 }
 
-uint32_t Inotify::getEventMask()
+void Inotify::watchNewDirectory(int wd, uint32_t mask, boost::string_ref name)
 {
-    return mEventMask;
+    if (!(mask & IN_ISDIR) || !(mask & (IN_CREATE | IN_MOVED_TO))
+        || !(mDirectories.flags(wd) & DirectoryRegistry::recursive)) {
+        return;
+    }
+
+    auto directory = wdToPath(wd) / std::string(name.begin(), name.end());
+    compileIgnoreMatchers();
+    if (isIgnoredPermanently(directory.native())
+        || addWatchDescriptor(directory, DirectoryRegistry::recursive) == -1) {
+        // Ignored or already removed again
+        return;
+    }
+
+    DirectoryCrawler crawler;
+    crawler.setReportFiles(true).crawl(
+        directory,
+        [this](boost::string_ref path) { return isIgnoredPermanently(path); },
+        [this](const fs::path& path, EntryType type) {
+            if (type != EntryType::file) {
+                addWatchDescriptor(path, DirectoryRegistry::recursive);
+            }
+
+            int parentWd = mDirectories.find(path.parent_path());
+            if (parentWd != -1) {
+                uint32_t mask = IN_CREATE | (type == EntryType::directory ? IN_ISDIR : 0);
+                appendSyntheticEvent(parentWd, mask, 0, path.filename().native());
+            }
+        });
 }
 
-void Inotify::setEventTimeout(
-    std::chrono::milliseconds eventTimeout, std::function<void(FileSystemEvent)> onEventTimeout)
+/**
+ * @brief Encodes an event that was not read from the kernel in the
+ *        same format as inotify, thus it takes the same path
+ *        through parsing and filtering as all other events.
+ */
+void Inotify::appendSyntheticEvent(int wd, uint32_t mask, uint32_t cookie, boost::string_ref name)
 {
-    mEventTimeout = eventTimeout;
-    mOnEventTimeout = onEventTimeout;
+    // Pad the name like the kernel does to keep the following event aligned
+    std::size_t nameLength = name.empty() ? 0 : name.size() + 1;
+    nameLength = (nameLength + alignof(inotify_event) - 1) / alignof(inotify_event)
+        * alignof(inotify_event);
+
+    std::size_t offset = mSyntheticEvents.size();
+    mSyntheticEvents.resize(offset + EVENT_SIZE + nameLength, '\0');
+
+    inotify_event event {};
+    event.wd = wd;
+    event.mask = mask;
+    event.cookie = cookie;
+    event.len = static_cast<uint32_t>(nameLength);
+    memcpy(&mSyntheticEvents[offset], &event, EVENT_SIZE);
+    memcpy(&mSyntheticEvents[offset + EVENT_SIZE], name.data(), name.size());
 }
 
 /**
- * @brief Blocking wait on new events of watched files/directories
- *        specified on the eventmask. FileSystemEvents
- *        will be returned one by one. Thus this
- *        function can be called in some while(true)
- *        loop.
- *
- * @return A new FileSystemEvent
+ * @brief Saves the recursively watched trees to file, a later
+ *        restoreWatchState watches them again without crawling the
+ *        directories that did not change. Every watched directory
+ *        is listed once, thus this is best called when the watches
+ *        are not needed anymore, e.g. before the process exits.
+ *        Watches of single files are not saved.
  *
  */
-boost::optional<FileSystemEvent> Inotify::getNextEvent()
+void Inotify::saveWatchState(const fs::path& file)
 {
-    int length = 0;
-    char buffer[EVENT_BUF_LEN];
-    std::chrono::steady_clock::time_point currentEventTime;
-    std::vector<FileSystemEvent> events;
-
-    // Read Events from fd into buffer
-    while (mEventQueue.empty()) {
-        length = 0;
-        memset(buffer, '\0', sizeof(buffer));
-        while (length <= 0 && !stopped) {
-            std::this_thread::sleep_for(std::chrono::milliseconds(mThreadSleep));
+    timespec now;
+    clock_gettime(CLOCK_REALTIME_COARSE, &now);
+    std::uint64_t saveTime = static_cast<std::uint64_t>(now.tv_sec) * 1000000000u
+        + static_cast<std::uint64_t>(now.tv_nsec);
 
-            length = read(mInotifyFd, buffer, EVENT_BUF_LEN);
-            if (length == -1) {
-                mError = errno;
-                if (mError != EINTR) {
-                    continue;
-                }
-            }
+    // Roots are the recursive watches without a recursively watched parent
+    WatchState state;
+    std::vector<std::pair<std::uint32_t, fs::path>> directories;
+    for (int wd : mDirectories.watches()) {
+        if (!(mDirectories.flags(wd) & DirectoryRegistry::recursive)) {
+            continue;
         }
 
-        if (stopped) {
-            return boost::none;
+        fs::path path = mDirectories.path(wd);
+        int parentWd = mDirectories.find(path.parent_path());
+        if (parentWd != -1 && (mDirectories.flags(parentWd) & DirectoryRegistry::recursive)) {
+            continue;
         }
+        auto index = state.add(path.native(), WatchState::directory | WatchState::watched);
+        directories.emplace_back(index, std::move(path));
+    }
+    state.setRoots(static_cast<std::uint32_t>(directories.size()));
 
-        // Read events from buffer into queue
-        currentEventTime = std::chrono::steady_clock::now();
-        int i = 0;
-        while (i < length) {
-            inotify_event* event = ((struct inotify_event*)&buffer[i]);
-
-            if(event->mask & IN_IGNORED){
-                i += EVENT_SIZE + event->len;
-                mDirectorieMap.left.erase(event->wd);
-                continue;
-            }
+    // Breadth first, the children of every directory are consecutive
+    for (std::size_t i = 0; i < directories.size(); ++i) {
+        auto index = directories[i].first;
+        fs::path path = std::move(directories[i].second);
 
-            auto path = wdToPath(event->wd) / std::string(event->name);
+        // Stat'ed before it is listed, a change in between changes the time again
+        struct stat status;
+        if (stat(path.c_str(), &status) == -1 || !S_ISDIR(status.st_mode)) {
+            state.mutableRecord(index).flags &= ~WatchState::watched;
+            continue;
+        }
+        auto& record = state.mutableRecord(index);
+        record.mtime = modificationTime(status);
+        record.inode = static_cast<std::uint64_t>(status.st_ino);
+        if (record.mtime >= saveTime) {
+            // Changes later in the same tick would keep the time
+            record.flags |= WatchState::racy;
+        }
 
-            if (fs::is_directory(path)) {
-                event->mask |= IN_ISDIR;
+        auto firstChild = state.size();
+        bool listed = listDirectory(path, [&](const char* name, bool isDirectory) {
+            std::uint16_t flags = isDirectory ? WatchState::directory : 0;
+            fs::path child;
+            if (isDirectory) {
+                child = path / name;
+                int childWd = mDirectories.find(child);
+                if (childWd != -1 && (mDirectories.flags(childWd) & DirectoryRegistry::recursive)) {
+                    flags |= WatchState::watched;
+                }
             }
-            FileSystemEvent fsEvent(event->wd, event->mask, path);
-
-            if (!fsEvent.path.empty()) {
-                events.push_back(fsEvent);
 
-            } else {
-                // Event is not complete --> ignore
+            auto childIndex = state.add(name, flags);
+            if (flags & WatchState::watched) {
+                directories.emplace_back(childIndex, std::move(child));
             }
+        });
 
-            i += EVENT_SIZE + event->len;
-        }
-
-        // Filter events
-        for (auto eventIt = events.begin(); eventIt < events.end(); ++eventIt) {
-            FileSystemEvent currentEvent = *eventIt;
-            if (onTimeout(currentEventTime)) {
-                events.erase(eventIt);
-                mOnEventTimeout(currentEvent);
-
-            } else if (isIgnored(currentEvent.path.string())) {
-                events.erase(eventIt);
-            } else {
-                mLastEventTime = currentEventTime;
-                mEventQueue.push(currentEvent);
-            }
+        auto& listedRecord = state.mutableRecord(index);
+        if (!listed) {
+            listedRecord.flags &= ~WatchState::watched;
         }
+        listedRecord.children = state.size() - firstChild;
+        listedRecord.firstChild = listedRecord.children ? firstChild : 0;
     }
 
-    // Return next event
-    FileSystemEvent event = mEventQueue.front();
-    mEventQueue.pop();
-    return event;
+    if (!state.save(file)) {
+        std::stringstream errorStream;
+        errorStream << "Failed to save watch state! " << strerror(errno)
+                    << ". Path: " << file.string();
+        throw std::runtime_error(errorStream.str());
+    }
 }
 
-void Inotify::stop()
+/**
+ * @brief Watches the trees saved by saveWatchState again. Only the
+ *        directories whose modification time or inode changed since
+ *        are listed, their differences to the saved state are
+ *        reported as create and remove events by the next read.
+ *        New directories are crawled and reported like with
+ *        setAutoRecursive. Directory times do not change when files
+ *        are only written, such changes are not reported.
+ *
+ * @return false if the file does not exist or is no valid state,
+ *         nothing is watched then
+ *
+ */
+bool Inotify::restoreWatchState(const fs::path& file)
 {
-    stopped = true;
+    return restoreWatchState(file, fs::path());
 }
 
-bool Inotify::hasStopped()
+/**
+ * @brief Like restoreWatchState(file), but restores only the saved
+ *        tree of root. A root that does not exist anymore is reported
+ *        like by watchDirectoryRecursively.
+ *
+ * @return false if the file is no valid state or has no tree of
+ *         root, nothing is watched then
+ *
+ */
+bool Inotify::restoreWatchState(const fs::path& file, const fs::path& root)
 {
-  return stopped;
-}
+    WatchState state;
+    if (!state.load(file)) {
+        return false;
+    }
 
-bool Inotify::isIgnored(std::string file)
-{
-    for (unsigned i = 0; i < mOnceIgnoredDirectories.size(); ++i) {
-        size_t pos = file.find(mOnceIgnoredDirectories[i]);
-        if (pos != std::string::npos) {
-            mOnceIgnoredDirectories.erase(mOnceIgnoredDirectories.begin() + i);
-            return true;
+    std::vector<std::pair<std::uint32_t, fs::path>> directories;
+    for (std::uint32_t index = 0; index < state.roots(); ++index) {
+        auto name = state.name(state.record(index));
+        fs::path path(name.begin(), name.end());
+        if (root.empty() || path == root) {
+            directories.emplace_back(index, std::move(path));
         }
     }
+    if (directories.empty()) {
+        return false;
+    }
+    if (!root.empty() && !fs::exists(root)) {
+        throwWatchError(root, boost::system::error_code(ENOENT, boost::system::system_category()));
+    }
+
+    // Appended to the pending events, the ones of the last read stay valid
+    SwappedBuffers swapped(mSyntheticEvents, mPendingRestoredEvents);
+    compileIgnoreMatchers();
+
+    for (std::size_t i = 0; i < directories.size(); ++i) {
+        fs::path path = std::move(directories[i].second);
+        restoreDirectory(state, directories[i].first, path, directories);
+    }
+    return true;
+}
+
+/**
+ * @brief Watches a directory of a restored state and queues its
+ *        watched subdirectories in directories
+ */
+void Inotify::restoreDirectory(
+    const WatchState& state,
+    std::uint32_t index,
+    const fs::path& path,
+    std::vector<std::pair<std::uint32_t, fs::path>>& directories)
+{
+    // Removed directories are reported by the listing of their parent
+    struct stat status;
+    if (stat(path.c_str(), &status) == -1 || !S_ISDIR(status.st_mode)
+        || tryAddWatch(path, DirectoryRegistry::recursive, IN_ONLYDIR)) {
+        return;
+    }
+    int wd = mDirectories.find(path);
+    if (wd == -1) {
+        // Ignored now
+        return;
+    }
+
+    const auto& record = state.record(index);
+    bool unchanged = !(record.flags & WatchState::racy) && record.mtime == modificationTime(status)
+        && record.inode == static_cast<std::uint64_t>(status.st_ino);
+    if (unchanged) {
+        for (auto child = record.firstChild; child < record.firstChild + record.children; ++child) {
+            const auto& entry = state.record(child);
+            if (entry.flags & WatchState::watched) {
+                directories.emplace_back(child, path / state.name(entry).to_string());
+            }
+        }
+        return;
+    }
+
+    std::unordered_map<std::string, bool> entries;
+    listDirectory(path, [&](const char* name, bool isDirectory) {
+        entries.emplace(name, isDirectory);
+    });
+
+    for (auto child = record.firstChild; child < record.firstChild + record.children; ++child) {
+        const auto& entry = state.record(child);
+        auto name = state.name(entry);
+        bool wasDirectory = entry.flags & WatchState::directory;
+        auto current = entries.find(name.to_string());
+        if (current == entries.end() || current->second != wasDirectory) {
+            appendSyntheticEvent(wd, IN_DELETE | (wasDirectory ? IN_ISDIR : 0), 0, name);
+            continue;
+        }
+
+        entries.erase(current);
+        if (entry.flags & WatchState::watched) {
+            directories.emplace_back(child, path / name.to_string());
+        }
+    }
+
+    for (const auto& entry : entries) {
+        uint32_t mask = IN_CREATE | (entry.second ? IN_ISDIR : 0);
+        appendSyntheticEvent(wd, mask, 0, entry.first);
+        watchNewDirectory(wd, mask, entry.first);
+    }
+}
+
+/**
+ * @brief Records the events of every following read and the changes
+ *        of the watches to a log, which replayEvents feeds to another
+ *        Inotify later. The log starts with the current watches.
+ *        Events of fanotify marks are not recorded.
+ *
+ */
+void Inotify::recordEvents(const fs::path& file)
+{
+    std::unique_ptr<EventLogWriter> writer(new EventLogWriter);
+    if (!writer->open(file)) {
+        std::stringstream errorStream;
+        errorStream << "Can't record events! " << strerror(errno) << ". Path: " << file.string();
+        throw std::runtime_error(errorStream.str());
+    }
+
+    for (int wd : mDirectories.watches()) {
+        if (!(mDirectories.flags(wd) & DirectoryRegistry::removed)) {
+            writer->watch(wd, mDirectories.flags(wd), mDirectories.path(wd));
+        }
+    }
+    mEventLogWriter = std::move(writer);
+}
+
+/**
+ * @brief Completes the log of recordEvents, it is completed by the
+ *        destructor as well
+ *
+ */
+void Inotify::stopRecording()
+{
+    if (!mEventLogWriter) {
+        return;
+    }
+
+    bool closed = mEventLogWriter->close();
+    int error = errno;
+    mEventLogWriter.reset();
+    if (!closed) {
+        std::stringstream errorStream;
+        errorStream << "Failed to record events! " << strerror(error) << ".";
+        throw std::runtime_error(errorStream.str());
+    }
+}
+
+/**
+ * @brief Reads the events of a log written by recordEvents instead of
+ *        the kernel. The watches are the recorded ones, the masks,
+ *        ignore rules and groups are the ones set here, thus events
+ *        nobody asks for anymore are dropped. Nothing more can be
+ *        watched, the Inotify stops once the last event was returned.
+ *
+ * @param speed ReplaySpeed::original keeps the delays between the
+ *        recorded reads, relative to this call
+ *
+ */
+void Inotify::replayEvents(const fs::path& file, ReplaySpeed speed)
+{
+    if (mDirectories.size() != 0) {
+        throw std::runtime_error("Can't replay events! Paths are watched already.");
+    }
+
+    std::unique_ptr<EventLogReader> reader(new EventLogReader);
+    if (!reader->load(file)) {
+        throw std::runtime_error("Can't replay events! No valid event log. Path: " + file.string());
+    }
+
+    mEventLogReader = std::move(reader);
+    mReplaySpeed = speed;
+    mReplayStart = std::chrono::steady_clock::now();
+    mReplayPosition = 0;
+    mNextReplayedEvents = findReplayedEvents(0);
+}
+
+/**
+ * @return milliseconds until the next replayed read is due, -1 if
+ *         the log is exhausted
+ *
+ */
+int Inotify::replayTimeout() const
+{
+    const auto& records = mEventLogReader->records();
+    if (mNextReplayedEvents == records.size()) {
+        return -1;
+    }
+    if (mReplaySpeed == ReplaySpeed::maximum) {
+        return 0;
+    }
+
+    // Rounded up, waking up early would only spin
+    auto due = mReplayStart + records[mNextReplayedEvents].time;
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        due - std::chrono::steady_clock::now());
+    return remaining.count() < 0 ? 0 : static_cast<int>(remaining.count() + 1);
+}
+
+std::size_t Inotify::findReplayedEvents(std::size_t position) const
+{
+    const auto& records = mEventLogReader->records();
+    while (position < records.size() && records[position].type != EventLogRecord::events) {
+        ++position;
+    }
+    return position;
+}
+
+/**
+ * @brief Applies the changes of the watches recorded before the
+ *        next replayed events, like pending removals only once the
+ *        views of the last read are invalid
+ *
+ */
+void Inotify::applyReplayedRecords()
+{
+    const auto& records = mEventLogReader->records();
+    for (; mReplayPosition < mNextReplayedEvents; ++mReplayPosition) {
+        const auto& record = records[mReplayPosition];
+        if (record.type == EventLogRecord::watch) {
+            replayWatch(record);
+            continue;
+        }
+
+        if (mEventLogWriter && mDirectories.contains(record.wd)) {
+            mEventLogWriter->remove(record.wd);
+        }
+        mDirectories.erase(record.wd);
+    }
+}
+
+void Inotify::replayWatch(const EventLogRecord& record)
+{
+    int wd = record.wd;
+    fs::path path(record.path.begin(), record.path.end());
+    if (static_cast<std::size_t>(wd) >= mWatchMasks.size()) {
+        mWatchMasks.resize(wd + 1, 0);
+        mKernelMasks.resize(wd + 1, 0);
+        mAddedMasks.resize(wd + 1, 0);
+        mWatchGroups.resize(wd + 1, 0);
+    }
+
+    mDirectories.insert(wd, path, record.flags);
+    mAddedMasks[wd] = 0;
+    mWatchGroups[wd] = getWatchGroup(path);
+    mWatchMasks[wd] = getEventMask(path);
+    if (mEventLogWriter) {
+        mEventLogWriter->watch(wd, record.flags, path);
+    }
+}
+
+/**
+ * @brief Sets the number of threads used to crawl directories
+ *        by watchDirectoryRecursively. Watches are still
+ *        added one by one on the calling thread.
+ *
+ * @param threads number of crawling threads
+ *
+ */
+void Inotify::setCrawlThreads(std::size_t threads)
+{
+    mCrawlThreads = threads;
+}
+
+/**
+ * @return Statistics of the last crawl of watchDirectoryRecursively
+ */
+CrawlStatistics Inotify::getCrawlStatistics()
+{
+    return mCrawlStatistics;
+}
+
+void Inotify::ignoreFileOnce(fs::path file)
+{
+    mIgnoreMatcher.ignoreOnce(file.string());
+}
+
+void Inotify::ignoreFile(fs::path file)
+{
+    mIgnoreMatcher.ignore(file.string());
+}
+
+/**
+ * @brief Ignores all files whose name matches the glob
+ *        pattern, e.g. "*.swp"
+ *
+ * @param pattern glob supporting *, ? and [...]
+ *
+ */
+void Inotify::ignorePattern(const std::string& pattern)
+{
+    mIgnoreMatcher.ignorePattern(pattern);
+}
+
+/**
+ * @brief Ignores the file only for the paths of the watch group, the
+ *        rules of the default group apply to every group
+ *
+ */
+void Inotify::ignoreFile(fs::path file, std::uint32_t group)
+{
+    watchGroupIgnores(group).ignore(file.string());
+}
+
+void Inotify::ignorePattern(const std::string& pattern, std::uint32_t group)
+{
+    watchGroupIgnores(group).ignorePattern(pattern);
+}
+
+/**
+ * @brief Adds a named group of watches with an event mask and ignore
+ *        rules of its own. Paths are put into the group by
+ *        setWatchGroup, the others are in the default group 0.
+ *        Events carry the group of their watch, thus several logical
+ *        watchers share one instance, its fds and its reading thread.
+ *
+ * @return id of the group, the existing one if there is a group of
+ *         the name
+ *
+ */
+std::uint32_t Inotify::addWatchGroup(const std::string& name)
+{
+    for (std::size_t group = 1; group < mGroups.size(); ++group) {
+        if (mGroups[group].name == name) {
+            return static_cast<std::uint32_t>(group);
+        }
+    }
+
+    mGroups.emplace_back();
+    mGroups.back().name = name;
+    return static_cast<std::uint32_t>(mGroups.size() - 1);
+}
+
+/**
+ * @brief Puts path and every watched path below it into the group,
+ *        like setEventMask(path, eventMask) the longest matching path
+ *        wins. Watches added before move with the next read.
+ *
+ */
+void Inotify::setWatchGroup(const fs::path& path, std::uint32_t group)
+{
+    checkWatchGroup(group);
+    for (auto& groupRoot : mGroupRoots) {
+        if (groupRoot.first == path) {
+            groupRoot.second = group;
+            mEventMasksChanged = true;
+            return;
+        }
+    }
+
+    mGroupRoots.emplace_back(path, group);
+    mEventMasksChanged = true;
+}
+
+/**
+ * @brief Sets the events the kernel reports for the paths of the
+ *        group, groups without a mask use the one of setEventMask.
+ *        Masks of paths set by setEventMask(path, eventMask) win.
+ *
+ */
+void Inotify::setGroupEventMask(std::uint32_t group, uint32_t eventMask)
+{
+    checkWatchGroup(group);
+    if (group == 0) {
+        setEventMask(eventMask);
+        return;
+    }
+
+    mGroups[group].eventMask = eventMask;
+    mEventMasksChanged = true;
+}
+
+/**
+ * @return group of path, 0 if it is in no group
+ *
+ */
+std::uint32_t Inotify::getWatchGroup(const fs::path& path) const
+{
+    const std::string& native = path.native();
+    std::size_t longest = 0;
+    std::uint32_t group = 0;
+    for (const auto& groupRoot : mGroupRoots) {
+        const std::string& prefix = groupRoot.first.native();
+        if (isPathBelow(native, prefix) && prefix.size() >= longest) {
+            longest = prefix.size();
+            group = groupRoot.second;
+        }
+    }
+    return group;
+}
+
+const std::string& Inotify::getWatchGroupName(std::uint32_t group) const
+{
+    return mGroups.at(group).name;
+}
+
+void Inotify::checkWatchGroup(std::uint32_t group) const
+{
+    if (group >= mGroups.size()) {
+        throw std::invalid_argument("Unknown watch group " + std::to_string(group));
+    }
+}
+
+IgnoreMatcher& Inotify::watchGroupIgnores(std::uint32_t group)
+{
+    checkWatchGroup(group);
+    return group == 0 ? mIgnoreMatcher : mGroups[group].ignores;
+}
+
+/**
+ * @brief Compiles the rules of all groups, the crawl threads match
+ *        against them concurrently
+ *
+ */
+void Inotify::compileIgnoreMatchers()
+{
+    mIgnoreMatcher.compile();
+    for (auto& group : mGroups) {
+        group.ignores.compile();
+    }
+}
+
+bool Inotify::isIgnoredPermanently(boost::string_ref path) const
+{
+    if (mIgnoreMatcher.matchesPermanent(path)) {
+        return true;
+    }
+    if (mGroupRoots.empty()) {
+        return false;
+    }
+
+    auto group = getWatchGroup(fs::path(path.begin(), path.end()));
+    return group != 0 && mGroups[group].ignores.matchesPermanent(path);
+}
+
+
+void Inotify::unwatchFile(fs::path file)
+{
+    int wd = mDirectories.find(file);
+    if (wd == -1 || (mDirectories.flags(wd) & DirectoryRegistry::removed)) {
+        throw std::invalid_argument(
+            "Can´t unwatch Path! Path is not watched. Path: " + file.string());
+    }
+    removeWatch(wd);
+}
+
+/**
+ * @brief Removes the watches of path and of all watched
+ *        files/directories below it. Takes time proportional
+ *        to the size of the subtree. Like removeSubtreeLater the
+ *        registry entries are kept until the next read.
+ *
+ * @param path that will not be watched anymore
+ *
+ */
+void Inotify::unwatchDirectoryRecursively(fs::path path)
+{
+    auto wds = mDirectories.subtree(path);
+    auto removed = std::remove_if(wds.begin(), wds.end(),
+        [this](int wd) { return mDirectories.flags(wd) & DirectoryRegistry::removed; });
+    wds.erase(removed, wds.end());
+    if (wds.empty()) {
+        throw std::invalid_argument(
+            "Can´t unwatch Path! Path is not watched. Path: " + path.string());
+    }
+
+    for (int wd : wds) {
+        // The watch may already be gone, e.g. if the directory was removed
+        removeKernelWatch(wd);
+        mDirectories.setFlags(wd, DirectoryRegistry::removed);
+        mWatchMasks[wd] = 0;
+        mKernelMasks[wd] = 0;
+        mAddedMasks[wd] = 0;
+        mWatchGroups[wd] = 0;
+        mPendingRemovals.push_back(wd);
+    }
+    mCounters.watches.store(getWatchCount(), std::memory_order_relaxed);
+}
+
+/**
+ * @return Number of currently watched files/directories
+ */
+std::size_t Inotify::getWatchCount()
+{
+    return mDirectories.size() - mDirectories.removedSize();
+}
+
+/**
+ * @brief Removes the watches of a deleted or moved away directory
+ *        and of its subtree. The registry entries are kept until
+ *        the next read, because views of the current read still
+ *        refer to them.
+ */
+void Inotify::removeSubtreeLater(int wd)
+{
+    for (int subtreeWd : mDirectories.subtree(wd)) {
+        removeKernelWatch(subtreeWd);
+        mPendingRemovals.push_back(subtreeWd);
+    }
+}
+
+/**
+ * @brief Removes watch from set of watches. This
+ *        is not done recursively!
+ *
+ * @param wd watchdescriptor
+ *
+ */
+void Inotify::removeWatch(int wd)
+{
+    int result = removeKernelWatch(wd);
+    if (result == -1) {
+        mError = errno;
+        std::stringstream errorStream;
+        errorStream << "Failed to remove watch! " << strerror(mError) << ".";
+        throw std::runtime_error(errorStream.str());
+    }
+}
+
+fs::path Inotify::wdToPath(int wd)
+{
+    return mDirectories.path(wd);
+}
+
+/**
+ * @brief Sets the events the kernel reports for watched paths
+ *        without a mask of their own. Watches added before get the
+ *        new mask with the next read.
+ *
+ */
+void Inotify::setEventMask(uint32_t eventMask)
+{
+    mEventMask = eventMask;
+    mEventMasksChanged = true;
+}
+
+/**
+ * @brief Sets the events the kernel reports for path and every
+ *        watched path below it, e.g. close_write only below a
+ *        data directory. The longest matching path wins. Paths
+ *        are compared as they were passed to the watch functions.
+ *
+ */
+void Inotify::setEventMask(const fs::path& path, uint32_t eventMask)
+{
+    for (auto& pathEventMask : mPathEventMasks) {
+        if (pathEventMask.first == path) {
+            pathEventMask.second = eventMask;
+            mEventMasksChanged = true;
+            return;
+        }
+    }
+
+    mPathEventMasks.emplace_back(path, eventMask);
+    mEventMasksChanged = true;
+}
+
+/**
+ * @return events reported for path
+ *
+ */
+uint32_t Inotify::getEventMask(const fs::path& path)
+{
+    const std::string& native = path.native();
+    std::size_t longest = 0;
+    uint32_t eventMask = groupEventMask(getWatchGroup(path));
+
+    for (const auto& pathEventMask : mPathEventMasks) {
+        const std::string& prefix = pathEventMask.first.native();
+        if (isPathBelow(native, prefix) && prefix.size() >= longest) {
+            longest = prefix.size();
+            eventMask = pathEventMask.second;
+        }
+    }
+
+    // Both halves are needed to pair a rename
+    if (mRenameMatcher.enabled() && (eventMask & IN_MOVE)) {
+        eventMask |= IN_MOVE;
+    }
+    return eventMask;
+}
+
+uint32_t Inotify::groupEventMask(std::uint32_t group) const
+{
+    return group != 0 && mGroups[group].eventMask ? *mGroups[group].eventMask : mEventMask;
+}
+
+/**
+ * @brief Events the library needs itself on top of the requested
+ *        ones. They are filtered out again before events are
+ *        passed on.
+ *
+ */
+uint32_t Inotify::internalEventMask(std::uint32_t flags) const
+{
+    uint32_t eventMask = IN_DELETE_SELF | IN_MOVE_SELF;
+    if (flags & DirectoryRegistry::recursive) {
+        eventMask |= IN_CREATE | IN_MOVE;
+    }
+    if (mOverflowRecovery) {
+        eventMask |= IN_CREATE | IN_DELETE | IN_MOVE | IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE;
+    }
+    return eventMask;
+}
+
+/**
+ * @brief Replaces the kernel mask of every watch whose requested or
+ *        internal events changed, events added by IN_MASK_ADD stay
+ *
+ */
+void Inotify::applyEventMasks()
+{
+    mEventMasksChanged = false;
+    for (int wd : mDirectories.watches()) {
+        if (mDirectories.flags(wd) & DirectoryRegistry::removed) {
+            continue;
+        }
+
+        fs::path path = wdToPath(wd);
+        mWatchGroups[wd] = getWatchGroup(path);
+        uint32_t eventMask = getEventMask(path) | mAddedMasks[wd];
+        uint32_t kernelMask = eventMask | internalEventMask(mDirectories.flags(wd));
+        mWatchMasks[wd] = eventMask;
+        if (kernelMask == mKernelMasks[wd] || mEventLogReader) {
+            continue;
+        }
+
+        int kernelWatch
+            = inotify_add_watch(mInotifyFds[shardOf(wd)], path.c_str(), kernelMask);
+        if (kernelWatch != -1 && kernelWatch != kernelWd(wd)) {
+            // The path refers to another inode by now
+            inotify_rm_watch(mInotifyFds[shardOf(wd)], kernelWatch);
+        }
+        mKernelMasks[wd] = kernelMask;
+    }
+
+    for (auto& source : mFanotifySources) {
+        source->setEventMask(fanotifyEventMask());
+    }
+}
+
+uint32_t Inotify::getEventMask()
+{
+    return mEventMask;
+}
+
+/**
+ * @brief Resizes the buffer events are read into. The buffer
+ *        holds maxEvents events with short names and at
+ *        least one event with the longest possible name.
+ *        Views returned before become invalid.
+ *
+ * @param maxEvents number of events read at once
+ *
+ */
+void Inotify::setMaxEvents(std::size_t maxEvents)
+{
+    mMaxEvents = maxEvents;
+    mEventBufferSize = std::max(maxEvents * (EVENT_SIZE + 16), EVENT_SIZE + NAME_MAX + 1);
+    mEventBufferSize = (mEventBufferSize + EVENT_SIZE - 1) / EVENT_SIZE * EVENT_SIZE;
+
+    // Every instance reads into its own part of the buffer
+    mEventBuffer.resize(mEventBufferSize / EVENT_SIZE * mInotifyFds.size());
+    mEventBuffer.shrink_to_fit();
+}
+
+std::size_t Inotify::getMaxEvents()
+{
+    return mMaxEvents;
+}
+
+char* Inotify::eventBuffer(std::size_t shard)
+{
+    return reinterpret_cast<char*>(mEventBuffer.data()) + shard * mEventBufferSize;
+}
+
+void Inotify::setEventTimeout(
+    std::chrono::milliseconds eventTimeout, std::function<void(const FileSystemEvent&)> onEventTimeout)
+{
+    mEventTimeout = eventTimeout;
+    mOnEventTimeout = onEventTimeout;
+}
+
+/**
+ * @brief Blocking wait on new events of watched files/directories
+ *        specified on the eventmask. FileSystemEvents
+ *        will be returned one by one. Thus this
+ *        function can be called in some while(true)
+ *        loop. The wait blocks in epoll and returns
+ *        as soon as events arrive or stop() is called.
+ *
+ * @return A new FileSystemEvent
+ *
+ */
+boost::optional<FileSystemEvent> Inotify::getNextEvent()
+{
+    if (mEventQueue.bounded() && !fillEventQueue()) {
+        return boost::none;
+    }
+
+    while (mEventQueue.empty()) {
+        if (!readEvents(mEventBatch, true)) {
+            return boost::none;
+        }
+
+        for (auto& event : mEventBatch) {
+            mEventQueue.push(std::move(event));
+        }
+        mEventBatch.clear();
+    }
+
+    // Return next event
+    FileSystemEvent event = mEventQueue.pop();
+    mCounters.queuedEvents.store(mEventQueue.size(), std::memory_order_relaxed);
+    mCounters.eventsReturned.fetch_add(1, std::memory_order_relaxed);
+    return event;
+}
+
+/**
+ * @brief Blocking wait on new events like getNextEvent, but
+ *        returns all events parsed from one read of the
+ *        inotify fd at once. Events still queued by
+ *        getNextEvent are returned first.
+ *
+ * @param events is cleared and filled with the new events.
+ *        Reusing the same vector avoids reallocations, the
+ *        paths of the new events reuse the storage of the
+ *        events it held.
+ *
+ * @return Number of returned events, 0 if stopped
+ *
+ */
+std::size_t Inotify::getNextEvents(std::vector<FileSystemEvent>& events)
+{
+    recycleEvents(events);
+    if (mEventQueue.bounded()) {
+        if (!fillEventQueue()) {
+            return 0;
+        }
+        while (mEventQueue.empty()) {
+            if (!readEvents(mEventBatch, true)) {
+                return 0;
+            }
+            for (auto& event : mEventBatch) {
+                mEventQueue.push(std::move(event));
+            }
+            mEventBatch.clear();
+        }
+        return takeQueuedEvents(events);
+    }
+
+    while (!mEventQueue.empty()) {
+        events.push_back(mEventQueue.pop());
+    }
+
+    mCounters.queuedEvents.store(0, std::memory_order_relaxed);
+    while (events.empty()) {
+        if (!readEvents(events, true)) {
+            return 0;
+        }
+    }
+
+    mCounters.eventsReturned.fetch_add(events.size(), std::memory_order_relaxed);
+    return events.size();
+}
+
+/**
+ * @brief Blocking wait on new events like getNextEvents, but
+ *        returns lightweight views on the raw events instead
+ *        of FileSystemEvents. Building views does not
+ *        allocate as long as no ignore rules are set.
+ *
+ * @param views is cleared and filled with the new events. The
+ *        views are valid until the next event is read.
+ *
+ * @return Number of returned views, 0 if stopped
+ *
+ */
+std::size_t Inotify::getNextEventViews(std::vector<EventView>& views)
+{
+    views.clear();
+    while (views.empty()) {
+        if (!readEventViews(views, -1)) {
+            return 0;
+        }
+    }
+
+    mCounters.eventsReturned.fetch_add(views.size(), std::memory_order_relaxed);
+    return views.size();
+}
+
+/**
+ * @brief Non blocking variant of getNextEvents for external event
+ *        loops. Parses what is readable right now and the events
+ *        held back by rename pairing or coalescing that are due.
+ *
+ * @return number of events, 0 if nothing is ready or stop() was
+ *         called and no events were queued anymore
+ *
+ */
+std::size_t Inotify::tryGetEvents(std::vector<FileSystemEvent>& events)
+{
+    recycleEvents(events);
+    if (mEventQueue.bounded()) {
+        if (!fillEventQueue() && mEventQueue.empty()) {
+            return 0;
+        }
+        return takeQueuedEvents(events);
+    }
+
+    while (!mEventQueue.empty()) {
+        events.push_back(mEventQueue.pop());
+    }
+
+    // Events taken from the queue are returned even after a stop
+    mCounters.queuedEvents.store(0, std::memory_order_relaxed);
+    if (!readEvents(events, false) && events.empty()) {
+        return 0;
+    }
+    mCounters.eventsReturned.fetch_add(events.size(), std::memory_order_relaxed);
+    return events.size();
+}
+
+/**
+ * @brief Moves everything readable right now into the bounded event
+ *        queue. Under overload the kernel queue is drained into it,
+ *        thus the events are shed by their priority instead of being
+ *        lost to a kernel queue overflow.
+ *
+ * @return false if stop() was called
+ *
+ */
+bool Inotify::fillEventQueue()
+{
+    std::size_t filled = 0;
+    while (filled < std::max<std::size_t>(1, mEventQueue.capacity())) {
+        if (!readEvents(mEventBatch, false)) {
+            return false;
+        }
+        if (mEventBatch.empty()) {
+            break;
+        }
+
+        filled += mEventBatch.size();
+        for (auto& event : mEventBatch) {
+            mEventQueue.push(std::move(event));
+        }
+        mEventBatch.clear();
+    }
+    return true;
+}
+
+/**
+ * @brief Appends at most one buffer of queued events, higher
+ *        priorities first
+ *
+ * @return number of events
+ *
+ */
+std::size_t Inotify::takeQueuedEvents(std::vector<FileSystemEvent>& events)
+{
+    while (!mEventQueue.empty() && events.size() < mMaxEvents) {
+        events.push_back(mEventQueue.pop());
+    }
+
+    mCounters.queuedEvents.store(mEventQueue.size(), std::memory_order_relaxed);
+    mCounters.eventsReturned.fetch_add(events.size(), std::memory_order_relaxed);
+    return events.size();
+}
+
+/**
+ * @brief The fd becomes readable as soon as events can be read, it
+ *        can be polled by an external event loop which then calls
+ *        tryGetEvents. There is a single fd for all inotify
+ *        instances.
+ *
+ */
+int Inotify::getFileDescriptor()
+{
+    return mEpollFd;
+}
+
+/**
+ * @brief External event loops have to call tryGetEvents after this
+ *        timeout even if the fd did not become readable, to get the
+ *        events held back by rename pairing or coalescing.
+ *
+ * @return timeout in milliseconds, -1 if no events are held back
+ *
+ */
+int Inotify::getNextTimeout()
+{
+    int timeout = pendingTimeout();
+    if (!mEventLogReader) {
+        return timeout;
+    }
+
+    // An exhausted replay stops with the next tryGetEvents
+    int replay = replayTimeout();
+    if (replay == -1) {
+        return timeout == -1 ? 0 : timeout;
+    }
+    return timeout == -1 ? replay : std::min(timeout, replay);
+}
+
+/**
+ * @brief Waits for the inotify fd, reads one buffer of raw
+ *        events and appends the parsed and filtered events.
+ *
+ * @param block waits until events arrive or held back events are
+ *        due, otherwise only what is ready is read
+ *
+ * @return false if stop() was called
+ *
+ */
+bool Inotify::readEvents(std::vector<FileSystemEvent>& events, bool block)
+{
+    if (!readEventViews(mEventViews, block ? pendingTimeout() : 0)) {
+        return false;
+    }
+
+    // The kernel already sets IN_ISDIR, the mask is used as is
+    auto now = std::chrono::steady_clock::now();
+    auto& checked = mContentFilter ? mCheckedEvents : events;
+    auto& staged = mEventCoalescer.enabled() ? mStagedEvents : checked;
+    for (const auto& view : mEventViews) {
+        auto event = makeEvent(view);
+        if (mRenameMatcher.enabled()) {
+            mRenameMatcher.process(std::move(event), now, staged);
+        } else {
+            staged.push_back(std::move(event));
+        }
+    }
+    mEventViews.clear();
+    mRenameMatcher.flushExpired(now, staged);
+
+    if (mEventCoalescer.enabled()) {
+        // Merged events are left as they are, their storage is reused
+        for (auto& event : mStagedEvents) {
+            if (!mEventCoalescer.process(std::move(event), now, checked)
+                && mSpareEvents.size() < maxSpareEvents) {
+                mSpareEvents.push_back(std::move(event));
+            }
+        }
+        mStagedEvents.clear();
+        mEventCoalescer.flushExpired(now, checked);
+    } else if (mEventCoalescer.pending()) {
+        mEventCoalescer.flushAll(checked);
+    }
+
+    if (mContentFilter) {
+        for (auto& event : mCheckedEvents) {
+            mContentFilter->process(std::move(event), events);
+        }
+        mCheckedEvents.clear();
+        if (mContentChecksReady) {
+            mContentChecksReady = false;
+            auto unchanged = mContentFilter->collect(events);
+            mCounters.eventsUnchanged.fetch_add(unchanged, std::memory_order_relaxed);
+        }
+    }
+
+    return true;
+}
+
+/**
+ * @brief Builds the event of a view, reusing the path storage of a
+ *        spare event if there is one
+ */
+FileSystemEvent Inotify::makeEvent(const EventView& view)
+{
+    if (mSpareEvents.empty()) {
+        FileSystemEvent event(view.wd, view.mask, view.path(), view.cookie);
+        event.group = view.group;
+        return event;
+    }
+
+    FileSystemEvent event = std::move(mSpareEvents.back());
+    mSpareEvents.pop_back();
+    event.reuse(view.wd, view.mask, view.cookie);
+    event.group = view.group;
+    view.assignPath(event.path);
+    return event;
+}
+
+/**
+ * @brief Clears the events and keeps them as spare events, the paths
+ *        of the next events are built into their storage. In steady
+ *        state no event allocates.
+ */
+void Inotify::recycleEvents(std::vector<FileSystemEvent>& events)
+{
+    for (auto& event : events) {
+        if (mSpareEvents.size() == maxSpareEvents) {
+            break;
+        }
+        mSpareEvents.push_back(std::move(event));
+    }
+    events.clear();
+}
+
+/**
+ * @return milliseconds until the earliest event held back by the
+ *         rename pairing or the coalescing is due, -1 if none is
+ *
+ */
+int Inotify::pendingTimeout() const
+{
+    if (!mPendingRestoredEvents.empty()) {
+        return 0;
+    }
+
+    auto deadline = mRenameMatcher.nextDeadline();
+    auto coalescerDeadline = mEventCoalescer.nextDeadline();
+    if (!deadline || (coalescerDeadline && *coalescerDeadline < *deadline)) {
+        deadline = coalescerDeadline;
+    }
+    if (!deadline) {
+        return -1;
+    }
+
+    // Rounded up, waking up early would only spin
+    auto remaining = std::chrono::duration_cast<std::chrono::milliseconds>(
+        *deadline - std::chrono::steady_clock::now());
+    return static_cast<int>(std::max<long long>(0, remaining.count() + 1));
+}
+
+/**
+ * @brief Waits for the inotify fd, reads one buffer of raw
+ *        events into the event buffer and appends views on
+ *        the events that pass the filters.
+ *
+ * @param timeout in milliseconds after which the wait returns
+ *        without events, -1 waits forever
+ *
+ * @return false if stop() was called
+ *
+ */
+bool Inotify::readEventViews(std::vector<EventView>& views, int timeout)
+{
+    if (mEventMasksChanged) {
+        applyEventMasks();
+    }
+
+    if (mGrowEventBuffer) {
+        // The buffer of the last read is not referenced anymore
+        mGrowEventBuffer = false;
+        setMaxEvents(std::min(mMaxEvents * 2, std::max(mMaxEvents, maxGrownEvents)));
+    }
+
+    // Read events of every ready instance into its buffer, read
+    // overwrites exactly length bytes
+    bool hasRead = false;
+    std::fill(mReadLengths.begin(), mReadLengths.end(), 0);
+    mFanotifyEvents.clear();
+    mContentChecksReady = false;
+    mReplayReady = false;
+    // Restored events are ready without waiting
+    if (!mPendingRestoredEvents.empty()) {
+        timeout = 0;
+    }
+    while (!hasRead && waitForEvents(timeout)) {
+        hasRead = mContentChecksReady || mReplayReady;
+        for (std::size_t shard : mReadyShards) {
+            if (shard >= mInotifyFds.size()) {
+                auto& source = mFanotifySources[shard - mInotifyFds.size()];
+                if (source->read(mFanotifyEvents)) {
+                    mCounters.reads.fetch_add(1, std::memory_order_relaxed);
+                    hasRead |= !mFanotifyEvents.empty();
+                }
+                continue;
+            }
+
+            ssize_t length = read(mInotifyFds[shard], eventBuffer(shard), mEventBufferSize);
+            if (length == -1) {
+                mError = errno;
+                continue;
+            }
+
+            translateWatchDescriptors(eventBuffer(shard), length, shard);
+            mReadLengths[shard] = static_cast<std::size_t>(length);
+            mCounters.reads.fetch_add(1, std::memory_order_relaxed);
+            mCounters.bytesRead.fetch_add(mReadLengths[shard], std::memory_order_relaxed);
+            hasRead |= length > 0;
+        }
+    }
+
+    if (stopped) {
+        return false;
+    }
+
+    mPreviousDirectoryMoves.swap(mDirectoryMoves);
+    mDirectoryMoves.clear();
+
+    // Views of the last read are invalid now
+    for (int wd : mPendingRemovals) {
+        if (mEventLogWriter && mDirectories.contains(wd)) {
+            mEventLogWriter->remove(wd);
+        }
+        mDirectories.erase(wd);
+        mSnapshots.erase(wd);
+    }
+    mPendingRemovals.clear();
+    if (mReplayReady) {
+        applyReplayedRecords();
+    }
+    mCounters.watches.store(getWatchCount(), std::memory_order_relaxed);
+
+    // Synthetic events are parsed after the kernel events which caused
+    // them, restored events describe changes before all of them
+    auto currentEventTime = std::chrono::steady_clock::now();
+    mSyntheticEvents.clear();
+    mRestoredEvents.clear();
+    mRestoredEvents.swap(mPendingRestoredEvents);
+    parseEvents(mRestoredEvents.data(), mRestoredEvents.size(), EventOrigin::synthetic,
+        currentEventTime, views);
+    for (std::size_t shard = 0; shard < mInotifyFds.size(); ++shard) {
+        parseEvents(
+            eventBuffer(shard), mReadLengths[shard], EventOrigin::kernel, currentEventTime, views);
+    }
+    if (mReplayReady) {
+        const auto& record = mEventLogReader->records()[mNextReplayedEvents];
+        mCounters.reads.fetch_add(1, std::memory_order_relaxed);
+        mCounters.bytesRead.fetch_add(record.length, std::memory_order_relaxed);
+        parseEvents(record.buffer, record.length, EventOrigin::replay, currentEventTime, views);
+        mReplayPosition = mNextReplayedEvents + 1;
+        mNextReplayedEvents = findReplayedEvents(mReplayPosition);
+    }
+    parseFanotifyEvents(currentEventTime, views);
+    parseEvents(mSyntheticEvents.data(), mSyntheticEvents.size(), EventOrigin::synthetic,
+        currentEventTime, views);
+
+    return true;
+}
+
+/**
+ * @brief Reads events from buffer, filters them and appends them
+ *        to views.
+ *
+ * @param origin kernel events update the watches, synthetic ones
+ *        do not, replayed ones only follow renamed directories
+ *
+ */
+void Inotify::parseEvents(
+    const char* buffer,
+    std::size_t length,
+    EventOrigin origin,
+    const std::chrono::steady_clock::time_point& currentEventTime,
+    std::vector<EventView>& views)
+{
+    // Counted once per buffer, the counters are shared with other threads
+    std::uint64_t parsed = 0;
+    std::uint64_t ignored = 0;
+    std::uint64_t timedOut = 0;
+    if (mEventLogWriter) {
+        mEventLogWriter->events(buffer, length);
+    }
+
+    std::size_t i = 0;
+    while (i < length) {
+        const inotify_event* event = reinterpret_cast<const inotify_event*>(&buffer[i]);
+        i += EVENT_SIZE + event->len;
+        ++parsed;
+
+        if (event->mask & IN_IGNORED) {
+            mPendingRemovals.push_back(event->wd);
+            continue;
+        }
+
+        boost::string_ref name(event->name, strnlen(event->name, event->len));
+        if (event->mask & IN_Q_OVERFLOW) {
+            // Has no watch, passed on to signal that events were lost
+            if (origin == EventOrigin::kernel) {
+                recoverFromOverflow(parsed);
+            }
+        } else if (!mDirectories.contains(event->wd)) {
+            // Event of an already removed watch --> ignore
+            continue;
+        } else if (origin == EventOrigin::kernel) {
+            if (event->mask & IN_DELETE_SELF) {
+                removeSubtreeLater(event->wd);
+            } else if ((event->mask & IN_MOVE_SELF) && !fs::exists(wdToPath(event->wd))) {
+                // Moved out of its watched parent, the path is stale
+                removeSubtreeLater(event->wd);
+            }
+
+            if (!renameDirectory(*event) && mAutoRecursive) {
+                watchNewDirectory(event->wd, event->mask, name);
+            }
+            mSnapshots.update(event->wd, event->mask, name);
+        } else if (origin == EventOrigin::replay) {
+            // The watches of the replayed log follow from its records
+            renameDirectory(*event);
+        }
+
+        // Internal events nobody asked for end here
+        if (event->wd != -1 && !(event->mask & mWatchMasks[event->wd] & IN_ALL_EVENTS)
+            && !(event->mask & IN_UNMOUNT)) {
+            continue;
+        }
+
+        EventView view(event->wd, event->mask, event->cookie, name, mDirectories);
+        view.group = event->wd != -1 ? mWatchGroups[event->wd] : 0;
+
+        if (onTimeout(currentEventTime)) {
+            ++timedOut;
+            mOnEventTimeout(FileSystemEvent(view.wd, view.mask, view.path(), view.cookie));
+        } else if (view.wd != -1 && isIgnored(view)) {
+            ++ignored;
+            continue;
+        } else {
+            mLastEventTime = currentEventTime;
+            views.push_back(view);
+        }
+    }
+
+    mCounters.eventsParsed.fetch_add(parsed, std::memory_order_relaxed);
+    mCounters.eventsIgnored.fetch_add(ignored, std::memory_order_relaxed);
+    mCounters.eventsTimedOut.fetch_add(timedOut, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Filters the events read from fanotify marks like the ones
+ *        of inotify and appends views on them to views
+ *
+ */
+void Inotify::parseFanotifyEvents(
+    const std::chrono::steady_clock::time_point& currentEventTime,
+    std::vector<EventView>& views)
+{
+    // Marks report the union of the masks of all paths
+    uint32_t eventMask = getEventMask(fs::path());
+    std::uint64_t ignored = 0;
+    std::uint64_t timedOut = 0;
+
+    for (const auto& event : mFanotifyEvents) {
+        if (!event.directory) {
+            // Overflow of the fanotify queue, has no directory
+            recoverFromOverflow(mFanotifyEvents.size());
+        } else if (!mPathEventMasks.empty()) {
+            eventMask = getEventMask(*event.directory / event.name.to_string());
+        }
+
+        if (event.directory && !(event.mask & eventMask & IN_ALL_EVENTS)) {
+            continue;
+        }
+        if (event.directory && mIgnoreMatcher.matches(*event.directory, event.name)) {
+            ++ignored;
+            continue;
+        }
+
+        EventView view = event.directory
+            ? EventView(FanotifySource::markWd, event.mask, event.cookie, event.name,
+                  *event.directory)
+            : EventView(-1, event.mask, 0, event.name, mDirectories);
+
+        if (onTimeout(currentEventTime)) {
+            ++timedOut;
+            mOnEventTimeout(FileSystemEvent(view.wd, view.mask, view.path(), view.cookie));
+        } else {
+            mLastEventTime = currentEventTime;
+            views.push_back(view);
+        }
+    }
+
+    mCounters.eventsParsed.fetch_add(mFanotifyEvents.size(), std::memory_order_relaxed);
+    mCounters.eventsIgnored.fetch_add(ignored, std::memory_order_relaxed);
+    mCounters.eventsTimedOut.fetch_add(timedOut, std::memory_order_relaxed);
+}
+
+/**
+ * @brief Handles a kernel queue overflow, i.e. events were dropped.
+ *        The read buffer is grown for the next read and, if overflow
+ *        recovery is enabled, every watched path is compared with its
+ *        snapshot. The differences are reported as synthetic events.
+ *
+ * @param parsed events of the current buffer, not counted yet
+ *
+ */
+void Inotify::recoverFromOverflow(std::uint64_t parsed)
+{
+    auto overflows = mCounters.overflows.fetch_add(1, std::memory_order_relaxed) + 1;
+    mGrowEventBuffer = true;
+    if (mOnOverflow) {
+        reportOverflow(overflows, parsed);
+    }
+    if (!mOverflowRecovery) {
+        return;
+    }
+
+    for (int wd : mSnapshots.watches()) {
+        if (!mDirectories.contains(wd)) {
+            continue;
+        }
+
+        fs::path path = wdToPath(wd);
+        bool exists = mSnapshots.rescan(wd, path, [&](uint32_t mask, const std::string& name) {
+            appendSyntheticEvent(wd, mask, 0, name);
+            if (mAutoRecursive) {
+                watchNewDirectory(wd, mask, name);
+            }
+        });
+
+        if (!exists) {
+            appendSyntheticEvent(wd, IN_DELETE_SELF, 0, boost::string_ref());
+            removeSubtreeLater(wd);
+        }
+    }
+}
+
+/**
+ * @brief Compares max_queued_events with the rate of the events since
+ *        the previous overflow and passes both to the overflow observer
+ *
+ */
+void Inotify::reportOverflow(std::uint64_t overflows, std::uint64_t parsed)
+{
+    auto now = std::chrono::steady_clock::now();
+    auto events = mCounters.eventsParsed.load(std::memory_order_relaxed) + parsed;
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(now - mLastOverflowTime);
+
+    QueueOverflow overflow;
+    overflow.maxQueuedEvents = getMaxQueuedEvents();
+    overflow.eventsPerSecond = (events - mLastOverflowEvents) * 1000
+        / static_cast<std::uint64_t>(std::max<std::chrono::milliseconds::rep>(1, elapsed.count()));
+    overflow.overflows = overflows;
+    mLastOverflowTime = now;
+    mLastOverflowEvents = events;
+    mOnOverflow(overflow);
+}
+
+/**
+ * @brief Calls the observer after every kernel queue overflow, e.g. to
+ *        warn that max_queued_events is too small for the event rate.
+ *        It runs on the reading thread before the recovery.
+ *
+ */
+void Inotify::setOverflowObserver(std::function<void(const QueueOverflow&)> onOverflow)
+{
+    mOnOverflow = std::move(onOverflow);
+}
+
+/**
+ * @brief Keeps a snapshot of every watched path, thus events lost
+ *        due to a kernel queue overflow are recovered by comparing
+ *        the snapshots with the file system. Applies to watches
+ *        added afterwards.
+ *
+ */
+void Inotify::setOverflowRecovery(bool recovery)
+{
+    mOverflowRecovery = recovery;
+    mEventMasksChanged = true;
+    if (!recovery) {
+        mSnapshots.clear();
+    }
+}
 
-    for (unsigned i = 0; i < mIgnoredDirectories.size(); ++i) {
-        size_t pos = file.find(mIgnoredDirectories[i]);
-        if (pos != std::string::npos) {
-            return true;
+/**
+ * @return number of kernel queue overflows since construction
+ *
+ */
+std::size_t Inotify::getOverflowCount()
+{
+    return mCounters.overflows.load(std::memory_order_relaxed);
+}
+
+/**
+ * @brief Counters of the reading path, safe to call from any thread
+ *        while another one reads events
+ *
+ */
+EventStatistics Inotify::getStatistics() const
+{
+    auto statistics = mCounters.snapshot();
+    statistics.maxWatches = getMaxWatches();
+    statistics.eventsShedLow = mEventQueue.getShedEvents(EventPriority::low);
+    statistics.eventsShedNormal = mEventQueue.getShedEvents(EventPriority::normal);
+    statistics.eventsCollapsed = mEventQueue.getCollapsedEvents();
+    return statistics;
+}
+
+/**
+ * @return maximum number of watches per user, all inotify instances
+ *         of the user share them
+ *
+ */
+std::size_t Inotify::getMaxWatches()
+{
+    std::ifstream stream("/proc/sys/fs/inotify/max_user_watches");
+    std::size_t maxWatches = 0;
+    stream >> maxWatches;
+    return maxWatches;
+}
+
+/**
+ * @brief Events the kernel queues per inotify instance before it
+ *        overflows, see /proc/sys/fs/inotify/max_queued_events.
+ *        Bursts larger than this limit lose events.
+ *
+ * @return the limit or 0 if unknown
+ *
+ */
+std::size_t Inotify::getMaxQueuedEvents()
+{
+    std::ifstream stream("/proc/sys/fs/inotify/max_queued_events");
+    std::size_t maxQueuedEvents = 0;
+    stream >> maxQueuedEvents;
+    return maxQueuedEvents;
+}
+
+/**
+ * @brief Rewrites the registered paths of a directory renamed
+ *        inside the watched tree, thus its subtree is not
+ *        crawled again. The moved_from half is remembered until
+ *        the moved_to half with the same cookie arrives.
+ *
+ * @return true if registered paths were renamed
+ *
+ */
+bool Inotify::renameDirectory(const inotify_event& event)
+{
+    if (!(event.mask & IN_ISDIR) || !(event.mask & IN_MOVE)) {
+        return false;
+    }
+
+    auto path = wdToPath(event.wd) / event.name;
+    if (event.mask & IN_MOVED_FROM) {
+        mDirectoryMoves[event.cookie] = path;
+        return false;
+    }
+
+    for (auto* moves : { &mDirectoryMoves, &mPreviousDirectoryMoves }) {
+        auto movedFrom = moves->find(event.cookie);
+        if (movedFrom != moves->end()) {
+            bool renamed = mDirectories.rename(movedFrom->second, path);
+            moves->erase(movedFrom);
+            return renamed;
+        }
+    }
+
+    return false;
+}
+
+/**
+ * @brief Joins the moved_from and moved_to events of renames
+ *        inside the watched tree into one IN_MOVE event with
+ *        both paths. Halves without partner after the window
+ *        are reported as remove or create events.
+ *
+ * @param window the moved_from half waits for its moved_to half,
+ *        zero disables the pairing
+ *
+ */
+void Inotify::setRenamePairingWindow(std::chrono::milliseconds window)
+{
+    mRenameMatcher.setWindow(window);
+    mEventMasksChanged = true;
+}
+
+/**
+ * @brief Merges bursts of events on the same path into one event
+ *        whose mask holds all merged bits. It is emitted once the
+ *        path was quiet for the period, or right away on close_write
+ *        and remove events. Unlike setEventTimeout every path has
+ *        its own quiet period.
+ *
+ * @param quietPeriod zero disables the coalescing
+ *
+ */
+void Inotify::setCoalescingPeriod(std::chrono::milliseconds quietPeriod)
+{
+    mEventCoalescer.setQuietPeriod(quietPeriod);
+}
+
+/**
+ * @brief Bounds the queue of events read but not returned yet. The
+ *        queue is filled with everything readable on every call of
+ *        getNextEvent(s) and tryGetEvents, which return critical
+ *        events like delete_self and unmount first and shed access,
+ *        open and close_nowrite events first once the queue is full.
+ *        Shed events are counted in the statistics.
+ *
+ * @param capacity number of queued events before events are shed
+ * @param shedding Shedding::none keeps the unbounded queue in the
+ *        order the events were read
+ *
+ */
+void Inotify::setEventQueue(std::size_t capacity, Shedding shedding)
+{
+    mEventQueue.setCapacity(capacity, shedding);
+    mCounters.queuedEvents.store(mEventQueue.size(), std::memory_order_relaxed);
+}
+
+/**
+ * @brief Drops modify and close_write events of files whose content
+ *        did not change since the last event of the same kind, e.g.
+ *        of tools rewriting a file as it was. The files are stat'ed
+ *        and hashed on worker threads, events of a checked path are
+ *        held back until its check completed. Applies to the events
+ *        of getNextEvent(s) and tryGetEvents, not to views.
+ *
+ * @param check ContentCheck::off disables the filter, events held
+ *        back are queued unchecked
+ * @param threads number of workers checking files
+ *
+ */
+void Inotify::setContentCheck(ContentCheck check, std::size_t threads)
+{
+    if (mContentFilter) {
+        std::vector<FileSystemEvent> events;
+        mContentFilter->flushAll(events);
+        for (auto& event : events) {
+            mEventQueue.push(std::move(event));
+        }
+        epoll_ctl(mEpollFd, EPOLL_CTL_DEL, mContentFilter->getFileDescriptor(), nullptr);
+        mContentFilter.reset();
+        mContentChecksReady = false;
+    }
+
+    if (check == ContentCheck::off) {
+        return;
+    }
+
+    std::unique_ptr<ContentFilter> filter(new ContentFilter(check, threads));
+
+    // Edge triggered, waiting for views does not collect the checks
+    epoll_event completedEvent {};
+    completedEvent.events = EPOLLIN | EPOLLET;
+    completedEvent.data.fd = filter->getFileDescriptor();
+    if (epoll_ctl(mEpollFd, EPOLL_CTL_ADD, filter->getFileDescriptor(), &completedEvent) == -1) {
+        mError = errno;
+        std::stringstream errorStream;
+        errorStream << "Can't initialize epoll ! " << strerror(mError) << ".";
+        throw std::runtime_error(errorStream.str());
+    }
+    mContentFilter = std::move(filter);
+}
+
+/**
+ * @brief Blocks in the kernel until the inotify fd becomes
+ *        readable or stop() was called. No cpu time is
+ *        consumed while waiting.
+ *
+ * @param timeout in milliseconds, -1 waits forever
+ *
+ * @return false if the wait was interrupted by stop() or timed out
+ *
+ */
+bool Inotify::waitForEvents(int timeout)
+{
+    mEpollEvents.resize(mInotifyFds.size() + mFanotifySources.size() + (mContentFilter ? 2 : 1));
+    while (!stopped) {
+        // The next replayed read is due like an expired timeout
+        int waitTimeout = timeout;
+        bool replayDue = false;
+        if (mEventLogReader) {
+            int replay = replayTimeout();
+            if (replay == -1 && pendingTimeout() == -1
+                && !(mContentFilter && mContentFilter->pending())) {
+                // The log is exhausted and no event is held back anymore,
+                // the watches recorded after the last events still change
+                applyReplayedRecords();
+                mCounters.watches.store(getWatchCount(), std::memory_order_relaxed);
+                stop();
+                return false;
+            }
+            if (replay != -1 && (timeout == -1 || replay <= timeout)) {
+                waitTimeout = replay;
+                replayDue = true;
+            }
+        }
+
+        int ready = epoll_wait(
+            mEpollFd, mEpollEvents.data(), static_cast<int>(mEpollEvents.size()), waitTimeout);
+        if (ready == -1) {
+            mError = errno;
+            if (mError == EINTR) {
+                continue;
+            }
+            std::stringstream errorStream;
+            errorStream << "Failed to wait for events! " << strerror(mError) << ".";
+            throw std::runtime_error(errorStream.str());
+        }
+
+        if (ready == 0) {
+            if (replayDue) {
+                mReadyShards.clear();
+                mReplayReady = true;
+                mCounters.wakeups.fetch_add(1, std::memory_order_relaxed);
+                return true;
+            }
+            return false;
+        }
+
+        mReadyShards.clear();
+        for (int i = 0; i < ready; ++i) {
+            if (mContentFilter && mContentFilter->getFileDescriptor() == mEpollEvents[i].data.fd) {
+                mContentChecksReady = true;
+                continue;
+            }
+
+            auto inotifyFd
+                = std::find(mInotifyFds.begin(), mInotifyFds.end(), mEpollEvents[i].data.fd);
+            if (inotifyFd != mInotifyFds.end()) {
+                mReadyShards.push_back(inotifyFd - mInotifyFds.begin());
+                continue;
+            }
+
+            // Marks are read after the instances
+            for (std::size_t source = 0; source < mFanotifySources.size(); ++source) {
+                if (mFanotifySources[source]->getFileDescriptor() == mEpollEvents[i].data.fd) {
+                    mReadyShards.push_back(mInotifyFds.size() + source);
+                }
+            }
+        }
+        if (!mReadyShards.empty() || mContentChecksReady) {
+            mCounters.wakeups.fetch_add(1, std::memory_order_relaxed);
+            return !stopped;
         }
     }
 
     return false;
 }
 
+void Inotify::stop()
+{
+    stopped = true;
+
+    // Wake up a thread blocked in waitForEvents
+    std::uint64_t wakeup = 1;
+    if (write(mStopFd, &wakeup, sizeof(wakeup)) == -1) {
+        mError = errno;
+    }
+}
+
+bool Inotify::hasStopped()
+{
+  return stopped;
+}
+
+bool Inotify::isIgnored(const EventView& view)
+{
+    mDirectories.assignPath(view.wd, mIgnoredDirectory);
+    return mIgnoreMatcher.matches(mIgnoredDirectory, view.name)
+        || (view.group != 0 && mGroups[view.group].ignores.matches(mIgnoredDirectory, view.name));
+}
+
+bool Inotify::isIgnored(const fs::path& file)
+{
+    if (mIgnoreMatcher.matches(file.native())) {
+        return true;
+    }
+
+    auto group = mGroupRoots.empty() ? 0 : getWatchGroup(file);
+    return group != 0 && mGroups[group].ignores.matches(file.native());
+}
+
 bool Inotify::onTimeout(const std::chrono::steady_clock::time_point& eventTime)
 {
     return std::chrono::duration_cast<std::chrono::milliseconds>(eventTime - mLastEventTime) < mEventTimeout;
@@ -0,0 +1,137 @@
+#include <inotify-cpp/NotificationExecutor.h>
+
+#include <stdexcept>
+#include <string>
+
+namespace inotify {
+
+NotificationExecutor::Worker::Worker(std::size_t queueDepth)
+    : queue(queueDepth)
+    , sleeping(false)
+    , blocked(false)
+{
+}
+
+NotificationExecutor::NotificationExecutor(
+    std::size_t threads, std::size_t queueDepth, Backpressure backpressure, Dispatch dispatch)
+    : mBackpressure(backpressure)
+    , mDispatch(std::move(dispatch))
+    , mStopped(false)
+    , mDropped(0)
+{
+    if (threads == 0 || queueDepth == 0) {
+        throw std::invalid_argument(
+            "Observer threads and queue depth have to be greater than zero");
+    }
+
+    for (std::size_t i = 0; i < threads; ++i) {
+        mWorkers.emplace_back(new Worker(queueDepth));
+    }
+    for (std::size_t i = 0; i < threads; ++i) {
+        mWorkers[i]->thread = std::thread([this, i]() { work(i); });
+    }
+}
+
+NotificationExecutor::~NotificationExecutor()
+{
+    stop();
+}
+
+/**
+ * @brief Queues the notification on the worker of its path.
+ *
+ * @return false if the notification was dropped
+ *
+ */
+auto NotificationExecutor::submit(const Notification& notification) -> bool
+{
+    if (mStopped) {
+        return false;
+    }
+
+    auto shard = std::hash<std::string>()(notification.path.native()) % mWorkers.size();
+    auto& worker = *mWorkers[shard];
+
+    while (!worker.queue.push(notification)) {
+        if (mBackpressure == Backpressure::drop) {
+            ++mDropped;
+            return false;
+        }
+
+        // The flag is set before the queue is checked again, thus the
+        // worker either sees it or the space it made is seen here. The
+        // queue indices are no seq_cst atomics, only the fences here and
+        // in work keep the flag and index accesses from being reordered.
+        std::unique_lock<std::mutex> lock(worker.mutex);
+        worker.blocked = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        worker.space.wait(
+            lock, [&]() { return worker.queue.write_available() > 0 || mStopped; });
+        worker.blocked = false;
+        if (mStopped) {
+            return false;
+        }
+    }
+
+    std::atomic_thread_fence(std::memory_order_seq_cst);
+    if (worker.sleeping) {
+        std::lock_guard<std::mutex> lock(worker.mutex);
+        worker.wakeup.notify_one();
+    }
+    return true;
+}
+
+/**
+ * @brief Lets the workers run the queued notifications and joins them
+ */
+auto NotificationExecutor::stop() -> void
+{
+    if (mStopped.exchange(true)) {
+        return;
+    }
+
+    for (auto& worker : mWorkers) {
+        std::lock_guard<std::mutex> lock(worker->mutex);
+        worker->wakeup.notify_one();
+        worker->space.notify_one();
+    }
+    for (auto& worker : mWorkers) {
+        worker->thread.join();
+    }
+}
+
+auto NotificationExecutor::getDroppedNotifications() const -> std::size_t
+{
+    return mDropped;
+}
+
+auto NotificationExecutor::work(std::size_t index) -> void
+{
+    auto& worker = *mWorkers[index];
+    Notification notification;
+
+    while (true) {
+        while (worker.queue.pop(notification)) {
+            mDispatch(index, notification);
+
+            // Pairs with the fences of submit, see there
+            std::atomic_thread_fence(std::memory_order_seq_cst);
+            if (worker.blocked) {
+                std::lock_guard<std::mutex> lock(worker.mutex);
+                worker.space.notify_one();
+            }
+        }
+
+        std::unique_lock<std::mutex> lock(worker.mutex);
+        worker.sleeping = true;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+        worker.wakeup.wait(
+            lock, [&]() { return worker.queue.read_available() > 0 || mStopped; });
+        worker.sleeping = false;
+
+        if (mStopped && worker.queue.read_available() == 0) {
+            return;
+        }
+    }
+}
+}
@@ -4,6 +4,14 @@ namespace inotify {
 
 NotifierBuilder::NotifierBuilder()
     : mInotify(std::make_shared<Inotify>())
+    , mObserverTables(1)
+    , mGroup(0)
+    , mObserverThreads(0)
+    , mQueueDepth(1024)
+    , mBackpressure(Backpressure::block)
+    , mEventTimeoutObserved(false)
+    , mObserverStatistics(false)
+    , mCounters(std::make_shared<DispatchCounters>())
 {
 }
 
@@ -14,22 +22,118 @@ NotifierBuilder BuildNotifier()
 
 auto NotifierBuilder::watchPathRecursively(boost::filesystem::path path) -> NotifierBuilder&
 {
+    assignGroup(path);
     mInotify->watchDirectoryRecursively(path);
     return *this;
 }
 
 auto NotifierBuilder::watchFile(boost::filesystem::path file) -> NotifierBuilder&
 {
+    assignGroup(file);
     mInotify->watchFile(file);
     return *this;
 }
 
+/**
+ * @brief Watches all files, a file that can not be watched does not
+ *        stop the others. Errors are returned per file in errors.
+ */
+auto NotifierBuilder::watchFiles(const std::vector<boost::filesystem::path>& files,
+    std::vector<boost::system::error_code>& errors) -> NotifierBuilder&
+{
+    for (const auto& file : files) {
+        assignGroup(file);
+    }
+    errors = mInotify->watchFiles(files);
+    return *this;
+}
+
+/**
+ * @brief Watches everything below path through one fanotify mark on
+ *        its filesystem instead of one inotify watch per directory.
+ *        Paths of the notifications are absolute. Needs
+ *        CAP_SYS_ADMIN.
+ */
+auto NotifierBuilder::watchFilesystem(boost::filesystem::path path) -> NotifierBuilder&
+{
+    mInotify->watchFilesystem(path);
+    return *this;
+}
+
+/**
+ * @brief Like watchFilesystem for the mount containing path, only
+ *        access, modify, open and close are reported
+ */
+auto NotifierBuilder::watchMount(boost::filesystem::path path) -> NotifierBuilder&
+{
+    mInotify->watchMount(path);
+    return *this;
+}
+
+/**
+ * @brief Watches the tree of path saved by saveWatchState, changes
+ *        made while it was not watched are notified as create and
+ *        remove events. Watches path recursively like
+ *        watchPathRecursively if there is no valid state of path.
+ */
+auto NotifierBuilder::restoreWatchState(
+    boost::filesystem::path stateFile, boost::filesystem::path path) -> NotifierBuilder&
+{
+    assignGroup(path);
+    if (!mInotify->restoreWatchState(stateFile, path)) {
+        mInotify->watchDirectoryRecursively(path);
+    }
+    return *this;
+}
+
+/**
+ * @brief Saves the recursively watched paths for a fast restart
+ *        through restoreWatchState
+ */
+auto NotifierBuilder::saveWatchState(boost::filesystem::path stateFile) -> void
+{
+    mInotify->saveWatchState(stateFile);
+}
+
+/**
+ * @brief Records the read events to a log for replayEvents, see
+ *        Inotify::recordEvents
+ */
+auto NotifierBuilder::recordEvents(boost::filesystem::path logFile) -> NotifierBuilder&
+{
+    mInotify->recordEvents(logFile);
+    return *this;
+}
+
+auto NotifierBuilder::stopRecording() -> void
+{
+    mInotify->stopRecording();
+}
+
+/**
+ * @brief Dispatches the events of a recorded log instead of the ones
+ *        of the kernel, run returns once all were dispatched. See
+ *        Inotify::replayEvents
+ */
+auto NotifierBuilder::replayEvents(boost::filesystem::path logFile, ReplaySpeed speed)
+    -> NotifierBuilder&
+{
+    mInotify->replayEvents(logFile, speed);
+    return *this;
+}
+
 auto NotifierBuilder::unwatchFile(boost::filesystem::path file) -> NotifierBuilder&
 {
     mInotify->unwatchFile(file);
     return *this;
 }
 
+auto NotifierBuilder::unwatchPathRecursively(boost::filesystem::path path) -> NotifierBuilder&
+{
+    mInotify->unwatchDirectoryRecursively(path);
+    return *this;
+}
+
 auto NotifierBuilder::ignoreFileOnce(boost::filesystem::path file) -> NotifierBuilder&
 {
     mInotify->ignoreFileOnce(file.string());
@@ -38,46 +142,273 @@ auto NotifierBuilder::ignoreFileOnce(boost::filesystem::path file) -> NotifierBu
 
 auto NotifierBuilder::ignoreFile(boost::filesystem::path file) -> NotifierBuilder&
 {
-    mInotify->ignoreFile(file.string());
+    mInotify->ignoreFile(file.string(), mGroup);
+    return *this;
+}
+
+auto NotifierBuilder::ignorePattern(const std::string& pattern) -> NotifierBuilder&
+{
+    mInotify->ignorePattern(pattern, mGroup);
     return *this;
 }
 
+/**
+ * @brief Switches to the watch group of the name, it is created on
+ *        first use. The following watch, ignore and observer calls
+ *        apply to the group until the next switch, the empty name is
+ *        the default group. Each group has its own event mask,
+ *        ignore rules and observers while all of them share one
+ *        inotify instance and reading thread. A group without
+ *        observers has the event mask and observers of the default
+ *        group, only its ignore rules are its own.
+ */
+auto NotifierBuilder::group(const std::string& name) -> NotifierBuilder&
+{
+    mGroup = name.empty() ? 0 : mInotify->addWatchGroup(name);
+    if (mGroup >= mObserverTables.size()) {
+        mObserverTables.resize(mGroup + 1);
+    }
+    return *this;
+}
+
+/**
+ * @brief Calls the observer for every event whose mask shares a bit
+ *        with event. If event contains is_dir, only directory events
+ *        are passed on. A later observer on the same event replaces
+ *        the earlier one.
+ *
+ *        Observers are stored once and never copied while events are
+ *        dispatched. A function pointer or std::ref to a callable is
+ *        stored in a std::function without heap allocation.
+ */
 auto NotifierBuilder::onEvent(Event event, EventObserver eventObserver) -> NotifierBuilder&
 {
-    mInotify->setEventMask(mInotify->getEventMask() | static_cast<std::uint32_t>(event));
-    mEventObserver[event] = eventObserver;
+    mEventObservers.push_back(std::move(eventObserver));
+    mCounters->observers.emplace_back();
+    addObserver(event, mEventObservers.size() - 1);
+    buildDispatchTable();
+    updateEventMask();
     return *this;
 }
 
 auto NotifierBuilder::onEvents(std::vector<Event> events, EventObserver eventObserver)
     -> NotifierBuilder&
 {
+    mEventObservers.push_back(std::move(eventObserver));
+    mCounters->observers.emplace_back();
     for (auto event : events) {
-        mInotify->setEventMask(mInotify->getEventMask() | static_cast<std::uint32_t>(event));
-        mEventObserver[event] = eventObserver;
+        addObserver(event, mEventObservers.size() - 1);
     }
 
+    buildDispatchTable();
+    updateEventMask();
     return *this;
 }
 
 auto NotifierBuilder::onUnexpectedEvent(EventObserver eventObserver) -> NotifierBuilder&
 {
-    mUnexpectedEventObserver = eventObserver;
+    mObserverTables[mGroup].unexpectedEventObserver = eventObserver;
+    updateEventMask();
     return *this;
 }
 
 auto NotifierBuilder::setEventTimeout(
     std::chrono::milliseconds timeout, EventObserver eventObserver) -> NotifierBuilder&
 {
-    auto onEventTimeout = [eventObserver](FileSystemEvent fileSystemEvent) {
+    auto onEventTimeout = [eventObserver](const FileSystemEvent& fileSystemEvent) {
 
         Notification notification;
         notification.path = fileSystemEvent.path;
+        notification.oldPath = fileSystemEvent.oldPath;
         notification.event = static_cast<Event>(fileSystemEvent.mask);
+        notification.group = fileSystemEvent.group;
         eventObserver(notification);
     };
 
     mInotify->setEventTimeout(timeout, onEventTimeout);
+    mEventTimeoutObserved = true;
+    updateEventMask();
+    return *this;
+}
+
+/**
+ * @brief Lets the kernel report only events for path and the paths
+ *        below it, e.g. close_write for a directory of large files
+ *        that are written often. Other events of these paths never
+ *        reach the observers, not even the unexpected one.
+ */
+auto NotifierBuilder::setEventMask(boost::filesystem::path path, Event events)
+    -> NotifierBuilder&
+{
+    mInotify->setEventMask(path, static_cast<std::uint32_t>(events) & IN_ALL_EVENTS);
+    return *this;
+}
+
+auto NotifierBuilder::setMaxEvents(std::size_t maxEvents) -> NotifierBuilder&
+{
+    mInotify->setMaxEvents(maxEvents);
+    return *this;
+}
+
+auto NotifierBuilder::setCrawlThreads(std::size_t threads) -> NotifierBuilder&
+{
+    mInotify->setCrawlThreads(threads);
+    return *this;
+}
+
+auto NotifierBuilder::setAutoRecursive(bool autoRecursive) -> NotifierBuilder&
+{
+    mInotify->setAutoRecursive(autoRecursive);
+    return *this;
+}
+
+auto NotifierBuilder::setRenamePairingWindow(std::chrono::milliseconds window)
+    -> NotifierBuilder&
+{
+    mInotify->setRenamePairingWindow(window);
+    return *this;
+}
+
+auto NotifierBuilder::setCoalescingPeriod(std::chrono::milliseconds quietPeriod)
+    -> NotifierBuilder&
+{
+    mInotify->setCoalescingPeriod(quietPeriod);
+    return *this;
+}
+
+/**
+ * @brief Drops modify and close_write events of files whose content
+ *        did not change, see Inotify::setContentCheck
+ */
+auto NotifierBuilder::setContentCheck(ContentCheck check, std::size_t threads)
+    -> NotifierBuilder&
+{
+    mInotify->setContentCheck(check, threads);
+    return *this;
+}
+
+/**
+ * @brief Bounds the queue of read events and sheds low priority
+ *        events under overload, see Inotify::setEventQueue
+ */
+auto NotifierBuilder::setEventQueue(std::size_t capacity, Shedding shedding) -> NotifierBuilder&
+{
+    mInotify->setEventQueue(capacity, shedding);
+    return *this;
+}
+
+auto NotifierBuilder::setOverflowRecovery(bool recovery) -> NotifierBuilder&
+{
+    mInotify->setOverflowRecovery(recovery);
+    return *this;
+}
+
+/**
+ * @brief See Inotify::setOverflowObserver
+ */
+auto NotifierBuilder::setOverflowObserver(std::function<void(const QueueOverflow&)> onOverflow)
+    -> NotifierBuilder&
+{
+    mInotify->setOverflowObserver(std::move(onOverflow));
+    return *this;
+}
+
+/**
+ * @brief Spreads the watches over several inotify instances, has
+ *        to be called before any path is watched
+ */
+auto NotifierBuilder::setInotifyInstances(std::size_t instances) -> NotifierBuilder&
+{
+    mInotify->setInotifyInstances(instances);
+    return *this;
+}
+
+/**
+ * @brief Lets run() call the observers on a pool of threads instead
+ *        of the reading thread, a slow observer does not delay the
+ *        reading then. Events of the same path are observed by the
+ *        same thread in order, observers of different paths may run
+ *        concurrently.
+ *
+ * @param threads zero calls the observers on the reading thread
+ * @param queueDepth events queued per thread
+ * @param backpressure whether reading waits for or drops events that
+ *        find the queue full
+ *
+ */
+auto NotifierBuilder::setObserverThreads(
+    std::size_t threads, std::size_t queueDepth, Backpressure backpressure) -> NotifierBuilder&
+{
+    if (threads && !queueDepth) {
+        throw std::invalid_argument("Queue depth has to be greater than zero");
+    }
+
+    mObserverThreads = threads;
+    mQueueDepth = queueDepth;
+    mBackpressure = backpressure;
+    return *this;
+}
+
+/**
+ * @return events dropped by the last run() due to full queues
+ */
+auto NotifierBuilder::getDroppedNotifications() const -> std::size_t
+{
+    return mExecutor ? mExecutor->getDroppedNotifications() : 0;
+}
+
+/**
+ * @brief Measures how long every call of an observer takes, costs two
+ *        clock reads per call. The unexpected event and batch
+ *        observers are not measured.
+ */
+auto NotifierBuilder::setObserverStatistics(bool enabled) -> NotifierBuilder&
+{
+    mObserverStatistics = enabled;
+    return *this;
+}
+
+/**
+ * @brief Counters of reading and dispatching, safe to call from any
+ *        thread while run() is active
+ */
+auto NotifierBuilder::getStatistics() const -> EventStatistics
+{
+    auto statistics = mInotify->getStatistics();
+    statistics.eventsDispatched = mCounters->dispatched.load(std::memory_order_relaxed);
+    return statistics;
+}
+
+/**
+ * @return call counts and durations per observer, in the order the
+ *         observers were registered. Empty counts unless
+ *         setObserverStatistics was enabled.
+ */
+auto NotifierBuilder::getObserverStatistics() const -> std::vector<ObserverStatistics>
+{
+    std::vector<ObserverStatistics> statistics;
+    for (std::size_t observer = 0; observer < mEventObservers.size(); ++observer) {
+        auto events = static_cast<Event>(0);
+        for (const auto& table : mObserverTables) {
+            for (const auto& registration : table.registrations) {
+                if (registration.observer == observer) {
+                    events = events | registration.event;
+                }
+            }
+        }
+        statistics.push_back(mCounters->observers[observer].snapshot(events));
+    }
+    return statistics;
+}
+
+/**
+ * @brief Passes every read batch to the observer instead of the event
+ *        observers, in run, runBatch and processReady
+ */
+auto NotifierBuilder::onEventBatch(EventBatchObserver eventBatchObserver) -> NotifierBuilder&
+{
+    mEventBatchObserver = eventBatchObserver;
+    updateEventMask();
     return *this;
 }
 
@@ -88,33 +419,262 @@ auto NotifierBuilder::runOnce() -> void
         return;
     }
 
-    Event event = static_cast<Event>(fileSystemEvent->mask);
-
     Notification notification;
-    notification.event = event;
-    notification.path = fileSystemEvent->path;
+    notification.event = static_cast<Event>(fileSystemEvent->mask);
+    notification.path = std::move(fileSystemEvent->path);
+    notification.oldPath = std::move(fileSystemEvent->oldPath);
+    notification.group = fileSystemEvent->group;
 
-    auto eventAndEventObserver = mEventObserver.find(event);
-    if (eventAndEventObserver == mEventObserver.end()) {
-        if (mUnexpectedEventObserver) {
-          mUnexpectedEventObserver(notification);
-        }
+    notify(notification);
+}
+
+/**
+ * @brief Waits for the next batch of events. The whole batch is
+ *        handed to the batch observer if one was set by
+ *        onEventBatch, otherwise every event of the batch
+ *        is dispatched to its event observer.
+ */
+auto NotifierBuilder::runBatch() -> void
+{
+    if (!mInotify->getNextEvents(mEventBatch)) {
+        return;
+    }
+
+    dispatchBatch();
+}
+
+/**
+ * @brief Dispatches the events that are ready without blocking, like
+ *        runBatch. Meant for external event loops polling
+ *        getFileDescriptor, see AsioNotifier.
+ *
+ * @return number of dispatched events
+ */
+auto NotifierBuilder::processReady() -> std::size_t
+{
+    if (!mInotify->tryGetEvents(mEventBatch)) {
+        return 0;
+    }
+
+    dispatchBatch();
+    return mNotificationBatch.size();
+}
 
+auto NotifierBuilder::dispatchBatch() -> void
+{
+    mNotificationBatch.resize(mEventBatch.size());
+    for (std::size_t i = 0; i < mEventBatch.size(); ++i) {
+        mNotificationBatch[i].event = static_cast<Event>(mEventBatch[i].mask);
+        // Swapped, the storage goes back to Inotify with the events
+        mNotificationBatch[i].path.swap(mEventBatch[i].path);
+        mNotificationBatch[i].oldPath.swap(mEventBatch[i].oldPath);
+        mNotificationBatch[i].group = mEventBatch[i].group;
+    }
+
+    if (mEventBatchObserver) {
+        mEventBatchObserver(mNotificationBatch);
         return;
     }
 
-    auto eventObserver = eventAndEventObserver->second;
-    eventObserver(notification);
+    for (const auto& notification : mNotificationBatch) {
+        notify(notification);
+    }
+}
+
+auto NotifierBuilder::addObserver(Event event, std::size_t observer) -> void
+{
+    for (auto& registration : mObserverTables[mGroup].registrations) {
+        if (registration.event == event) {
+            registration.observer = observer;
+            return;
+        }
+    }
+    mObserverTables[mGroup].registrations.push_back({ event, observer });
+}
+
+/**
+ * @brief Paths watched while a group is selected belong to it
+ */
+auto NotifierBuilder::assignGroup(const boost::filesystem::path& path) -> void
+{
+    if (mGroup != 0 || mInotify->getWatchGroup(path) != 0) {
+        mInotify->setWatchGroup(path, mGroup);
+    }
+}
+
+/**
+ * @brief Lets the kernel report only the events some observer of the
+ *        group is registered for. Observers that see every event need
+ *        all of them. Groups without observers keep their mask.
+ */
+auto NotifierBuilder::updateEventMask() -> void
+{
+    bool allEvents = mEventBatchObserver || mEventTimeoutObserved;
+    for (std::uint32_t group = 0; group < mObserverTables.size(); ++group) {
+        const auto& table = mObserverTables[group];
+        std::uint32_t eventMask = 0;
+        for (const auto& registration : table.registrations) {
+            // is_dir alone matches every directory event
+            eventMask |= registration.event == Event::is_dir
+                ? IN_ALL_EVENTS
+                : static_cast<std::uint32_t>(registration.event) & IN_ALL_EVENTS;
+        }
+
+        if (allEvents || table.unexpectedEventObserver) {
+            eventMask = IN_ALL_EVENTS;
+        } else if (table.registrations.empty()) {
+            continue;
+        }
+        mInotify->setGroupEventMask(group, eventMask);
+    }
+}
+
+/**
+ * @brief Lists for every mask bit the registrations of the group
+ *        containing it, thus dispatching an event only visits the
+ *        observers of the bits set in its mask
+ */
+auto NotifierBuilder::buildDispatchTable() -> void
+{
+    auto& table = mObserverTables[mGroup];
+    for (auto& registrations : table.dispatchTable) {
+        registrations.clear();
+    }
+    table.directoryRegistrations.clear();
+
+    for (std::size_t i = 0; i < table.registrations.size(); ++i) {
+        auto bits = static_cast<std::uint32_t>(table.registrations[i].event) & ~IN_ISDIR;
+        if (!bits) {
+            table.directoryRegistrations.push_back(i);
+        }
+
+        for (std::size_t bit = 0; bit < table.dispatchTable.size(); ++bit) {
+            if (bits & (1u << bit)) {
+                table.dispatchTable[bit].push_back(i);
+            }
+        }
+    }
+}
+
+auto NotifierBuilder::notify(const Notification& notification) -> void
+{
+    notify(notification, mDispatchState);
+}
+
+/**
+ * @brief Calls every observer registered on a bit of the event mask
+ *        once, or the unexpected event observer if there is none.
+ *        Every dispatching thread brings its own state.
+ */
+auto NotifierBuilder::notify(const Notification& notification, DispatchState& state) const -> void
+{
+    // Events of groups without observers of their own go to the default
+    // group, their watches have the mask of the default group as well
+    const auto* table = &mObserverTables[0];
+    if (notification.group < mObserverTables.size()) {
+        const auto& groupTable = mObserverTables[notification.group];
+        if (!groupTable.registrations.empty() || groupTable.unexpectedEventObserver) {
+            table = &groupTable;
+        }
+    }
+    auto mask = static_cast<std::uint32_t>(notification.event);
+    bool isDirectory = mask & IN_ISDIR;
+    bool notified = false;
+
+    // Observers registered on several bits of the mask are called once
+    state.called.resize(mEventObservers.size());
+    ++state.generation;
+    auto dispatch = [&](std::size_t index) {
+        const auto& registration = table->registrations[index];
+        if ((static_cast<std::uint32_t>(registration.event) & IN_ISDIR) && !isDirectory) {
+            return;
+        }
+        if (state.called[registration.observer] == state.generation) {
+            return;
+        }
+
+        state.called[registration.observer] = state.generation;
+        notified = true;
+        if (!mObserverStatistics) {
+            mEventObservers[registration.observer](notification);
+            return;
+        }
+
+        auto start = std::chrono::steady_clock::now();
+        mEventObservers[registration.observer](notification);
+        mCounters->observers[registration.observer].record(std::chrono::steady_clock::now() - start);
+    };
+
+    for (auto bits = mask & ~IN_ISDIR; bits; bits &= bits - 1) {
+        for (auto index : table->dispatchTable[__builtin_ctz(bits)]) {
+            dispatch(index);
+        }
+    }
+    if (isDirectory) {
+        for (auto index : table->directoryRegistrations) {
+            dispatch(index);
+        }
+    }
+
+    if (notified) {
+        mCounters->dispatched.fetch_add(1, std::memory_order_relaxed);
+    } else if (table->unexpectedEventObserver) {
+        table->unexpectedEventObserver(notification);
+    }
+}
+
+/**
+ * @brief Reads events on the calling thread and hands them to the
+ *        observer threads until stop() is called. Queued events are
+ *        still dispatched before it returns.
+ */
+auto NotifierBuilder::runExecutor() -> void
+{
+    auto states = std::make_shared<std::vector<DispatchState>>(mObserverThreads);
+    mExecutor = std::make_shared<NotificationExecutor>(mObserverThreads, mQueueDepth,
+        mBackpressure, [this, states](std::size_t worker, const Notification& notification) {
+            notify(notification, (*states)[worker]);
+        });
+
+    Notification notification;
+    while (!mInotify->hasStopped() && mInotify->getNextEvents(mEventBatch)) {
+        for (auto& event : mEventBatch) {
+            notification.event = static_cast<Event>(event.mask);
+            notification.path.swap(event.path);
+            notification.oldPath.swap(event.oldPath);
+            notification.group = event.group;
+            mExecutor->submit(notification);
+        }
+    }
+
+    mExecutor->stop();
 }
 
 auto NotifierBuilder::run() -> void
 {
-    while (true) {
-        if (mInotify->hasStopped()) {
-          break;
+    // A batch observer sees whole batches on the reading thread
+    if (mEventBatchObserver) {
+        while (!mInotify->hasStopped() && mInotify->getNextEvents(mEventBatch)) {
+            dispatchBatch();
         }
+        return;
+    }
+
+    if (mObserverThreads) {
+        runExecutor();
+        return;
+    }
 
-        runOnce();
+    // Batches recycle the storage of the events, runOnce can not
+    Notification notification;
+    while (!mInotify->hasStopped() && mInotify->getNextEvents(mEventBatch)) {
+        for (auto& event : mEventBatch) {
+            notification.event = static_cast<Event>(event.mask);
+            notification.path.swap(event.path);
+            notification.oldPath.swap(event.oldPath);
+            notification.group = event.group;
+            notify(notification);
+        }
     }
 }
 
@@ -122,4 +682,26 @@ auto NotifierBuilder::stop() -> void
 {
     mInotify->stop();
 }
+
+auto NotifierBuilder::hasStopped() -> bool
+{
+    return mInotify->hasStopped();
+}
+
+/**
+ * @brief Readable as soon as processReady has events to dispatch
+ */
+auto NotifierBuilder::getFileDescriptor() -> int
+{
+    return mInotify->getFileDescriptor();
+}
+
+/**
+ * @return milliseconds after which processReady has to be called
+ *         even if the fd did not become readable, -1 for never
+ */
+auto NotifierBuilder::getNextTimeout() -> int
+{
+    return mInotify->getNextTimeout();
+}
 }
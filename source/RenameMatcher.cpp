@@ -0,0 +1,91 @@
+#include <inotify-cpp/RenameMatcher.h>
+
+#include <sys/inotify.h>
+
+namespace inotify {
+
+RenameMatcher::RenameMatcher(std::chrono::milliseconds window)
+    : mWindow(window)
+{
+}
+
+/**
+ * @brief Sets the time a moved_from half waits for its moved_to
+ *        half. A window of zero disables the pairing.
+ */
+auto RenameMatcher::setWindow(std::chrono::milliseconds window) -> void
+{
+    mWindow = window;
+}
+
+auto RenameMatcher::enabled() const -> bool
+{
+    return mWindow.count() > 0;
+}
+
+auto RenameMatcher::process(
+    FileSystemEvent&& event, Clock::time_point now, std::vector<FileSystemEvent>& out) -> void
+{
+    if (event.mask & IN_MOVED_FROM) {
+        mDeadlines.push_back({ now + mWindow, event.cookie });
+        mMovedFrom.erase(event.cookie);
+        mMovedFrom.emplace(event.cookie, std::move(event));
+        return;
+    }
+
+    if (event.mask & IN_MOVED_TO) {
+        auto movedFrom = mMovedFrom.find(event.cookie);
+        if (movedFrom == mMovedFrom.end()) {
+            // Moved in from an unwatched directory
+            event.mask = (event.mask & ~IN_MOVED_TO) | IN_CREATE;
+        } else {
+            event.mask |= IN_MOVED_FROM;
+            event.oldPath = std::move(movedFrom->second.path);
+            mMovedFrom.erase(movedFrom);
+        }
+    }
+
+    out.push_back(std::move(event));
+}
+
+/**
+ * @brief Emits the moved_from halves whose window expired as remove
+ *        events
+ */
+auto RenameMatcher::flushExpired(Clock::time_point now, std::vector<FileSystemEvent>& out) -> void
+{
+    while (!mDeadlines.empty()) {
+        auto movedFrom = mMovedFrom.find(mDeadlines.front().cookie);
+        if (movedFrom != mMovedFrom.end() && mDeadlines.front().deadline > now) {
+            break;
+        }
+        mDeadlines.pop_front();
+
+        if (movedFrom != mMovedFrom.end()) {
+            // Moved out to an unwatched directory
+            movedFrom->second.mask = (movedFrom->second.mask & ~IN_MOVED_FROM) | IN_DELETE;
+            out.push_back(std::move(movedFrom->second));
+            mMovedFrom.erase(movedFrom);
+        }
+    }
+}
+
+/**
+ * @return time at which the oldest pending half expires
+ */
+auto RenameMatcher::nextDeadline() const -> boost::optional<Clock::time_point>
+{
+    // Deadlines of halves paired since the last flush are skipped
+    for (const auto& pending : mDeadlines) {
+        if (mMovedFrom.count(pending.cookie)) {
+            return pending.deadline;
+        }
+    }
+    return boost::none;
+}
+
+auto RenameMatcher::pending() const -> std::size_t
+{
+    return mMovedFrom.size();
+}
+}
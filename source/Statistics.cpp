@@ -0,0 +1,129 @@
+#include <inotify-cpp/Statistics.h>
+
+#include <algorithm>
+
+namespace inotify {
+
+namespace {
+    const auto relaxed = std::memory_order_relaxed;
+
+    void writeMetric(
+        std::ostream& stream, const char* name, const char* type, std::uint64_t value)
+    {
+        stream << "# TYPE inotify_cpp_" << name << " " << type << "\n"
+               << "inotify_cpp_" << name << " " << value << "\n";
+    }
+}
+
+constexpr std::size_t DurationHistogram::buckets;
+
+auto DurationHistogram::bucketOf(std::chrono::nanoseconds duration) -> std::size_t
+{
+    auto microseconds = static_cast<unsigned long long>(
+        std::max<std::chrono::nanoseconds::rep>(0, duration.count()) / 1000);
+    if (microseconds == 0) {
+        return 0;
+    }
+
+    // Bucket i holds [2^(i-1), 2^i) microseconds
+    auto bucket = static_cast<std::size_t>(64 - __builtin_clzll(microseconds));
+    return std::min(bucket, buckets - 1);
+}
+
+/**
+ * @return exclusive upper bound of the bucket, the last one has none
+ *         and returns the bound of the one before
+ */
+auto DurationHistogram::upperBound(std::size_t bucket) -> std::chrono::microseconds
+{
+    return std::chrono::microseconds(1ll << std::min(bucket, buckets - 2));
+}
+
+auto EventCounters::snapshot() const -> EventStatistics
+{
+    EventStatistics statistics {};
+    statistics.wakeups = wakeups.load(relaxed);
+    statistics.reads = reads.load(relaxed);
+    statistics.bytesRead = bytesRead.load(relaxed);
+    statistics.eventsParsed = eventsParsed.load(relaxed);
+    statistics.eventsIgnored = eventsIgnored.load(relaxed);
+    statistics.eventsTimedOut = eventsTimedOut.load(relaxed);
+    statistics.eventsUnchanged = eventsUnchanged.load(relaxed);
+    statistics.eventsReturned = eventsReturned.load(relaxed);
+    statistics.overflows = overflows.load(relaxed);
+    statistics.watches = watches.load(relaxed);
+    statistics.queuedEvents = queuedEvents.load(relaxed);
+    return statistics;
+}
+
+auto ObserverCounters::record(std::chrono::nanoseconds duration) -> void
+{
+    calls.fetch_add(1, relaxed);
+    totalNanoseconds.fetch_add(static_cast<std::uint64_t>(duration.count()), relaxed);
+    counts[DurationHistogram::bucketOf(duration)].fetch_add(1, relaxed);
+}
+
+auto ObserverCounters::snapshot(Event events) const -> ObserverStatistics
+{
+    ObserverStatistics statistics {};
+    statistics.events = events;
+    statistics.calls = calls.load(relaxed);
+    statistics.durations.total = std::chrono::nanoseconds(totalNanoseconds.load(relaxed));
+    for (std::size_t bucket = 0; bucket < DurationHistogram::buckets; ++bucket) {
+        statistics.durations.counts[bucket] = counts[bucket].load(relaxed);
+    }
+    return statistics;
+}
+
+/**
+ * @brief Writes the statistics in the Prometheus text format, e.g. to
+ *        serve them on a metrics endpoint
+ */
+auto writePrometheus(std::ostream& stream, const EventStatistics& statistics) -> void
+{
+    writeMetric(stream, "wakeups_total", "counter", statistics.wakeups);
+    writeMetric(stream, "reads_total", "counter", statistics.reads);
+    writeMetric(stream, "read_bytes_total", "counter", statistics.bytesRead);
+    writeMetric(stream, "events_parsed_total", "counter", statistics.eventsParsed);
+    writeMetric(stream, "events_ignored_total", "counter", statistics.eventsIgnored);
+    writeMetric(stream, "events_timed_out_total", "counter", statistics.eventsTimedOut);
+    writeMetric(stream, "events_unchanged_total", "counter", statistics.eventsUnchanged);
+    writeMetric(stream, "events_returned_total", "counter", statistics.eventsReturned);
+    writeMetric(stream, "events_shed_low_total", "counter", statistics.eventsShedLow);
+    writeMetric(stream, "events_shed_normal_total", "counter", statistics.eventsShedNormal);
+    writeMetric(stream, "events_collapsed_total", "counter", statistics.eventsCollapsed);
+    writeMetric(stream, "events_dispatched_total", "counter", statistics.eventsDispatched);
+    writeMetric(stream, "queue_overflows_total", "counter", statistics.overflows);
+    writeMetric(stream, "watches", "gauge", statistics.watches);
+    writeMetric(stream, "max_watches", "gauge", statistics.maxWatches);
+    writeMetric(stream, "queued_events", "gauge", statistics.queuedEvents);
+}
+
+/**
+ * @brief Writes the call durations of the observers as Prometheus
+ *        histograms, labeled with the index of the observer
+ */
+auto writePrometheus(std::ostream& stream, const std::vector<ObserverStatistics>& observers)
+    -> void
+{
+    const char* name = "inotify_cpp_observer_duration_seconds";
+    stream << "# TYPE " << name << " histogram\n";
+    for (std::size_t observer = 0; observer < observers.size(); ++observer) {
+        const auto& durations = observers[observer].durations;
+        std::uint64_t cumulative = 0;
+        for (std::size_t bucket = 0; bucket + 1 < DurationHistogram::buckets; ++bucket) {
+            cumulative += durations.counts[bucket];
+            stream << name << "_bucket{observer=\"" << observer << "\",le=\""
+                   << DurationHistogram::upperBound(bucket).count() / 1e6 << "\"} " << cumulative
+                   << "\n";
+        }
+        // Counted from the buckets, the snapshot is not taken atomically
+        cumulative += durations.counts[DurationHistogram::buckets - 1];
+        stream << name << "_bucket{observer=\"" << observer << "\",le=\"+Inf\"} " << cumulative
+               << "\n"
+               << name << "_sum{observer=\"" << observer << "\"} "
+               << std::chrono::duration<double>(durations.total).count() << "\n"
+               << name << "_count{observer=\"" << observer << "\"} " << cumulative << "\n";
+    }
+}
+}
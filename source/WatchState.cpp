@@ -0,0 +1,237 @@
+#include <inotify-cpp/WatchState.h>
+
+#include <fcntl.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace inotify {
+
+namespace {
+    const char magic[8] = { 'I', 'N', 'O', 'T', 'I', 'F', 'Y', 'S' };
+    const std::uint32_t version = 1;
+
+    struct Header {
+        char magic[8];
+        std::uint32_t version;
+        std::uint32_t roots;
+        std::uint64_t records;
+        std::uint64_t namesSize;
+    };
+
+    bool writeAll(int fd, const void* data, std::size_t size)
+    {
+        const char* bytes = static_cast<const char*>(data);
+        while (size > 0) {
+            ssize_t written = write(fd, bytes, size);
+            if (written == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return false;
+            }
+            bytes += written;
+            size -= static_cast<std::size_t>(written);
+        }
+        return true;
+    }
+}
+
+constexpr std::uint16_t WatchState::directory;
+constexpr std::uint16_t WatchState::watched;
+constexpr std::uint16_t WatchState::racy;
+
+WatchState::WatchState()
+    : mRoots(0)
+    , mMapping(nullptr)
+    , mMappingSize(0)
+    , mMappedRecords(nullptr)
+    , mMappedNames(nullptr)
+    , mMappedSize(0)
+    , mMappedNamesSize(0)
+{
+}
+
+WatchState::~WatchState()
+{
+    unmap();
+}
+
+/**
+ * @brief Appends a record, its times and children are filled in
+ *        through mutableRecord(index)
+ *
+ * @return index of the record
+ */
+auto WatchState::add(boost::string_ref name, std::uint16_t flags) -> std::uint32_t
+{
+    Record record {};
+    record.name = static_cast<std::uint32_t>(mNames.size());
+    record.nameLength = static_cast<std::uint16_t>(name.size());
+    record.flags = flags;
+    mNames.append(name.begin(), name.end());
+    mRecords.push_back(record);
+    return static_cast<std::uint32_t>(mRecords.size() - 1);
+}
+
+auto WatchState::mutableRecord(std::uint32_t index) -> Record&
+{
+    return mRecords[index];
+}
+
+auto WatchState::setRoots(std::uint32_t roots) -> void
+{
+    mRoots = roots;
+}
+
+/**
+ * @brief Writes the added records. The file is replaced atomically,
+ *        a crash while saving keeps the previous state.
+ *
+ * @return false if the file could not be written, errno is set
+ */
+auto WatchState::save(const boost::filesystem::path& file) const -> bool
+{
+    Header header {};
+    memcpy(header.magic, magic, sizeof(magic));
+    header.version = version;
+    header.roots = mRoots;
+    header.records = mRecords.size();
+    header.namesSize = mNames.size();
+
+    auto temporary = file.native() + ".tmp";
+    int fd = open(temporary.c_str(), O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd == -1) {
+        return false;
+    }
+
+    bool written = writeAll(fd, &header, sizeof(header))
+        && writeAll(fd, mRecords.data(), mRecords.size() * sizeof(Record))
+        && writeAll(fd, mNames.data(), mNames.size()) && fsync(fd) == 0;
+    int error = errno;
+    close(fd);
+    if (!written || rename(temporary.c_str(), file.c_str()) == -1) {
+        error = written ? errno : error;
+        unlink(temporary.c_str());
+        errno = error;
+        return false;
+    }
+    return true;
+}
+
+/**
+ * @brief Maps a saved state
+ *
+ * @return false if the file does not exist or is no valid state
+ */
+auto WatchState::load(const boost::filesystem::path& file) -> bool
+{
+    unmap();
+
+    int fd = open(file.c_str(), O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return false;
+    }
+
+    struct stat status;
+    if (fstat(fd, &status) == -1 || static_cast<std::size_t>(status.st_size) < sizeof(Header)) {
+        close(fd);
+        return false;
+    }
+
+    mMappingSize = static_cast<std::size_t>(status.st_size);
+    void* mapping = mmap(nullptr, mMappingSize, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if (mapping == MAP_FAILED) {
+        mMappingSize = 0;
+        return false;
+    }
+    mMapping = mapping;
+
+    if (!validate()) {
+        unmap();
+        return false;
+    }
+    return true;
+}
+
+auto WatchState::roots() const -> std::uint32_t
+{
+    return mMapping ? static_cast<const Header*>(mMapping)->roots : mRoots;
+}
+
+auto WatchState::size() const -> std::uint32_t
+{
+    return mMapping ? mMappedSize : static_cast<std::uint32_t>(mRecords.size());
+}
+
+auto WatchState::record(std::uint32_t index) const -> const Record&
+{
+    return mMapping ? mMappedRecords[index] : mRecords[index];
+}
+
+auto WatchState::name(const Record& record) const -> boost::string_ref
+{
+    const char* names = mMapping ? mMappedNames : mNames.data();
+    return boost::string_ref(names + record.name, record.nameLength);
+}
+
+/**
+ * @brief Checks the header and every reference of the records, a
+ *        truncated or foreign file is rejected instead of read out
+ *        of bounds. The children of every directory follow it and
+ *        the ranges of children do not overlap, thus the records
+ *        form a tree.
+ */
+auto WatchState::validate() -> bool
+{
+    const auto& header = *static_cast<const Header*>(mMapping);
+    if (memcmp(header.magic, magic, sizeof(magic)) || header.version != version
+        || header.records > UINT32_MAX || header.roots > header.records) {
+        return false;
+    }
+
+    auto recordsSize = header.records * sizeof(Record);
+    if (mMappingSize - sizeof(Header) < recordsSize
+        || mMappingSize - sizeof(Header) - recordsSize != header.namesSize) {
+        return false;
+    }
+
+    mMappedRecords = reinterpret_cast<const Record*>(
+        static_cast<const char*>(mMapping) + sizeof(Header));
+    mMappedNames = reinterpret_cast<const char*>(mMappedRecords + header.records);
+    mMappedSize = static_cast<std::uint32_t>(header.records);
+    mMappedNamesSize = header.namesSize;
+
+    // Directories were listed in the order of their records
+    std::uint64_t nextChild = header.roots;
+    for (std::uint32_t index = 0; index < mMappedSize; ++index) {
+        const auto& record = mMappedRecords[index];
+        if (static_cast<std::uint64_t>(record.name) + record.nameLength > mMappedNamesSize
+            || record.nameLength == 0) {
+            return false;
+        }
+        if (record.children) {
+            if (record.firstChild != nextChild || record.firstChild <= index) {
+                return false;
+            }
+            nextChild += record.children;
+        }
+    }
+    return nextChild == mMappedSize;
+}
+
+auto WatchState::unmap() -> void
+{
+    if (mMapping) {
+        munmap(const_cast<void*>(mMapping), mMappingSize);
+    }
+    mMapping = nullptr;
+    mMappingSize = 0;
+    mMappedRecords = nullptr;
+    mMappedNames = nullptr;
+    mMappedSize = 0;
+    mMappedNamesSize = 0;
+}
+}
@@ -0,0 +1,144 @@
+#include <inotify-cpp/NotifierBuilder.h>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <fcntl.h>
+#include <unistd.h>
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+using namespace inotify;
+
+namespace {
+std::atomic<std::size_t> allocations(0);
+}
+
+// Counts the allocations of the whole test binary
+void* operator new(std::size_t size)
+{
+    ++allocations;
+    if (void* memory = std::malloc(size ? size : 1)) {
+        return memory;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void* memory) noexcept
+{
+    std::free(memory);
+}
+
+void operator delete(void* memory, std::size_t) noexcept
+{
+    std::free(memory);
+}
+
+struct AllocationTests {
+    AllocationTests()
+        : testDirectory_("allocationTestDirectory")
+        , testFile_(testDirectory_ / "test.txt")
+    {
+        boost::filesystem::create_directories(testDirectory_);
+        boost::filesystem::ofstream stream(testFile_);
+    }
+    ~AllocationTests()
+    {
+        boost::filesystem::remove_all(testDirectory_);
+    }
+
+    // Causes an open and a close_nowrite event without allocating
+    void openTestFile()
+    {
+        close(open(testFile_.c_str(), O_RDONLY));
+    }
+
+    boost::filesystem::path testDirectory_;
+    boost::filesystem::path testFile_;
+};
+
+BOOST_FIXTURE_TEST_CASE(shouldNotAllocateEventsInSteadyState, AllocationTests)
+{
+    Inotify inotify;
+    inotify.setEventMask(IN_OPEN | IN_CLOSE_NOWRITE);
+    inotify.watchFile(testDirectory_);
+
+    std::vector<FileSystemEvent> events;
+    auto readEvents = [&]() {
+        openTestFile();
+        std::size_t read = 0;
+        while (read < 2) {
+            read += inotify.getNextEvents(events);
+        }
+    };
+
+    // Fills the spare events and the caches
+    for (int i = 0; i < 3; ++i) {
+        readEvents();
+    }
+
+    auto before = allocations.load();
+    for (int i = 0; i < 100; ++i) {
+        readEvents();
+    }
+    BOOST_CHECK_EQUAL(allocations.load() - before, 0u);
+    BOOST_CHECK(events.back().path == testFile_);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldNotAllocateCoalescedEventsInSteadyState, AllocationTests)
+{
+    Inotify inotify;
+    inotify.setEventMask(IN_OPEN | IN_CLOSE_NOWRITE);
+    inotify.setCoalescingPeriod(std::chrono::milliseconds(1));
+    inotify.watchFile(testDirectory_);
+
+    // Open and close_nowrite of a burst are merged into one event
+    std::vector<FileSystemEvent> events;
+    auto readEvents = [&]() {
+        openTestFile();
+        while (!inotify.getNextEvents(events)) {
+        }
+    };
+
+    for (int i = 0; i < 3; ++i) {
+        readEvents();
+    }
+
+    auto before = allocations.load();
+    for (int i = 0; i < 100; ++i) {
+        readEvents();
+    }
+    BOOST_CHECK_EQUAL(allocations.load() - before, 0u);
+    BOOST_CHECK(events.back().path == testFile_);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldNotAllocateNotificationsInSteadyState, AllocationTests)
+{
+    std::size_t notified = 0;
+    auto notifier = BuildNotifier()
+                        .watchPathRecursively(testDirectory_)
+                        .onEvents({ Event::open, Event::close_nowrite },
+                            [&](const Notification& notification) {
+                                notified += notification.path.native() == testFile_.native();
+                            });
+
+    auto dispatchEvents = [&]() {
+        openTestFile();
+        auto expected = notified + 2;
+        while (notified < expected) {
+            notifier.processReady();
+        }
+    };
+
+    for (int i = 0; i < 3; ++i) {
+        dispatchEvents();
+    }
+
+    auto before = allocations.load();
+    for (int i = 0; i < 100; ++i) {
+        dispatchEvents();
+    }
+    BOOST_CHECK_EQUAL(allocations.load() - before, 0u);
+}
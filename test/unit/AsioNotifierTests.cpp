@@ -0,0 +1,66 @@
+#include <inotify-cpp/AsioNotifier.h>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <poll.h>
+
+#include <chrono>
+#include <vector>
+
+using namespace inotify;
+
+struct AsioNotifierTests {
+    AsioNotifierTests()
+        : testDirectory_("asioTestDirectory")
+        , testFile_(testDirectory_ / "test.txt")
+    {
+        boost::filesystem::create_directories(testDirectory_);
+        boost::filesystem::ofstream stream(testFile_);
+    }
+    ~AsioNotifierTests()
+    {
+        boost::filesystem::remove_all(testDirectory_);
+    }
+
+    boost::filesystem::path testDirectory_;
+    boost::filesystem::path testFile_;
+};
+
+BOOST_FIXTURE_TEST_CASE(shouldProcessReadyEventsWithoutBlocking, AsioNotifierTests)
+{
+    std::vector<Notification> notifications;
+    auto notifier = BuildNotifier().watchFile(testFile_).onEvent(
+        Event::modify, [&](Notification notification) { notifications.push_back(notification); });
+
+    BOOST_CHECK_EQUAL(notifier.processReady(), 0u);
+    BOOST_CHECK_EQUAL(notifier.getNextTimeout(), -1);
+
+    boost::filesystem::ofstream(testFile_) << "x";
+    pollfd descriptor { notifier.getFileDescriptor(), POLLIN, 0 };
+    BOOST_REQUIRE_EQUAL(poll(&descriptor, 1, 1000), 1);
+
+    BOOST_CHECK(notifier.processReady() > 0);
+    BOOST_REQUIRE_EQUAL(notifications.size(), 1u);
+    BOOST_CHECK(notifications.front().path == testFile_);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldDispatchEventsOnIoContext, AsioNotifierTests)
+{
+    boost::asio::io_context context;
+    auto notifier = BuildNotifier().watchFile(testDirectory_).setCoalescingPeriod(
+        std::chrono::milliseconds(20));
+
+    bool notified = false;
+    notifier.onEvent(Event::close_write, [&](Notification notification) {
+        notified = notification.path == testFile_;
+        context.stop();
+    });
+
+    AsioNotifier adapter(context, notifier);
+    adapter.start();
+
+    boost::filesystem::ofstream(testFile_) << "x";
+    context.run_for(std::chrono::seconds(2));
+    BOOST_CHECK(notified);
+}
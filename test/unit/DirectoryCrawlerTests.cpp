@@ -0,0 +1,64 @@
+#include <inotify-cpp/DirectoryCrawler.h>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <set>
+#include <string>
+
+using namespace inotify;
+
+struct DirectoryCrawlerTests {
+    DirectoryCrawlerTests()
+        : root_("crawlerTestDirectory")
+    {
+        boost::filesystem::remove_all(root_);
+        for (int i = 0; i < 5; ++i) {
+            auto directory = root_ / ("dir" + std::to_string(i)) / "sub";
+            boost::filesystem::create_directories(directory);
+            boost::filesystem::ofstream(directory / "file.txt");
+            boost::filesystem::ofstream(directory.parent_path() / "file.txt");
+        }
+        boost::filesystem::create_directories(root_ / "build" / "obj");
+        boost::filesystem::create_symlink(boost::filesystem::absolute(root_), root_ / "loop");
+    }
+    ~DirectoryCrawlerTests()
+    {
+        boost::filesystem::remove_all(root_);
+    }
+
+    boost::filesystem::path root_;
+};
+
+BOOST_FIXTURE_TEST_CASE(shouldCrawlTreeWithAnyNumberOfThreads, DirectoryCrawlerTests)
+{
+    for (std::size_t threads : { 1, 4 }) {
+        std::set<std::string> paths;
+        auto statistics = DirectoryCrawler(threads).crawl(
+            root_, nullptr, [&](const boost::filesystem::path& path, EntryType) {
+                BOOST_CHECK(paths.insert(path.string()).second);
+            });
+
+        BOOST_CHECK_EQUAL(statistics.directories, 12u);
+        BOOST_CHECK_EQUAL(statistics.symlinks, 1u);
+        BOOST_CHECK_EQUAL(statistics.files, 10u);
+        BOOST_CHECK_EQUAL(statistics.errors, 0u);
+        BOOST_CHECK_EQUAL(paths.size(), 13u);
+        BOOST_CHECK(paths.count((root_ / "dir3" / "sub").string()));
+        BOOST_CHECK(paths.count((root_ / "loop").string()));
+    }
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldSkipIgnoredSubtrees, DirectoryCrawlerTests)
+{
+    std::set<std::string> paths;
+    auto statistics = DirectoryCrawler(2).setReportFiles(true).crawl(
+        root_,
+        [](boost::string_ref path) { return path.ends_with("build") || path.ends_with("loop"); },
+        [&](const boost::filesystem::path& path, EntryType) { paths.insert(path.string()); });
+
+    BOOST_CHECK_EQUAL(statistics.skipped, 2u);
+    BOOST_CHECK_EQUAL(statistics.directories, 10u);
+    BOOST_CHECK_EQUAL(paths.size(), 20u);
+    BOOST_CHECK(!paths.count((root_ / "build" / "obj").string()));
+}
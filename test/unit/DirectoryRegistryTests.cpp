@@ -0,0 +1,140 @@
+#include <inotify-cpp/DirectoryRegistry.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <stdexcept>
+
+using namespace inotify;
+
+BOOST_AUTO_TEST_CASE(shouldLookupPathsInBothDirections)
+{
+    DirectoryRegistry registry;
+    registry.insert(1, "/tmp/a");
+    registry.insert(7, "/tmp/a/b");
+
+    BOOST_CHECK_EQUAL(registry.size(), 2u);
+    BOOST_CHECK(registry.contains(7));
+    BOOST_CHECK(!registry.contains(3));
+    BOOST_CHECK(!registry.contains(-1));
+    BOOST_CHECK(registry.path(7) == "/tmp/a/b");
+    BOOST_CHECK_EQUAL(registry.find("/tmp/a"), 1);
+    BOOST_CHECK_EQUAL(registry.find("/tmp/c"), -1);
+    BOOST_CHECK_THROW(registry.path(3), std::out_of_range);
+}
+
+BOOST_AUTO_TEST_CASE(shouldEraseAndReassignWatchDescriptors)
+{
+    DirectoryRegistry registry;
+    registry.insert(1, "/tmp/a");
+    registry.insert(1, "/tmp/b");
+
+    BOOST_CHECK_EQUAL(registry.size(), 1u);
+    BOOST_CHECK_EQUAL(registry.find("/tmp/a"), -1);
+    BOOST_CHECK_EQUAL(registry.find("/tmp/b"), 1);
+
+    registry.erase(1);
+    BOOST_CHECK_EQUAL(registry.size(), 0u);
+    BOOST_CHECK(!registry.contains(1));
+    BOOST_CHECK_EQUAL(registry.find("/tmp/b"), -1);
+}
+
+BOOST_AUTO_TEST_CASE(shouldShareCommonPrefixesOfPaths)
+{
+    DirectoryRegistry registry;
+    registry.insert(1, "/tmp/a");
+    registry.insert(2, "/tmp/a/b");
+    registry.insert(3, "/tmp/a/c/");
+    registry.insert(4, "relative/a");
+    registry.insert(5, "/");
+
+    BOOST_CHECK(registry.path(1) == "/tmp/a");
+    BOOST_CHECK(registry.path(2) == "/tmp/a/b");
+    BOOST_CHECK_EQUAL(registry.path(3).native(), "/tmp/a/c/");
+    BOOST_CHECK(registry.path(4) == "relative/a");
+    BOOST_CHECK_EQUAL(registry.path(5).native(), "/");
+    BOOST_CHECK_EQUAL(registry.find("/tmp"), -1);
+    BOOST_CHECK_EQUAL(registry.find("/tmp/a/c"), -1);
+    BOOST_CHECK_EQUAL(registry.find("/tmp/a/c/"), 3);
+
+    // Erasing the parent keeps the components needed by its children
+    registry.erase(1);
+    BOOST_CHECK(registry.path(2) == "/tmp/a/b");
+    BOOST_CHECK_EQUAL(registry.find("/tmp/a"), -1);
+    BOOST_CHECK_EQUAL(registry.find("/tmp/a/b"), 2);
+}
+
+BOOST_AUTO_TEST_CASE(shouldHandleManyInsertionsAndErasures)
+{
+    DirectoryRegistry registry;
+    for (int wd = 1; wd <= 2000; ++wd) {
+        registry.insert(wd, "/root/dir" + std::to_string(wd % 50) + "/sub" + std::to_string(wd));
+    }
+    for (int wd = 1; wd <= 2000; wd += 2) {
+        registry.erase(wd);
+    }
+
+    BOOST_CHECK_EQUAL(registry.size(), 1000u);
+    for (int wd = 2; wd <= 2000; wd += 2) {
+        auto path = "/root/dir" + std::to_string(wd % 50) + "/sub" + std::to_string(wd);
+        BOOST_CHECK_EQUAL(registry.find(path), wd);
+        BOOST_CHECK_EQUAL(registry.path(wd).native(), path);
+        BOOST_CHECK_EQUAL(registry.find(path + "x"), -1);
+    }
+    BOOST_CHECK_EQUAL(registry.find("/root/dir1/sub1"), -1);
+}
+
+BOOST_AUTO_TEST_CASE(shouldRenameSubtreesInPlace)
+{
+    DirectoryRegistry registry;
+    registry.insert(1, "/tmp/a/b");
+    registry.insert(2, "/tmp/a/b/c");
+    registry.insert(3, "/tmp/x/old");
+
+    BOOST_CHECK(registry.rename("/tmp/a/b", "/tmp/x/y"));
+    BOOST_CHECK(registry.path(1) == "/tmp/x/y");
+    BOOST_CHECK(registry.path(2) == "/tmp/x/y/c");
+    BOOST_CHECK_EQUAL(registry.find("/tmp/a/b/c"), -1);
+    BOOST_CHECK_EQUAL(registry.find("/tmp/x/y/c"), 2);
+
+    // A registered target is replaced
+    BOOST_CHECK(registry.rename("/tmp/x/y", "/tmp/x/old"));
+    BOOST_CHECK(!registry.contains(3));
+    BOOST_CHECK_EQUAL(registry.find("/tmp/x/old/c"), 2);
+    BOOST_CHECK_EQUAL(registry.size(), 2u);
+
+    BOOST_CHECK(!registry.rename("/tmp/a/b", "/tmp/z"));
+    BOOST_CHECK_EQUAL(registry.subtree("/tmp/x").size(), 2u);
+}
+
+BOOST_AUTO_TEST_CASE(shouldKeepReturnedPathsOfCollidingLookups)
+{
+    DirectoryRegistry registry;
+    registry.insert(1, "/tmp/a");
+    registry.insert(1025, "/tmp/b");
+
+    // Both watch descriptors share a slot of the path cache
+    const auto& first = registry.path(1);
+    boost::filesystem::path second;
+    registry.assignPath(1025, second);
+    BOOST_CHECK(first == "/tmp/a");
+    BOOST_CHECK(second == "/tmp/b");
+}
+
+BOOST_AUTO_TEST_CASE(shouldCountWatchesMarkedAsRemoved)
+{
+    DirectoryRegistry registry;
+    registry.insert(1, "/tmp/a", DirectoryRegistry::recursive);
+    registry.insert(2, "/tmp/a/b", DirectoryRegistry::recursive);
+
+    registry.setFlags(1, DirectoryRegistry::removed);
+    registry.setFlags(2, DirectoryRegistry::removed);
+    BOOST_CHECK_EQUAL(registry.size(), 2u);
+    BOOST_CHECK_EQUAL(registry.removedSize(), 2u);
+    BOOST_CHECK(registry.path(1) == "/tmp/a");
+
+    // Watched again under a new watch descriptor
+    registry.insert(3, "/tmp/a/b");
+    registry.erase(1);
+    BOOST_CHECK_EQUAL(registry.size(), 1u);
+    BOOST_CHECK_EQUAL(registry.removedSize(), 0u);
+}
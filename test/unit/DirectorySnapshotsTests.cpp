@@ -0,0 +1,79 @@
+#include <inotify-cpp/DirectorySnapshots.h>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <sys/inotify.h>
+
+#include <map>
+#include <string>
+
+using namespace inotify;
+
+struct DirectorySnapshotsTests {
+    DirectorySnapshotsTests()
+        : testDirectory_("snapshotTestDirectory")
+    {
+        boost::filesystem::create_directories(testDirectory_ / "sub");
+        boost::filesystem::ofstream(testDirectory_ / "kept.txt") << "kept";
+        boost::filesystem::ofstream(testDirectory_ / "modified.txt") << "old";
+        boost::filesystem::ofstream(testDirectory_ / "removed.txt");
+    }
+    ~DirectorySnapshotsTests()
+    {
+        boost::filesystem::remove_all(testDirectory_);
+    }
+
+    std::map<std::string, std::uint32_t> rescan(DirectorySnapshots& snapshots, int wd)
+    {
+        std::map<std::string, std::uint32_t> changes;
+        BOOST_CHECK(snapshots.rescan(wd, testDirectory_,
+            [&](std::uint32_t mask, const std::string& name) { changes[name] |= mask; }));
+        return changes;
+    }
+
+    boost::filesystem::path testDirectory_;
+};
+
+BOOST_FIXTURE_TEST_CASE(shouldReportDifferencesToSnapshot, DirectorySnapshotsTests)
+{
+    DirectorySnapshots snapshots;
+    BOOST_REQUIRE(snapshots.take(1, testDirectory_));
+    BOOST_CHECK(rescan(snapshots, 1).empty());
+
+    boost::filesystem::ofstream(testDirectory_ / "modified.txt") << "changed";
+    boost::filesystem::remove(testDirectory_ / "removed.txt");
+    boost::filesystem::create_directory(testDirectory_ / "created");
+
+    auto changes = rescan(snapshots, 1);
+    BOOST_CHECK_EQUAL(changes.size(), 3u);
+    BOOST_CHECK_EQUAL(changes["modified.txt"], static_cast<uint32_t>(IN_MODIFY));
+    BOOST_CHECK_EQUAL(changes["removed.txt"], static_cast<uint32_t>(IN_DELETE));
+    BOOST_CHECK_EQUAL(changes["created"], static_cast<uint32_t>(IN_CREATE | IN_ISDIR));
+
+    // The snapshot holds the current state now
+    BOOST_CHECK(rescan(snapshots, 1).empty());
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldApplyEventsToSnapshot, DirectorySnapshotsTests)
+{
+    DirectorySnapshots snapshots;
+    BOOST_REQUIRE(snapshots.take(1, testDirectory_));
+
+    // Reported by events before events were lost
+    boost::filesystem::remove(testDirectory_ / "removed.txt");
+    snapshots.update(1, IN_DELETE, "removed.txt");
+    boost::filesystem::ofstream(testDirectory_ / "created.txt");
+    snapshots.update(1, IN_CREATE, "created.txt");
+    snapshots.update(1, IN_CLOSE_WRITE, "kept.txt");
+
+    // Touched entries might have changed again, they are reported once more
+    auto changes = rescan(snapshots, 1);
+    BOOST_CHECK_EQUAL(changes.size(), 2u);
+    BOOST_CHECK_EQUAL(changes["created.txt"], static_cast<uint32_t>(IN_MODIFY));
+    BOOST_CHECK_EQUAL(changes["kept.txt"], static_cast<uint32_t>(IN_MODIFY));
+
+    boost::filesystem::remove_all(testDirectory_);
+    BOOST_CHECK(!snapshots.rescan(1, testDirectory_, [](std::uint32_t, const std::string&) {}));
+    BOOST_CHECK(!snapshots.contains(1));
+}
@@ -0,0 +1,107 @@
+#include <inotify-cpp/EventCoalescer.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <sys/inotify.h>
+
+#include <chrono>
+#include <string>
+#include <vector>
+
+using namespace inotify;
+using namespace std::chrono;
+
+BOOST_AUTO_TEST_CASE(shouldMergeBurstsUntilPathIsQuiet)
+{
+    EventCoalescer coalescer(milliseconds(100));
+    auto start = EventCoalescer::Clock::now();
+    std::vector<FileSystemEvent> events;
+
+    coalescer.process(FileSystemEvent(1, IN_MODIFY, "a.txt"), start, events);
+    coalescer.process(FileSystemEvent(1, IN_ATTRIB, "a.txt"), start + milliseconds(80), events);
+    coalescer.process(FileSystemEvent(1, IN_MODIFY, "b.txt"), start + milliseconds(80), events);
+    BOOST_CHECK_EQUAL(coalescer.pending(), 2u);
+
+    // The second event restarted the quiet period of a.txt
+    coalescer.flushExpired(start + milliseconds(150), events);
+    BOOST_CHECK(events.empty());
+    BOOST_REQUIRE(coalescer.nextDeadline());
+    BOOST_CHECK(*coalescer.nextDeadline() >= start + milliseconds(180));
+
+    coalescer.flushExpired(start + milliseconds(200), events);
+    BOOST_REQUIRE_EQUAL(events.size(), 2u);
+    BOOST_CHECK_EQUAL(events[0].path, "a.txt");
+    BOOST_CHECK_EQUAL(events[0].mask, static_cast<uint32_t>(IN_MODIFY | IN_ATTRIB));
+    BOOST_CHECK_EQUAL(events[1].path, "b.txt");
+    BOOST_CHECK_EQUAL(coalescer.pending(), 0u);
+    BOOST_CHECK(!coalescer.nextDeadline());
+}
+
+BOOST_AUTO_TEST_CASE(shouldFlushOnCloseWriteAndPassMoves)
+{
+    EventCoalescer coalescer(milliseconds(100));
+    auto now = EventCoalescer::Clock::now();
+    std::vector<FileSystemEvent> events;
+
+    coalescer.process(FileSystemEvent(1, IN_MODIFY, "a.txt"), now, events);
+    coalescer.process(FileSystemEvent(1, IN_MODIFY, "a.txt"), now, events);
+    coalescer.process(FileSystemEvent(1, IN_CLOSE_WRITE, "a.txt"), now, events);
+    BOOST_REQUIRE_EQUAL(events.size(), 1u);
+    BOOST_CHECK_EQUAL(events[0].mask, static_cast<uint32_t>(IN_MODIFY | IN_CLOSE_WRITE));
+
+    // Same name on another watch is another key
+    coalescer.process(FileSystemEvent(1, IN_MODIFY, "b.txt"), now, events);
+    coalescer.process(FileSystemEvent(2, IN_MODIFY, "b.txt"), now, events);
+    coalescer.process(FileSystemEvent(1, IN_MOVED_FROM, "b.txt"), now, events);
+    BOOST_REQUIRE_EQUAL(events.size(), 3u);
+    BOOST_CHECK_EQUAL(events[1].mask, static_cast<uint32_t>(IN_MODIFY));
+    BOOST_CHECK_EQUAL(events[2].mask, static_cast<uint32_t>(IN_MOVED_FROM));
+    BOOST_CHECK_EQUAL(coalescer.pending(), 1u);
+
+    coalescer.flushAll(events);
+    BOOST_REQUIRE_EQUAL(events.size(), 4u);
+    BOOST_CHECK_EQUAL(events[3].wd, 2);
+}
+
+BOOST_AUTO_TEST_CASE(shouldExpireManyPendingPaths)
+{
+    EventCoalescer coalescer(milliseconds(10));
+    auto start = EventCoalescer::Clock::now();
+    std::vector<FileSystemEvent> events;
+
+    const int paths = 20000;
+    for (int i = 0; i < paths; ++i) {
+        coalescer.process(
+            FileSystemEvent(1, IN_MODIFY, std::to_string(i)), start + microseconds(i), events);
+    }
+    BOOST_CHECK_EQUAL(coalescer.pending(), static_cast<std::size_t>(paths));
+
+    // Far beyond one turn of the wheel
+    coalescer.flushExpired(start + seconds(10), events);
+    BOOST_CHECK_EQUAL(events.size(), static_cast<std::size_t>(paths));
+    BOOST_CHECK_EQUAL(events.front().path, "0");
+    BOOST_CHECK_EQUAL(coalescer.pending(), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(shouldLeaveMergedEventsToTheCaller)
+{
+    EventCoalescer coalescer(milliseconds(100));
+    auto now = EventCoalescer::Clock::now();
+    std::vector<FileSystemEvent> events;
+
+    BOOST_CHECK(coalescer.process(FileSystemEvent(1, IN_MODIFY, "a.txt"), now, events));
+    BOOST_CHECK(coalescer.process(FileSystemEvent(2, IN_MODIFY, "a.txt"), now, events));
+    FileSystemEvent merged(1, IN_ATTRIB, "a.txt");
+    BOOST_CHECK(!coalescer.process(std::move(merged), now, events));
+    BOOST_CHECK_EQUAL(merged.path, "a.txt");
+    BOOST_CHECK_EQUAL(coalescer.pending(), 2u);
+
+    // Keys of other watches stay pending when one is flushed
+    BOOST_CHECK(!coalescer.process(FileSystemEvent(1, IN_CLOSE_WRITE, "a.txt"), now, events));
+    BOOST_REQUIRE_EQUAL(events.size(), 1u);
+    BOOST_CHECK_EQUAL(events[0].wd, 1);
+    BOOST_CHECK_EQUAL(events[0].mask, static_cast<uint32_t>(IN_MODIFY | IN_ATTRIB | IN_CLOSE_WRITE));
+    BOOST_CHECK_EQUAL(coalescer.pending(), 1u);
+    BOOST_CHECK(coalescer.process(FileSystemEvent(1, IN_MODIFY, "a.txt"), now, events));
+    BOOST_CHECK_EQUAL(coalescer.pending(), 2u);
+}
@@ -0,0 +1,99 @@
+#include <inotify-cpp/EventLog.h>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <sys/inotify.h>
+
+#include <cstring>
+#include <string>
+#include <vector>
+
+using namespace inotify;
+
+struct EventLogTests {
+    EventLogTests()
+        : logFile_("eventLogTest.bin")
+    {
+    }
+    ~EventLogTests()
+    {
+        boost::filesystem::remove(logFile_);
+    }
+
+    /**
+     * @brief Appends an event like the kernel, the name is padded
+     */
+    static void appendEvent(
+        std::vector<char>& buffer, int wd, uint32_t mask, const std::string& name)
+    {
+        inotify_event event {};
+        event.wd = wd;
+        event.mask = mask;
+        event.len = static_cast<uint32_t>(
+            (name.size() + sizeof(event)) / sizeof(event) * sizeof(event));
+        auto offset = buffer.size();
+        buffer.resize(offset + sizeof(event) + event.len);
+        std::memcpy(&buffer[offset], &event, sizeof(event));
+        std::memcpy(&buffer[offset + sizeof(event)], name.data(), name.size());
+    }
+
+    boost::filesystem::path logFile_;
+};
+
+BOOST_FIXTURE_TEST_CASE(shouldReadBackRecordedLog, EventLogTests)
+{
+    std::vector<char> events;
+    appendEvent(events, 1, IN_CREATE, "a.txt");
+    appendEvent(events, 1, IN_CLOSE_WRITE, "a.txt");
+    {
+        EventLogWriter writer;
+        BOOST_REQUIRE(writer.open(logFile_));
+        writer.watch(1, 1, "/watched/root");
+        writer.events(events.data(), events.size());
+        writer.remove(1);
+        BOOST_REQUIRE(writer.close());
+    }
+
+    EventLogReader reader;
+    BOOST_REQUIRE(reader.load(logFile_));
+    const auto& records = reader.records();
+    BOOST_REQUIRE_EQUAL(records.size(), 3u);
+    BOOST_CHECK(records[0].type == EventLogRecord::watch);
+    BOOST_CHECK_EQUAL(records[0].wd, 1);
+    BOOST_CHECK_EQUAL(records[0].flags, 1u);
+    BOOST_CHECK_EQUAL(records[0].path, "/watched/root");
+    BOOST_CHECK(records[1].type == EventLogRecord::events);
+    BOOST_REQUIRE_EQUAL(records[1].length, events.size());
+    BOOST_CHECK(!std::memcmp(records[1].buffer, events.data(), events.size()));
+    BOOST_CHECK(records[2].type == EventLogRecord::remove);
+    BOOST_CHECK(records[0].time <= records[1].time && records[1].time <= records[2].time);
+
+    // Replayed in place, the events are aligned
+    auto address = reinterpret_cast<std::uintptr_t>(records[1].buffer);
+    BOOST_CHECK_EQUAL(address % alignof(inotify_event), 0u);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldRejectInvalidLogs, EventLogTests)
+{
+    EventLogReader reader;
+    BOOST_CHECK(!reader.load(logFile_));
+
+    boost::filesystem::ofstream(logFile_) << "no event log";
+    BOOST_CHECK(!reader.load(logFile_));
+
+    std::vector<char> events;
+    appendEvent(events, 1, IN_MODIFY, "a.txt");
+    {
+        EventLogWriter writer;
+        BOOST_REQUIRE(writer.open(logFile_));
+        writer.events(events.data(), events.size());
+        BOOST_REQUIRE(writer.close());
+    }
+    BOOST_CHECK(reader.load(logFile_));
+
+    // The last event does not end in its buffer anymore
+    boost::filesystem::resize_file(logFile_, boost::filesystem::file_size(logFile_) - 8);
+    BOOST_CHECK(!reader.load(logFile_));
+    BOOST_CHECK(reader.records().empty());
+}
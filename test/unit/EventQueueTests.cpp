@@ -0,0 +1,87 @@
+#include <inotify-cpp/EventQueue.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <sys/inotify.h>
+
+#include <string>
+
+using namespace inotify;
+
+BOOST_AUTO_TEST_CASE(shouldKeepReadOrderWithoutShedding)
+{
+    EventQueue queue;
+    queue.push(FileSystemEvent(1, IN_ACCESS, "a.txt"));
+    queue.push(FileSystemEvent(1, IN_DELETE_SELF, "b.txt"));
+
+    BOOST_CHECK(!queue.bounded());
+    BOOST_CHECK_EQUAL(queue.pop().path, "a.txt");
+    BOOST_CHECK_EQUAL(queue.pop().path, "b.txt");
+    BOOST_CHECK(queue.empty());
+}
+
+BOOST_AUTO_TEST_CASE(shouldReturnCriticalEventsFirst)
+{
+    EventQueue queue(8, Shedding::drop);
+    queue.push(FileSystemEvent(1, IN_ACCESS, "a.txt"));
+    queue.push(FileSystemEvent(1, IN_CREATE, "b.txt"));
+    queue.push(FileSystemEvent(1, IN_DELETE_SELF, "c.txt"));
+    queue.push(FileSystemEvent(1, IN_MODIFY, "d.txt"));
+
+    BOOST_CHECK(EventQueue::priorityOf(IN_UNMOUNT) == EventPriority::critical);
+    BOOST_CHECK(EventQueue::priorityOf(IN_OPEN | IN_ISDIR) == EventPriority::low);
+    BOOST_CHECK(EventQueue::priorityOf(IN_OPEN | IN_MODIFY) == EventPriority::normal);
+    BOOST_CHECK_EQUAL(queue.pop().path, "c.txt");
+    BOOST_CHECK_EQUAL(queue.pop().path, "b.txt");
+    BOOST_CHECK_EQUAL(queue.pop().path, "d.txt");
+    BOOST_CHECK_EQUAL(queue.pop().path, "a.txt");
+}
+
+BOOST_AUTO_TEST_CASE(shouldShedLowEventsFirst)
+{
+    EventQueue queue(2, Shedding::drop);
+    queue.push(FileSystemEvent(1, IN_ACCESS, "a.txt"));
+    queue.push(FileSystemEvent(1, IN_ACCESS, "b.txt"));
+    // Evicts the oldest low event
+    queue.push(FileSystemEvent(1, IN_CREATE, "c.txt"));
+    // Dropped, no event is less important
+    queue.push(FileSystemEvent(1, IN_OPEN, "d.txt"));
+    queue.push(FileSystemEvent(1, IN_CREATE, "e.txt"));
+    queue.push(FileSystemEvent(1, IN_CREATE, "f.txt"));
+    // Evicts the oldest normal event
+    queue.push(FileSystemEvent(1, IN_IGNORED, "g.txt"));
+
+    BOOST_CHECK_EQUAL(queue.getShedEvents(EventPriority::low), 3u);
+    BOOST_CHECK_EQUAL(queue.getShedEvents(EventPriority::normal), 2u);
+    BOOST_CHECK_EQUAL(queue.pop().path, "g.txt");
+    BOOST_CHECK_EQUAL(queue.pop().path, "e.txt");
+
+    // Critical events are never shed
+    for (int i = 0; i < 3; ++i) {
+        queue.push(FileSystemEvent(1, IN_UNMOUNT, "h.txt"));
+    }
+    BOOST_CHECK_EQUAL(queue.size(), 3u);
+    BOOST_CHECK_EQUAL(queue.getShedEvents(EventPriority::critical), 0u);
+}
+
+BOOST_AUTO_TEST_CASE(shouldCollapseLowEventsOnTheSamePath)
+{
+    EventQueue queue(2, Shedding::collapse);
+    queue.push(FileSystemEvent(1, IN_OPEN, "a.txt"));
+    queue.push(FileSystemEvent(1, IN_OPEN, "b.txt"));
+    queue.push(FileSystemEvent(1, IN_CLOSE_NOWRITE, "a.txt"));
+    queue.push(FileSystemEvent(1, IN_ACCESS, "a.txt"));
+
+    BOOST_CHECK_EQUAL(queue.size(), 2u);
+    BOOST_CHECK_EQUAL(queue.getCollapsedEvents(), 2u);
+    auto event = queue.pop();
+    BOOST_CHECK_EQUAL(event.path, "a.txt");
+    BOOST_CHECK_EQUAL(event.mask, static_cast<uint32_t>(IN_OPEN | IN_CLOSE_NOWRITE | IN_ACCESS));
+
+    // a.txt is not queued anymore, the new event is shed instead
+    queue.push(FileSystemEvent(1, IN_OPEN, "c.txt"));
+    queue.push(FileSystemEvent(1, IN_OPEN, "a.txt"));
+    BOOST_CHECK_EQUAL(queue.getShedEvents(EventPriority::low), 1u);
+    BOOST_CHECK_EQUAL(queue.pop().path, "b.txt");
+    BOOST_CHECK_EQUAL(queue.pop().path, "c.txt");
+}
@@ -0,0 +1,97 @@
+#include <inotify-cpp/IgnoreMatcher.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <random>
+#include <string>
+#include <vector>
+
+using namespace inotify;
+
+BOOST_AUTO_TEST_CASE(shouldMatchSubstringRules)
+{
+    IgnoreMatcher matcher;
+    BOOST_CHECK(!matcher.matches("/home/user/project/main.cpp"));
+
+    matcher.ignore(".git");
+    matcher.ignore("build/");
+
+    BOOST_CHECK(matcher.matches("/home/user/project/.git/HEAD"));
+    BOOST_CHECK(matcher.matches("/home/user/project/build/main.o"));
+    BOOST_CHECK(!matcher.matches("/home/user/project/main.cpp"));
+    BOOST_CHECK(!matcher.matches("/home/user/project/build"));
+}
+
+BOOST_AUTO_TEST_CASE(shouldMatchLikeNaiveSubstringSearch)
+{
+    std::mt19937 random(42);
+    auto randomString = [&random](std::size_t maxLength) {
+        std::uniform_int_distribution<std::size_t> length(1, maxLength);
+        std::uniform_int_distribution<int> character('a', 'd');
+        std::string string(length(random), 'a');
+        for (auto& c : string) {
+            c = static_cast<char>(character(random));
+        }
+        return string;
+    };
+
+    for (int round = 0; round < 50; ++round) {
+        IgnoreMatcher matcher;
+        std::vector<std::string> rules;
+        for (int i = 0; i < 8; ++i) {
+            rules.push_back(randomString(4));
+            matcher.ignore(rules.back());
+        }
+
+        for (int i = 0; i < 50; ++i) {
+            auto path = randomString(12);
+            bool expected = false;
+            for (const auto& rule : rules) {
+                expected |= path.find(rule) != std::string::npos;
+            }
+            BOOST_CHECK_EQUAL(matcher.matches(path), expected);
+        }
+    }
+}
+
+BOOST_AUTO_TEST_CASE(shouldRemoveOnceRulesAfterFirstMatch)
+{
+    IgnoreMatcher matcher;
+    matcher.ignoreOnce("test.txt");
+    matcher.ignore("other.txt");
+
+    BOOST_CHECK(matcher.matches("/tmp/test.txt"));
+    BOOST_CHECK(!matcher.matches("/tmp/test.txt"));
+    BOOST_CHECK(matcher.matches("/tmp/other.txt"));
+    BOOST_CHECK(matcher.matches("/tmp/other.txt"));
+}
+
+BOOST_AUTO_TEST_CASE(shouldMatchDirectoryAndNameWithoutJoining)
+{
+    IgnoreMatcher matcher;
+    matcher.ignore("dir/file");
+
+    BOOST_CHECK(matcher.matches(boost::filesystem::path("/tmp/dir"), "file"));
+    BOOST_CHECK(matcher.matches(boost::filesystem::path("/tmp/dir/"), "file"));
+    BOOST_CHECK(!matcher.matches(boost::filesystem::path("/tmp/dir"), "other"));
+    BOOST_CHECK(matcher.matches(boost::filesystem::path("/tmp/dir/file"), ""));
+}
+
+BOOST_AUTO_TEST_CASE(shouldMatchGlobPatternsAgainstFileName)
+{
+    IgnoreMatcher matcher;
+    matcher.ignorePattern("*.sw[a-p]");
+    matcher.ignorePattern("4913");
+
+    BOOST_CHECK(matcher.matches("/src/.main.cpp.swp"));
+    BOOST_CHECK(matcher.matches(boost::filesystem::path("/src"), ".main.cpp.swo"));
+    BOOST_CHECK(matcher.matches(boost::filesystem::path("/src/4913"), ""));
+    BOOST_CHECK(!matcher.matches("/src/main.cpp.swx"));
+    BOOST_CHECK(!matcher.matches("/4913/main.cpp"));
+
+    BOOST_CHECK(IgnoreMatcher::globMatch("a?c", "abc"));
+    BOOST_CHECK(IgnoreMatcher::globMatch("*", ""));
+    BOOST_CHECK(IgnoreMatcher::globMatch("[!x]*", "abc"));
+    BOOST_CHECK(!IgnoreMatcher::globMatch("[!a]*", "abc"));
+    BOOST_CHECK(!IgnoreMatcher::globMatch("a*d", "abc"));
+}
@@ -0,0 +1,759 @@
+#include <inotify-cpp/Inotify.h>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <fstream>
+#include <functional>
+#include <future>
+#include <map>
+#include <thread>
+
+using namespace inotify;
+
+struct InotifyTests {
+    InotifyTests()
+        : testDirectory_("inotifyTestDirectory")
+        , testFile_(testDirectory_ / "test.txt")
+    {
+        boost::filesystem::create_directories(testDirectory_);
+        boost::filesystem::ofstream stream(testFile_);
+    }
+    ~InotifyTests()
+    {
+        boost::filesystem::remove_all(testDirectory_);
+    }
+
+    void openTestFile()
+    {
+        std::ifstream stream;
+        stream.open(testFile_.string(), std::ifstream::in);
+        BOOST_CHECK(stream.is_open());
+        stream.close();
+    }
+
+    /**
+     * @brief Reads events until one matches the predicate or a
+     *        watchdog stops inotify after two seconds
+     */
+    bool waitForEvent(Inotify& inotify, std::function<bool(const FileSystemEvent&)> predicate)
+    {
+        std::promise<void> done;
+        auto future = done.get_future();
+        std::thread watchdog([&]() {
+            if (future.wait_for(std::chrono::seconds(2)) != std::future_status::ready) {
+                inotify.stop();
+            }
+        });
+
+        bool found = false;
+        std::vector<FileSystemEvent> events;
+        while (!found && inotify.getNextEvents(events)) {
+            for (const auto& event : events) {
+                found |= predicate(event);
+            }
+        }
+
+        done.set_value();
+        watchdog.join();
+        return found;
+    }
+
+    boost::filesystem::path testDirectory_;
+    boost::filesystem::path testFile_;
+};
+
+BOOST_FIXTURE_TEST_CASE(shouldReturnEventViewsOnWatchedDirectory, InotifyTests)
+{
+    Inotify inotify;
+    inotify.watchFile(testDirectory_);
+
+    openTestFile();
+
+    std::vector<EventView> views;
+    BOOST_REQUIRE(inotify.getNextEventViews(views) > 0);
+    BOOST_CHECK(views.front().mask & IN_OPEN);
+    BOOST_CHECK_EQUAL(views.front().name, "test.txt");
+    BOOST_CHECK(views.front().directory() == testDirectory_);
+    BOOST_CHECK(views.front().path() == testFile_);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldUseWatchedPathForEventsWithoutName, InotifyTests)
+{
+    Inotify inotify;
+    inotify.watchFile(testFile_);
+
+    openTestFile();
+
+    std::vector<FileSystemEvent> events;
+    BOOST_REQUIRE(inotify.getNextEvents(events) > 0);
+    BOOST_CHECK(events.front().path == testFile_);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldStatEventPathOnlyOnRequest, InotifyTests)
+{
+    Inotify inotify;
+    inotify.watchFile(testFile_);
+
+    openTestFile();
+
+    std::vector<FileSystemEvent> events;
+    BOOST_REQUIRE(inotify.getNextEvents(events) > 0);
+    BOOST_CHECK(!(events.front().mask & IN_ISDIR));
+
+    boost::filesystem::ofstream(testFile_) << "content";
+    BOOST_REQUIRE(events.front().attributes());
+    BOOST_CHECK(events.front().attributes()->type == boost::filesystem::regular_file);
+    BOOST_CHECK_EQUAL(events.front().attributes()->size, 7u);
+
+    boost::filesystem::remove(testFile_);
+    BOOST_CHECK_EQUAL(events.front().attributes()->size, 7u);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldReadEventsWithSmallEventBuffer, InotifyTests)
+{
+    Inotify inotify;
+    inotify.setMaxEvents(1);
+    BOOST_CHECK_EQUAL(inotify.getMaxEvents(), 1u);
+    inotify.watchFile(testDirectory_);
+
+    openTestFile();
+
+    std::vector<FileSystemEvent> events;
+    BOOST_REQUIRE(inotify.getNextEvents(events) > 0);
+    BOOST_CHECK(events.front().mask & IN_OPEN);
+    if (events.size() == 1) {
+        BOOST_REQUIRE(inotify.getNextEvents(events) > 0);
+    }
+    BOOST_CHECK(events.back().mask & IN_CLOSE_NOWRITE);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldWatchNewDirectoriesInAutoRecursiveMode, InotifyTests)
+{
+    Inotify inotify;
+    inotify.setAutoRecursive(true);
+    inotify.watchDirectoryRecursively(testDirectory_);
+
+    auto newDirectory = testDirectory_ / "new";
+    boost::filesystem::create_directories(newDirectory / "sub");
+    boost::filesystem::ofstream(newDirectory / "sub" / "early.txt");
+
+    // Files created before the watch was added are reported as well
+    BOOST_CHECK(waitForEvent(inotify, [&](const FileSystemEvent& event) {
+        return (event.mask & IN_CREATE) && event.path == newDirectory / "sub" / "early.txt";
+    }));
+
+    boost::filesystem::ofstream(newDirectory / "sub" / "late.txt");
+    BOOST_CHECK(waitForEvent(inotify, [&](const FileSystemEvent& event) {
+        return (event.mask & IN_CREATE) && event.path == newDirectory / "sub" / "late.txt";
+    }));
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldUnwatchDirectoryRecursively, InotifyTests)
+{
+    boost::filesystem::create_directories(testDirectory_ / "a" / "b" / "c");
+    boost::filesystem::create_directories(testDirectory_ / "d");
+
+    Inotify inotify;
+    inotify.watchDirectoryRecursively(testDirectory_);
+    BOOST_CHECK_EQUAL(inotify.getWatchCount(), 5u);
+
+    inotify.unwatchDirectoryRecursively(testDirectory_ / "a");
+    BOOST_CHECK_EQUAL(inotify.getWatchCount(), 2u);
+    BOOST_CHECK_THROW(
+        inotify.unwatchDirectoryRecursively(testDirectory_ / "a"), std::invalid_argument);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldKeepViewsValidWhenUnwatchingWhileReading, InotifyTests)
+{
+    auto directory = testDirectory_ / "a";
+    boost::filesystem::create_directories(directory / "b");
+
+    Inotify inotify;
+    inotify.setEventMask(IN_CREATE);
+    inotify.watchDirectoryRecursively(testDirectory_);
+    boost::filesystem::ofstream(directory / "new.txt");
+
+    std::vector<EventView> views;
+    BOOST_REQUIRE_EQUAL(inotify.getNextEventViews(views), 1u);
+    inotify.unwatchDirectoryRecursively(directory);
+    BOOST_CHECK_EQUAL(inotify.getWatchCount(), 1u);
+    BOOST_CHECK_THROW(inotify.unwatchDirectoryRecursively(directory), std::invalid_argument);
+
+    // The entries of the unwatched directories go with the next read
+    BOOST_CHECK(views.front().directory() == directory);
+    BOOST_CHECK(views.front().path() == directory / "new.txt");
+
+    boost::filesystem::ofstream(directory / "ignored.txt");
+    boost::filesystem::ofstream(testDirectory_ / "watched.txt");
+    BOOST_REQUIRE_EQUAL(inotify.getNextEventViews(views), 1u);
+    BOOST_CHECK(views.front().path() == testDirectory_ / "watched.txt");
+    BOOST_CHECK_EQUAL(inotify.getWatchCount(), 1u);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldRemoveWatchesOfDeletedAndMovedDirectories, InotifyTests)
+{
+    auto outside = boost::filesystem::path("inotifyTestOutside");
+    boost::filesystem::remove_all(outside);
+    boost::filesystem::create_directories(outside);
+    boost::filesystem::create_directories(testDirectory_ / "deleted" / "sub");
+    boost::filesystem::create_directories(testDirectory_ / "moved" / "sub");
+
+    Inotify inotify;
+    inotify.watchDirectoryRecursively(testDirectory_);
+    BOOST_CHECK_EQUAL(inotify.getWatchCount(), 5u);
+
+    boost::filesystem::remove_all(testDirectory_ / "deleted");
+    boost::filesystem::rename(testDirectory_ / "moved", outside / "moved");
+    boost::filesystem::ofstream(testDirectory_ / "last.txt");
+
+    BOOST_CHECK(waitForEvent(inotify, [&](const FileSystemEvent& event) {
+        return event.path == testDirectory_ / "last.txt";
+    }));
+
+    // Stale entries are dropped with the next read
+    boost::filesystem::ofstream(testDirectory_ / "last.txt") << "x";
+    BOOST_CHECK(waitForEvent(inotify, [](const FileSystemEvent&) { return true; }));
+    BOOST_CHECK_EQUAL(inotify.getWatchCount(), 1u);
+    boost::filesystem::remove_all(outside);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldPairRenamesByCookie, InotifyTests)
+{
+    auto outside = boost::filesystem::path("inotifyTestOutside");
+    boost::filesystem::remove_all(outside);
+    boost::filesystem::create_directories(outside);
+
+    Inotify inotify;
+    inotify.setRenamePairingWindow(std::chrono::milliseconds(50));
+    inotify.watchFile(testDirectory_);
+
+    boost::filesystem::rename(testFile_, testDirectory_ / "renamed.txt");
+    BOOST_CHECK(waitForEvent(inotify, [&](const FileSystemEvent& event) {
+        return (event.mask & IN_MOVE) == IN_MOVE && event.path == testDirectory_ / "renamed.txt"
+            && event.oldPath == testFile_;
+    }));
+
+    // The moved_from half has no partner and turns into a delete
+    boost::filesystem::rename(testDirectory_ / "renamed.txt", outside / "renamed.txt");
+    BOOST_CHECK(waitForEvent(inotify, [&](const FileSystemEvent& event) {
+        return (event.mask & IN_DELETE) && event.path == testDirectory_ / "renamed.txt";
+    }));
+    boost::filesystem::remove_all(outside);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldKeepWatchesOfRenamedDirectories, InotifyTests)
+{
+    boost::filesystem::create_directories(testDirectory_ / "old" / "sub");
+
+    Inotify inotify;
+    inotify.watchDirectoryRecursively(testDirectory_);
+    BOOST_CHECK_EQUAL(inotify.getWatchCount(), 3u);
+
+    boost::filesystem::rename(testDirectory_ / "old", testDirectory_ / "new");
+    BOOST_CHECK(waitForEvent(
+        inotify, [](const FileSystemEvent& event) { return event.mask & IN_MOVE_SELF; }));
+
+    boost::filesystem::ofstream(testDirectory_ / "new" / "sub" / "file.txt");
+    BOOST_CHECK(waitForEvent(inotify, [&](const FileSystemEvent& event) {
+        return event.path == testDirectory_ / "new" / "sub" / "file.txt";
+    }));
+    BOOST_CHECK_EQUAL(inotify.getWatchCount(), 3u);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldCoalesceEventsPerPath, InotifyTests)
+{
+    Inotify inotify;
+    inotify.setCoalescingPeriod(std::chrono::milliseconds(50));
+    inotify.setEventMask(IN_MODIFY | IN_CLOSE_WRITE);
+    inotify.watchFile(testDirectory_);
+
+    {
+        boost::filesystem::ofstream stream(testFile_);
+        for (int i = 0; i < 3; ++i) {
+            stream << "x" << std::flush;
+        }
+    }
+
+    std::vector<FileSystemEvent> events;
+    BOOST_REQUIRE_EQUAL(inotify.getNextEvents(events), 1u);
+    BOOST_CHECK(events.front().path == testFile_);
+    BOOST_CHECK_EQUAL(events.front().mask, static_cast<uint32_t>(IN_MODIFY | IN_CLOSE_WRITE));
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldDropEventsOfUnchangedContent, InotifyTests)
+{
+    Inotify inotify;
+    inotify.setContentCheck(ContentCheck::hash, 2);
+    inotify.setEventMask(IN_CLOSE_WRITE);
+    inotify.watchFile(testDirectory_);
+
+    std::size_t closed = 0;
+    auto readUntil = [&](std::size_t expectedClosed, std::uint64_t expectedUnchanged) {
+        std::vector<FileSystemEvent> events;
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (std::chrono::steady_clock::now() < deadline
+               && (closed < expectedClosed
+                   || inotify.getStatistics().eventsUnchanged < expectedUnchanged)) {
+            inotify.tryGetEvents(events);
+            for (const auto& event : events) {
+                closed += event.path == testFile_;
+            }
+        }
+    };
+
+    std::ofstream(testFile_.string()) << "content";
+    readUntil(1, 0);
+    BOOST_CHECK_EQUAL(closed, 1u);
+
+    std::ofstream(testFile_.string()) << "content";
+    readUntil(1, 1);
+    BOOST_CHECK_EQUAL(closed, 1u);
+    BOOST_CHECK_EQUAL(inotify.getStatistics().eventsUnchanged, 1u);
+
+    // Same size, only the hash differs
+    std::ofstream(testFile_.string()) << "changed";
+    readUntil(2, 1);
+    BOOST_CHECK_EQUAL(closed, 2u);
+    BOOST_CHECK_EQUAL(inotify.getStatistics().eventsUnchanged, 1u);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldReturnQueuedEventsAfterStop, InotifyTests)
+{
+    Inotify inotify;
+    inotify.watchFile(testFile_);
+    std::ofstream(testFile_.string()) << "content";
+
+    // Open, modify and close_write are read at once, one is returned
+    BOOST_REQUIRE(inotify.getNextEvent());
+    inotify.stop();
+
+    std::vector<FileSystemEvent> events;
+    auto returned = inotify.tryGetEvents(events);
+    BOOST_CHECK_EQUAL(returned, 2u);
+    BOOST_CHECK_EQUAL(events.size(), 2u);
+    BOOST_CHECK_EQUAL(inotify.tryGetEvents(events), 0u);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldShedLowPriorityEventsOfBoundedQueue, InotifyTests)
+{
+    Inotify inotify;
+    inotify.setEventQueue(4, Shedding::drop);
+    inotify.watchFile(testDirectory_);
+
+    for (int i = 0; i < 20; ++i) {
+        openTestFile();
+    }
+    boost::filesystem::remove(testFile_);
+
+    std::vector<FileSystemEvent> events;
+    BOOST_REQUIRE_EQUAL(inotify.getNextEvents(events), 4u);
+    BOOST_CHECK_EQUAL(events.front().mask, static_cast<uint32_t>(IN_DELETE));
+    BOOST_CHECK(inotify.getStatistics().eventsShedLow >= 30u);
+    BOOST_CHECK_EQUAL(inotify.getStatistics().eventsShedNormal, 0u);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldMatchOnceRulesAfterCrawling, InotifyTests)
+{
+    auto tree = testDirectory_ / "tree";
+    boost::filesystem::create_directories(tree / "a");
+    boost::filesystem::create_directories(tree / "b");
+
+    Inotify inotify;
+    inotify.setCrawlThreads(2);
+    inotify.ignoreFile("nomatch");
+    inotify.ignoreFileOnce(tree / "a");
+    BOOST_REQUIRE_NO_THROW(inotify.watchDirectoryRecursively(tree));
+    BOOST_CHECK_EQUAL(inotify.getWatchCount(), 2u);
+
+    // Used up by the crawl
+    inotify.watchFile(tree / "a");
+    BOOST_CHECK_EQUAL(inotify.getWatchCount(), 3u);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldApplyMasksAndIgnoresPerWatchGroup, InotifyTests)
+{
+    auto logs = testDirectory_ / "logs";
+    boost::filesystem::create_directories(logs / "archive");
+
+    Inotify inotify;
+    inotify.setEventMask(IN_CREATE);
+    auto group = inotify.addWatchGroup("logs");
+    BOOST_CHECK_EQUAL(inotify.addWatchGroup("logs"), group);
+    BOOST_CHECK_EQUAL(inotify.getWatchGroupName(group), "logs");
+    inotify.setWatchGroup(logs, group);
+    inotify.setGroupEventMask(group, IN_CLOSE_WRITE);
+    inotify.ignorePattern("*.tmp", group);
+    inotify.watchDirectoryRecursively(testDirectory_);
+    BOOST_CHECK_EQUAL(inotify.getWatchGroup(logs / "archive"), group);
+    BOOST_CHECK_EQUAL(inotify.getWatchGroup(testDirectory_), 0u);
+
+    boost::filesystem::ofstream((logs / "archive" / "ignored.tmp").string());
+    boost::filesystem::ofstream((logs / "archive" / "app.log").string());
+    boost::filesystem::ofstream((testDirectory_ / "created.tmp").string());
+
+    std::map<std::string, std::pair<uint32_t, uint32_t>> events;
+    BOOST_CHECK(waitForEvent(inotify, [&](const FileSystemEvent& event) {
+        events[event.path.filename().string()] = { event.mask, event.group };
+        return events.size() == 2;
+    }));
+    BOOST_CHECK(events["app.log"] == std::make_pair(uint32_t(IN_CLOSE_WRITE), group));
+    BOOST_CHECK(events["created.tmp"] == std::make_pair(uint32_t(IN_CREATE), 0u));
+    BOOST_CHECK(!events.count("ignored.tmp"));
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldReplayRecordedEvents, InotifyTests)
+{
+    auto logFile = testDirectory_ / "events.log";
+    auto watched = testDirectory_ / "watched";
+    boost::filesystem::create_directories(watched);
+
+    {
+        Inotify inotify;
+        inotify.setAutoRecursive(true);
+        inotify.watchDirectoryRecursively(watched);
+        inotify.recordEvents(logFile);
+
+        boost::filesystem::create_directories(watched / "sub");
+        BOOST_REQUIRE(waitForEvent(inotify, [&](const FileSystemEvent& event) {
+            return event.path == watched / "sub";
+        }));
+        boost::filesystem::ofstream((watched / "sub" / "a.txt").string());
+        BOOST_REQUIRE(waitForEvent(inotify, [&](const FileSystemEvent& event) {
+            return event.path == watched / "sub" / "a.txt" && (event.mask & IN_CLOSE_WRITE);
+        }));
+        inotify.stopRecording();
+    }
+
+    // The new directory was watched by the recording, the replay follows it
+    Inotify inotify;
+    inotify.setEventMask(IN_CLOSE_WRITE);
+    inotify.replayEvents(logFile, ReplaySpeed::maximum);
+    BOOST_CHECK_THROW(inotify.watchFile(testFile_), std::runtime_error);
+
+    std::vector<boost::filesystem::path> paths;
+    std::vector<FileSystemEvent> events;
+    while (inotify.getNextEvents(events)) {
+        for (const auto& event : events) {
+            BOOST_CHECK_EQUAL(event.mask, static_cast<uint32_t>(IN_CLOSE_WRITE));
+            paths.push_back(event.path);
+        }
+    }
+    BOOST_CHECK(inotify.hasStopped());
+    BOOST_REQUIRE_EQUAL(paths.size(), 1u);
+    BOOST_CHECK(paths[0] == watched / "sub" / "a.txt");
+    BOOST_CHECK_EQUAL(inotify.getWatchCount(), 2u);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldReplayWatchesAfterLastEvents, InotifyTests)
+{
+    auto logFile = testDirectory_ / "events.log";
+    auto watched = testDirectory_ / "watched";
+    boost::filesystem::create_directories(watched);
+
+    // The new directory is watched after its event was recorded
+    {
+        Inotify inotify;
+        inotify.setAutoRecursive(true);
+        inotify.watchDirectoryRecursively(watched);
+        inotify.recordEvents(logFile);
+
+        boost::filesystem::create_directories(watched / "sub");
+        BOOST_REQUIRE(waitForEvent(inotify, [&](const FileSystemEvent& event) {
+            return event.path == watched / "sub";
+        }));
+        inotify.stopRecording();
+    }
+
+    EventLogReader reader;
+    BOOST_REQUIRE(reader.load(logFile));
+    BOOST_REQUIRE(!reader.records().empty());
+    BOOST_REQUIRE(reader.records().back().type == EventLogRecord::watch);
+
+    Inotify inotify;
+    inotify.replayEvents(logFile, ReplaySpeed::maximum);
+    std::vector<FileSystemEvent> events;
+    while (inotify.getNextEvents(events)) {
+    }
+    BOOST_CHECK(inotify.hasStopped());
+    BOOST_CHECK_EQUAL(inotify.getWatchCount(), 2u);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldRecoverFromQueueOverflow, InotifyTests)
+{
+    auto maxQueuedEvents = Inotify::getMaxQueuedEvents();
+    if (maxQueuedEvents == 0 || maxQueuedEvents > 100000) {
+        BOOST_TEST_MESSAGE("Skipped, max_queued_events is " << maxQueuedEvents);
+        return;
+    }
+
+    Inotify inotify;
+    inotify.setOverflowRecovery(true);
+    std::vector<QueueOverflow> overflows;
+    inotify.setOverflowObserver(
+        [&](const QueueOverflow& overflow) { overflows.push_back(overflow); });
+    inotify.watchDirectoryRecursively(testDirectory_);
+    auto maxEvents = inotify.getMaxEvents();
+
+    // Open and close events alternate, the kernel can not merge them
+    for (std::size_t i = 0; i < maxQueuedEvents; ++i) {
+        openTestFile();
+    }
+    boost::filesystem::ofstream(testDirectory_ / "lost.txt");
+
+    bool overflow = false;
+    BOOST_CHECK(waitForEvent(inotify, [&](const FileSystemEvent& event) {
+        overflow |= (event.mask & IN_Q_OVERFLOW) != 0;
+        return overflow && (event.mask & IN_CREATE) && event.path == testDirectory_ / "lost.txt";
+    }));
+    BOOST_CHECK_EQUAL(inotify.getOverflowCount(), 1u);
+    BOOST_REQUIRE_EQUAL(overflows.size(), 1u);
+    BOOST_CHECK_EQUAL(overflows[0].maxQueuedEvents, maxQueuedEvents);
+    BOOST_CHECK_EQUAL(overflows[0].overflows, 1u);
+    BOOST_CHECK(overflows[0].eventsPerSecond > 0u);
+
+    // The read buffer grows with the next read
+    openTestFile();
+    BOOST_CHECK(waitForEvent(inotify, [](const FileSystemEvent&) { return true; }));
+    BOOST_CHECK(inotify.getMaxEvents() > maxEvents);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldSpreadWatchesOverInotifyInstances, InotifyTests)
+{
+    for (const char* directory : { "a", "b", "c", "d", "e" }) {
+        boost::filesystem::create_directories(testDirectory_ / directory);
+    }
+
+    Inotify inotify;
+    inotify.setInotifyInstances(3);
+    BOOST_CHECK_EQUAL(inotify.getInotifyInstances(), 3u);
+    inotify.watchDirectoryRecursively(testDirectory_);
+    BOOST_CHECK_EQUAL(inotify.getWatchCount(), 6u);
+    BOOST_CHECK_THROW(inotify.setInotifyInstances(1), std::runtime_error);
+
+    for (const char* directory : { "a", "b", "c", "d", "e" }) {
+        auto file = testDirectory_ / directory / "file.txt";
+        boost::filesystem::ofstream(file.string());
+        BOOST_CHECK(waitForEvent(inotify, [&](const FileSystemEvent& event) {
+            return (event.mask & IN_CREATE) && event.path == file;
+        }));
+    }
+
+    inotify.unwatchDirectoryRecursively(testDirectory_ / "c");
+    BOOST_CHECK_EQUAL(inotify.getWatchCount(), 5u);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldReportWatchErrorsPerPath, InotifyTests)
+{
+    boost::filesystem::create_directories(testDirectory_ / "directory");
+
+    Inotify inotify;
+    auto errors = inotify.watchFiles(
+        { testDirectory_ / "directory", testDirectory_ / "missing", testFile_ }, IN_ONLYDIR);
+    BOOST_REQUIRE_EQUAL(errors.size(), 3u);
+    BOOST_CHECK(!errors[0]);
+    BOOST_CHECK(errors[1] == boost::system::errc::no_such_file_or_directory);
+    BOOST_CHECK(errors[2] == boost::system::errc::not_a_directory);
+    BOOST_CHECK_EQUAL(inotify.getWatchCount(), 1u);
+
+    boost::system::error_code error;
+    inotify.watchFile(testDirectory_ / "missing", error);
+    BOOST_CHECK(error == boost::system::errc::no_such_file_or_directory);
+    inotify.watchDirectoryRecursively(testDirectory_, error);
+    BOOST_CHECK(!error);
+    BOOST_CHECK_EQUAL(inotify.getWatchCount(), 2u);
+    BOOST_CHECK_EQUAL(inotify.getCrawlStatistics().failedWatches, 0u);
+    BOOST_CHECK_THROW(inotify.watchFiles({ testFile_ }, IN_ONESHOT), std::invalid_argument);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldKeepAddedEventsOnMaskChange, InotifyTests)
+{
+    Inotify inotify;
+    inotify.setEventMask(IN_CREATE);
+    inotify.watchFiles({ testDirectory_ });
+    inotify.setEventMask(IN_DELETE);
+    BOOST_REQUIRE(!inotify.watchFiles({ testDirectory_ }, IN_MASK_ADD).front());
+
+    auto file = testDirectory_ / "added.txt";
+    boost::filesystem::ofstream stream(file);
+    stream.close();
+    boost::filesystem::remove(file);
+
+    std::vector<uint32_t> masks;
+    std::vector<FileSystemEvent> events;
+    auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+    while (masks.size() < 2 && std::chrono::steady_clock::now() < deadline) {
+        inotify.tryGetEvents(events);
+        for (const auto& event : events) {
+            if (event.path == file) {
+                masks.push_back(event.mask);
+            }
+        }
+    }
+    BOOST_REQUIRE_EQUAL(masks.size(), 2u);
+    BOOST_CHECK_EQUAL(masks[0], static_cast<uint32_t>(IN_CREATE));
+    BOOST_CHECK_EQUAL(masks[1], static_cast<uint32_t>(IN_DELETE));
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldReportOnlyRequestedEventsPerPath, InotifyTests)
+{
+    auto dataDirectory = testDirectory_ / "data";
+    auto dataFile = dataDirectory / "data.txt";
+    boost::filesystem::create_directories(dataDirectory);
+
+    Inotify inotify;
+    inotify.setEventMask(IN_OPEN | IN_CLOSE_WRITE);
+    inotify.setEventMask(dataDirectory, IN_CLOSE_WRITE);
+    BOOST_CHECK_EQUAL(inotify.getEventMask(dataFile), static_cast<uint32_t>(IN_CLOSE_WRITE));
+    BOOST_CHECK_EQUAL(inotify.getEventMask(testDirectory_ / "database"),
+        static_cast<uint32_t>(IN_OPEN | IN_CLOSE_WRITE));
+    inotify.watchDirectoryRecursively(testDirectory_);
+
+    boost::filesystem::ofstream(dataFile.string()) << "data";
+    openTestFile();
+
+    uint32_t dataMask = 0;
+    uint32_t otherMask = 0;
+    BOOST_CHECK(waitForEvent(inotify, [&](const FileSystemEvent& event) {
+        if (event.path == dataFile) {
+            dataMask |= event.mask;
+        } else if (event.path != testFile_) {
+            otherMask |= event.mask;
+        }
+        return event.path == testFile_ && (event.mask & IN_OPEN);
+    }));
+    BOOST_CHECK_EQUAL(dataMask, static_cast<uint32_t>(IN_CLOSE_WRITE));
+    BOOST_CHECK_EQUAL(otherMask & ~(IN_OPEN | IN_CLOSE_WRITE | IN_ISDIR), 0u);
+
+    // Masks of existing watches change with the next read
+    inotify.setEventMask(dataDirectory, IN_OPEN);
+    openTestFile();
+    BOOST_CHECK(waitForEvent(inotify, [&](const FileSystemEvent& event) {
+        return event.path == testFile_ && (event.mask & IN_OPEN);
+    }));
+    boost::filesystem::ofstream(dataFile.string()) << "data";
+    BOOST_CHECK(waitForEvent(inotify, [&](const FileSystemEvent& event) {
+        BOOST_CHECK(!(event.mask & IN_CLOSE_WRITE) || event.path != dataFile);
+        return event.path == dataFile && (event.mask & IN_OPEN);
+    }));
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldWatchFilesystemThroughFanotifyMark, InotifyTests)
+{
+    auto root = boost::filesystem::canonical(testDirectory_);
+    boost::filesystem::create_directories(root / "a" / "b");
+
+    Inotify inotify;
+    inotify.setRenamePairingWindow(std::chrono::milliseconds(100));
+    try {
+        inotify.watchFilesystem(testDirectory_);
+    } catch (const std::runtime_error& error) {
+        // Needs CAP_SYS_ADMIN and Linux 5.9
+        BOOST_TEST_MESSAGE("fanotify not available: " << error.what());
+        return;
+    }
+    BOOST_CHECK_EQUAL(inotify.getWatchCount(), 0u);
+
+    boost::filesystem::ofstream((root / "a" / "b" / "file.txt").string()) << "data";
+    boost::filesystem::ofstream((testDirectory_.parent_path() / "outside.txt").string());
+    boost::filesystem::rename(root / "a" / "b" / "file.txt", root / "a" / "moved.txt");
+    boost::filesystem::remove(testDirectory_.parent_path() / "outside.txt");
+
+    bool created = false;
+    bool written = false;
+    BOOST_CHECK(waitForEvent(inotify, [&](const FileSystemEvent& event) {
+        BOOST_CHECK_EQUAL(event.wd, FanotifySource::markWd);
+        BOOST_CHECK(event.path.native().compare(0, root.native().size(), root.native()) == 0);
+        created |= (event.mask & IN_CREATE) && event.path == root / "a" / "b" / "file.txt";
+        written |= (event.mask & IN_CLOSE_WRITE) && event.path == root / "a" / "b" / "file.txt";
+        return (event.mask & IN_MOVE) == IN_MOVE && event.path == root / "a" / "moved.txt"
+            && event.oldPath == root / "a" / "b" / "file.txt";
+    }));
+    BOOST_CHECK(created);
+    BOOST_CHECK(written);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldCountEventsOfTheReadingPath, InotifyTests)
+{
+    Inotify inotify;
+    inotify.ignoreFile(testDirectory_ / "ignored.txt");
+    inotify.watchDirectoryRecursively(testDirectory_);
+    BOOST_CHECK_EQUAL(inotify.getStatistics().watches, 1u);
+    BOOST_CHECK_EQUAL(inotify.getStatistics().maxWatches, Inotify::getMaxWatches());
+
+    boost::filesystem::ofstream((testDirectory_ / "ignored.txt").string());
+    openTestFile();
+    BOOST_CHECK(waitForEvent(inotify, [&](const FileSystemEvent& event) {
+        return event.path == testFile_ && (event.mask & IN_OPEN);
+    }));
+
+    auto statistics = inotify.getStatistics();
+    BOOST_CHECK(statistics.wakeups >= 1u);
+    BOOST_CHECK(statistics.reads >= 1u);
+    BOOST_CHECK(statistics.bytesRead >= statistics.eventsParsed * EVENT_SIZE);
+    BOOST_CHECK(statistics.eventsIgnored >= 1u);
+    BOOST_CHECK_EQUAL(statistics.eventsParsed, statistics.eventsIgnored + statistics.eventsReturned);
+    BOOST_CHECK_EQUAL(statistics.overflows, 0u);
+    BOOST_CHECK_EQUAL(statistics.queuedEvents, 0u);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldRestoreWatchStateAndReportChanges, InotifyTests)
+{
+    boost::filesystem::path stateFile("inotifyWatchState.bin");
+    boost::filesystem::create_directories(testDirectory_ / "unchanged" / "deep");
+    boost::filesystem::create_directories(testDirectory_ / "removed");
+    {
+        Inotify inotify;
+        inotify.watchDirectoryRecursively(testDirectory_);
+        inotify.saveWatchState(stateFile);
+    }
+
+    boost::filesystem::remove(testDirectory_ / "removed");
+    boost::filesystem::create_directories(testDirectory_ / "added" / "inner");
+    boost::filesystem::ofstream(testDirectory_ / "unchanged" / "new.txt");
+
+    Inotify inotify;
+    inotify.setEventMask(IN_CREATE | IN_DELETE);
+    BOOST_CHECK(!inotify.restoreWatchState("/not/existing/state"));
+    BOOST_REQUIRE(inotify.restoreWatchState(stateFile));
+    boost::filesystem::remove(stateFile);
+    BOOST_CHECK_EQUAL(inotify.getWatchCount(), 5u);
+
+    std::map<boost::filesystem::path, std::uint32_t> changes;
+    BOOST_CHECK(waitForEvent(inotify, [&](const FileSystemEvent& event) {
+        changes[event.path] |= event.mask;
+        return changes.size() == 4;
+    }));
+    BOOST_CHECK_EQUAL(changes[testDirectory_ / "removed"], IN_DELETE | IN_ISDIR);
+    BOOST_CHECK_EQUAL(changes[testDirectory_ / "added"], IN_CREATE | IN_ISDIR);
+    BOOST_CHECK_EQUAL(changes[testDirectory_ / "added" / "inner"], IN_CREATE | IN_ISDIR);
+    BOOST_CHECK_EQUAL(changes[testDirectory_ / "unchanged" / "new.txt"], IN_CREATE);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldRestoreOnlyTheSavedTreeOfRoot, InotifyTests)
+{
+    boost::filesystem::path stateFile("inotifyRootState.bin");
+    auto saved = testDirectory_ / "saved";
+    auto other = testDirectory_ / "other";
+    boost::filesystem::create_directories(saved / "inner");
+    boost::filesystem::create_directories(other);
+    {
+        Inotify inotify;
+        inotify.watchDirectoryRecursively(saved);
+        inotify.saveWatchState(stateFile);
+    }
+
+    {
+        Inotify inotify;
+        BOOST_CHECK(!inotify.restoreWatchState(stateFile, other));
+        BOOST_CHECK_EQUAL(inotify.getWatchCount(), 0u);
+        BOOST_REQUIRE(inotify.restoreWatchState(stateFile, saved));
+        BOOST_CHECK_EQUAL(inotify.getWatchCount(), 2u);
+    }
+
+    // Like watchDirectoryRecursively of a missing path
+    boost::filesystem::remove_all(saved);
+    Inotify inotify;
+    BOOST_CHECK_THROW(inotify.restoreWatchState(stateFile, saved), std::invalid_argument);
+    boost::filesystem::remove(stateFile);
+}
@@ -0,0 +1,104 @@
+#include <inotify-cpp/NotificationExecutor.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <map>
+#include <mutex>
+#include <string>
+#include <vector>
+
+using namespace inotify;
+
+namespace {
+Notification makeNotification(const std::string& path, Event event)
+{
+    Notification notification;
+    notification.event = event;
+    notification.path = path;
+    return notification;
+}
+}
+
+BOOST_AUTO_TEST_CASE(shouldKeepOrderOfNotificationsPerPath)
+{
+    std::mutex mutex;
+    std::map<std::string, std::vector<int>> observed;
+    std::map<std::string, std::size_t> workers;
+    bool sameWorker = true;
+
+    {
+        NotificationExecutor executor(4, 8, Backpressure::block,
+            [&](std::size_t worker, const Notification& notification) {
+                std::lock_guard<std::mutex> lock(mutex);
+                auto path = notification.path.string();
+                sameWorker &= workers.emplace(path, worker).first->second == worker;
+                observed[path].push_back(std::stoi(notification.oldPath.string()));
+            });
+
+        // The sequence number is carried in the old path
+        for (int i = 0; i < 1000; ++i) {
+            auto notification = makeNotification("file" + std::to_string(i % 16), Event::modify);
+            notification.oldPath = std::to_string(i);
+            BOOST_CHECK(executor.submit(notification));
+        }
+    }
+
+    BOOST_CHECK(sameWorker);
+    BOOST_REQUIRE_EQUAL(observed.size(), 16u);
+    std::size_t total = 0;
+    for (const auto& path : observed) {
+        total += path.second.size();
+        BOOST_CHECK(std::is_sorted(path.second.begin(), path.second.end()));
+    }
+    BOOST_CHECK_EQUAL(total, 1000u);
+}
+
+BOOST_AUTO_TEST_CASE(shouldDropNotificationsOnFullQueue)
+{
+    std::promise<void> release;
+    auto released = release.get_future().share();
+    std::size_t observed = 0;
+
+    NotificationExecutor executor(
+        1, 2, Backpressure::drop, [&](std::size_t, const Notification&) {
+            released.wait();
+            ++observed;
+        });
+
+    std::size_t submitted = 0;
+    for (int i = 0; i < 10; ++i) {
+        submitted += executor.submit(makeNotification("file", Event::modify));
+    }
+    release.set_value();
+    executor.stop();
+
+    BOOST_CHECK_EQUAL(observed, submitted);
+    BOOST_CHECK_EQUAL(executor.getDroppedNotifications(), 10 - submitted);
+    BOOST_CHECK(executor.getDroppedNotifications() >= 7u);
+}
+
+BOOST_AUTO_TEST_CASE(shouldNotLoseWakeupsOfBlockedSubmits)
+{
+    const std::size_t notifications = 200000;
+    std::atomic<std::size_t> observed(0);
+    NotificationExecutor executor(1, 1, Backpressure::block,
+        [&](std::size_t, const Notification&) { ++observed; });
+
+    // Every submit waits for the worker, a lost wakeup blocks forever
+    auto submitted = std::async(std::launch::async, [&]() {
+        auto notification = makeNotification("file", Event::modify);
+        for (std::size_t i = 0; i < notifications; ++i) {
+            executor.submit(notification);
+        }
+    });
+    auto status = submitted.wait_for(std::chrono::seconds(30));
+    BOOST_CHECK(status == std::future_status::ready);
+
+    executor.stop();
+    submitted.get();
+    BOOST_CHECK_EQUAL(observed, notifications);
+}
@@ -63,6 +63,21 @@ BOOST_FIXTURE_TEST_CASE(shouldNotifyOnOpenEvent, NotifierBuilderTests)
     thread.join();
 }
 
+BOOST_FIXTURE_TEST_CASE(shouldNotifyWithoutPollingDelay, NotifierBuilderTests)
+{
+    auto notifier = BuildNotifier().watchFile(testFile_).onEvent(
+        Event::open, [&](Notification notification) { promisedOpen_.set_value(notification); });
+
+    std::thread thread([&notifier]() { notifier.runOnce(); });
+
+    openFile(testFile_);
+
+    auto futureOpenEvent = promisedOpen_.get_future();
+    BOOST_CHECK(
+        futureOpenEvent.wait_for(std::chrono::milliseconds(200)) == std::future_status::ready);
+    thread.join();
+}
+
 BOOST_FIXTURE_TEST_CASE(shouldNotifyOnMultipleEvents, NotifierBuilderTests)
 {
     auto notifier = BuildNotifier().watchFile(testFile_).onEvents(
@@ -93,6 +108,68 @@ BOOST_FIXTURE_TEST_CASE(shouldNotifyOnMultipleEvents, NotifierBuilderTests)
     thread.join();
 }
 
+BOOST_FIXTURE_TEST_CASE(shouldNotifyOnEventBatch, NotifierBuilderTests)
+{
+    std::promise<std::vector<Notification>> promisedBatch;
+
+    auto notifier = BuildNotifier().watchFile(testFile_).onEventBatch(
+        [&](const std::vector<Notification>& batch) { promisedBatch.set_value(batch); });
+
+    std::thread thread([&notifier]() { notifier.runBatch(); });
+
+    openFile(testFile_);
+
+    auto futureBatch = promisedBatch.get_future();
+    BOOST_CHECK(futureBatch.wait_for(timeout_) == std::future_status::ready);
+    auto batch = futureBatch.get();
+    BOOST_REQUIRE(!batch.empty());
+    BOOST_CHECK(batch.front().event == Event::open);
+    thread.join();
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldNotifyOnEventBatchInRun, NotifierBuilderTests)
+{
+    std::promise<std::vector<Notification>> promisedBatch;
+    bool notified = false;
+
+    auto notifier = BuildNotifier().watchFile(testFile_).onEventBatch(
+        [&](const std::vector<Notification>& batch) {
+            if (!notified) {
+                notified = true;
+                promisedBatch.set_value(batch);
+            }
+        });
+
+    std::thread thread([&notifier]() { notifier.run(); });
+
+    openFile(testFile_);
+
+    auto futureBatch = promisedBatch.get_future();
+    auto status = futureBatch.wait_for(timeout_);
+    notifier.stop();
+    thread.join();
+
+    BOOST_REQUIRE(status == std::future_status::ready);
+    auto batch = futureBatch.get();
+    BOOST_REQUIRE(!batch.empty());
+    BOOST_CHECK(batch.front().event == Event::open);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldDispatchEventBatchToEventObservers, NotifierBuilderTests)
+{
+    auto notifier = BuildNotifier().watchFile(testFile_).onEvent(
+        Event::open, [&](Notification notification) { promisedOpen_.set_value(notification); });
+
+    std::thread thread([&notifier]() { notifier.runBatch(); });
+
+    openFile(testFile_);
+
+    auto futureOpen = promisedOpen_.get_future();
+    BOOST_CHECK(futureOpen.wait_for(timeout_) == std::future_status::ready);
+    BOOST_CHECK(futureOpen.get().event == Event::open);
+    thread.join();
+}
+
 BOOST_FIXTURE_TEST_CASE(shouldStopRunOnce, NotifierBuilderTests)
 {
     auto notifier = BuildNotifier().watchFile(testFile_);
@@ -228,3 +305,257 @@ BOOST_FIXTURE_TEST_CASE(shouldSetEventTimeout, NotifierBuilderTests)
     BOOST_CHECK(timeoutObserved.get_future().wait_for(timeout_) == std::future_status::ready);
     thread.join();
 }
+
+BOOST_FIXTURE_TEST_CASE(shouldDispatchOnIntersectingEventBits, NotifierBuilderTests)
+{
+    std::vector<Notification> created;
+    std::vector<Notification> directories;
+    std::size_t unexpected = 0;
+
+    auto notifier = BuildNotifier()
+                        .watchFile(testDirectory_)
+                        .onEvent(Event::create,
+                            [&](Notification notification) { created.push_back(notification); })
+                        .onEvent(Event::is_dir,
+                            [&](Notification notification) {
+                                directories.push_back(notification);
+                            })
+                        .onUnexpectedEvent([&](Notification) { ++unexpected; });
+
+    std::thread thread([&notifier]() {
+        notifier.runOnce();
+        notifier.runOnce();
+    });
+
+    auto directory = testDirectory_ / "dispatchDirectory";
+    boost::filesystem::create_directory(directory);
+    boost::filesystem::ofstream(testDirectory_ / "dispatch.txt");
+    thread.join();
+
+    BOOST_REQUIRE_EQUAL(created.size(), 2u);
+    BOOST_CHECK(created[0].event == (Event::create | Event::is_dir));
+    BOOST_CHECK(created[0].path == directory);
+    BOOST_CHECK(created[1].event == Event::create);
+    BOOST_REQUIRE_EQUAL(directories.size(), 1u);
+    BOOST_CHECK(directories[0].path == directory);
+    BOOST_CHECK_EQUAL(unexpected, 0u);
+
+    boost::filesystem::remove_all(directory);
+    boost::filesystem::remove(testDirectory_ / "dispatch.txt");
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldRunObserversOnObserverThreads, NotifierBuilderTests)
+{
+    std::promise<std::thread::id> observerThread;
+
+    auto notifier = BuildNotifier()
+                        .watchFile(testFile_)
+                        .setObserverThreads(2, 16)
+                        .onEvent(Event::open, [&](Notification) {
+                            observerThread.set_value(std::this_thread::get_id());
+                        });
+
+    std::thread thread([&notifier]() { notifier.run(); });
+
+    openFile(testFile_);
+
+    auto futureThread = observerThread.get_future();
+    BOOST_CHECK(futureThread.wait_for(timeout_) == std::future_status::ready);
+    BOOST_CHECK(futureThread.get() != thread.get_id());
+    notifier.stop();
+    thread.join();
+    BOOST_CHECK_EQUAL(notifier.getDroppedNotifications(), 0u);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldMeasureObserverCalls, NotifierBuilderTests)
+{
+    std::promise<void> observed;
+
+    auto notifier = BuildNotifier()
+                        .watchFile(testFile_)
+                        .setObserverStatistics(true)
+                        .onEvent(Event::attrib, [](Notification) {})
+                        .onEvent(Event::open, [&](Notification) { observed.set_value(); });
+
+    std::thread thread([&notifier]() { notifier.runOnce(); });
+
+    openFile(testFile_);
+
+    BOOST_CHECK(observed.get_future().wait_for(timeout_) == std::future_status::ready);
+    thread.join();
+
+    auto observers = notifier.getObserverStatistics();
+    BOOST_REQUIRE_EQUAL(observers.size(), 2u);
+    BOOST_CHECK(observers[0].events == Event::attrib);
+    BOOST_CHECK_EQUAL(observers[0].calls, 0u);
+    BOOST_CHECK(observers[1].events == Event::open);
+    BOOST_CHECK_EQUAL(observers[1].calls, 1u);
+    BOOST_CHECK_EQUAL(notifier.getStatistics().eventsDispatched, 1u);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldDispatchToObserversOfWatchGroups, NotifierBuilderTests)
+{
+    auto sources = testDirectory_ / "sources";
+    auto logs = testDirectory_ / "logs";
+    boost::filesystem::remove_all(sources);
+    boost::filesystem::remove_all(logs);
+    boost::filesystem::create_directories(sources);
+    boost::filesystem::create_directories(logs);
+
+    std::vector<Notification> created;
+    std::vector<Notification> logged;
+    auto notifier = BuildNotifier()
+                        .watchPathRecursively(sources)
+                        .onEvent(Event::create,
+                            [&](const Notification& notification) {
+                                created.push_back(notification);
+                            })
+                        .group("logs")
+                        .watchPathRecursively(logs)
+                        .ignorePattern("*.tmp")
+                        .onEvent(Event::close_write, [&](const Notification& notification) {
+                            logged.push_back(notification);
+                        });
+    // Applies the masks of the observers to the watches
+    notifier.processReady();
+
+    boost::filesystem::ofstream(sources / "main.tmp");
+    boost::filesystem::ofstream(logs / "ignored.tmp");
+    boost::filesystem::ofstream(logs / "app.log");
+
+    auto deadline = std::chrono::steady_clock::now() + timeout_;
+    while ((created.empty() || logged.empty()) && std::chrono::steady_clock::now() < deadline) {
+        notifier.processReady();
+    }
+
+    // Only the group ignores temporary files and only sees its own events
+    BOOST_REQUIRE_EQUAL(created.size(), 1u);
+    BOOST_CHECK(created[0].path == sources / "main.tmp");
+    BOOST_CHECK_EQUAL(created[0].group, 0u);
+    BOOST_REQUIRE_EQUAL(logged.size(), 1u);
+    BOOST_CHECK(logged[0].path == logs / "app.log");
+    BOOST_CHECK_NE(logged[0].group, 0u);
+
+    boost::filesystem::remove_all(sources);
+    boost::filesystem::remove_all(logs);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldWatchPathNotInRestoredState, NotifierBuilderTests)
+{
+    boost::filesystem::path stateFile("notifierWatchState.bin");
+    auto saved = testDirectory_ / "saved";
+    auto restored = testDirectory_ / "restored";
+    boost::filesystem::remove_all(saved);
+    boost::filesystem::remove_all(restored);
+    boost::filesystem::create_directories(saved);
+    boost::filesystem::create_directories(restored);
+    {
+        Inotify inotify;
+        inotify.watchDirectoryRecursively(saved);
+        inotify.saveWatchState(stateFile);
+    }
+
+    std::vector<Notification> created;
+    auto notifier = BuildNotifier()
+                        .group("restored")
+                        .restoreWatchState(stateFile, restored)
+                        .onEvent(Event::create, [&](const Notification& notification) {
+                            created.push_back(notification);
+                        });
+    notifier.processReady();
+    boost::filesystem::remove(stateFile);
+
+    boost::filesystem::ofstream(saved / "a.txt");
+    boost::filesystem::ofstream(restored / "b.txt");
+
+    auto deadline = std::chrono::steady_clock::now() + timeout_;
+    while (created.empty() && std::chrono::steady_clock::now() < deadline) {
+        notifier.processReady();
+    }
+
+    // The tree of the state is not the one asked for
+    BOOST_REQUIRE_EQUAL(created.size(), 1u);
+    BOOST_CHECK(created[0].path == restored / "b.txt");
+    BOOST_CHECK_NE(created[0].group, 0u);
+
+    boost::filesystem::remove_all(saved);
+    boost::filesystem::remove_all(restored);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldDispatchEventsOfGroupsWithoutObserversToDefault, NotifierBuilderTests)
+{
+    auto logs = testDirectory_ / "quietLogs";
+    boost::filesystem::remove_all(logs);
+    boost::filesystem::create_directories(logs);
+
+    std::vector<Notification> created;
+    auto notifier = BuildNotifier()
+                        .onEvent(Event::create,
+                            [&](const Notification& notification) {
+                                created.push_back(notification);
+                            })
+                        .group("logs")
+                        .watchPathRecursively(logs)
+                        .ignorePattern("*.tmp");
+    notifier.processReady();
+
+    boost::filesystem::ofstream(logs / "ignored.tmp");
+    boost::filesystem::ofstream(logs / "app.log");
+
+    auto deadline = std::chrono::steady_clock::now() + timeout_;
+    while (created.empty() && std::chrono::steady_clock::now() < deadline) {
+        notifier.processReady();
+    }
+
+    // The ignore rules of the group still apply
+    BOOST_REQUIRE_EQUAL(created.size(), 1u);
+    BOOST_CHECK(created[0].path == logs / "app.log");
+    BOOST_CHECK_NE(created[0].group, 0u);
+
+    boost::filesystem::remove_all(logs);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldDispatchReplayedEvents, NotifierBuilderTests)
+{
+    auto logFile = boost::filesystem::path("notifierEvents.log");
+    std::vector<Notification> recorded;
+    {
+        auto notifier = BuildNotifier()
+                            .watchFile(testFile_)
+                            .recordEvents(logFile)
+                            .onEvent(Event::close_write, [&](const Notification& notification) {
+                                recorded.push_back(notification);
+                            });
+
+        boost::filesystem::ofstream(testFile_) << "recorded";
+        auto deadline = std::chrono::steady_clock::now() + timeout_;
+        while (recorded.empty() && std::chrono::steady_clock::now() < deadline) {
+            notifier.processReady();
+        }
+        notifier.stopRecording();
+    }
+    BOOST_REQUIRE_EQUAL(recorded.size(), 1u);
+
+    // Nothing is written now, the replay does not touch the kernel
+    std::vector<Notification> replayed;
+    auto notifier = BuildNotifier()
+                        .replayEvents(logFile)
+                        .onEvent(Event::close_write, [&](const Notification& notification) {
+                            replayed.push_back(notification);
+                        });
+
+    std::promise<void> finished;
+    std::thread thread([&]() {
+        notifier.run();
+        finished.set_value();
+    });
+    if (finished.get_future().wait_for(timeout_) != std::future_status::ready) {
+        notifier.stop();
+        BOOST_ERROR("replay did not finish");
+    }
+    thread.join();
+
+    BOOST_REQUIRE_EQUAL(replayed.size(), 1u);
+    BOOST_CHECK(replayed[0].path == testFile_);
+    boost::filesystem::remove(logFile);
+}
@@ -0,0 +1,100 @@
+#include <inotify-cpp/StaticNotifier.h>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <fstream>
+#include <thread>
+#include <vector>
+
+using namespace inotify;
+
+struct StaticNotifierTests {
+    StaticNotifierTests()
+        : testDirectory_("staticNotifierTestDirectory")
+        , testFile_(testDirectory_ / "test.txt")
+    {
+        boost::filesystem::create_directories(testDirectory_);
+        boost::filesystem::ofstream stream(testFile_);
+    }
+    ~StaticNotifierTests()
+    {
+        boost::filesystem::remove_all(testDirectory_);
+    }
+
+    /**
+     * @brief Dispatches until the predicate holds, at most two seconds
+     */
+    template <typename Notifier, typename Predicate>
+    bool dispatchUntil(Notifier& notifier, Predicate predicate)
+    {
+        auto deadline = std::chrono::steady_clock::now() + std::chrono::seconds(2);
+        while (!predicate() && std::chrono::steady_clock::now() < deadline) {
+            notifier.processReady();
+        }
+        return predicate();
+    }
+
+    boost::filesystem::path testDirectory_;
+    boost::filesystem::path testFile_;
+};
+
+BOOST_AUTO_TEST_CASE(shouldBuildEventMaskAtCompileTime)
+{
+    auto observer = [](const Notification&) {};
+    using Notifier = decltype(makeNotifier(on<Event::close_write>(observer),
+        on<Event::create, Event::moved_to>(observer)));
+    static_assert(Notifier::eventMask == (IN_CLOSE_WRITE | IN_CREATE | IN_MOVED_TO),
+        "Mask of the observed events");
+
+    using DirectoryNotifier = decltype(makeNotifier(on<Event::is_dir>(observer)));
+    static_assert(DirectoryNotifier::eventMask == IN_ALL_EVENTS, "is_dir needs every event");
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldDispatchToMatchingObservers, StaticNotifierTests)
+{
+    std::vector<Notification> closed;
+    std::size_t opened = 0;
+    std::size_t directoryEvents = 0;
+    auto notifier = makeNotifier(
+        on<Event::close_write>([&](const Notification& notification) {
+            closed.push_back(notification);
+        }),
+        on<Event::open, Event::close>([&](const Notification&) { ++opened; }),
+        on<Event::open, Event::is_dir>([&](const Notification&) { ++directoryEvents; }));
+    notifier.watchPathRecursively(testDirectory_);
+
+    std::ofstream(testFile_.string()) << "content";
+
+    BOOST_REQUIRE(dispatchUntil(notifier, [&]() { return !closed.empty(); }));
+    BOOST_CHECK(closed.front().event == Event::close_write);
+    BOOST_CHECK(closed.front().path == testFile_);
+    // Once for open and once for close_write
+    BOOST_CHECK_EQUAL(opened, 2u);
+    BOOST_CHECK_EQUAL(directoryEvents, 0u);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldPassGroupOfWatch, StaticNotifierTests)
+{
+    auto logs = testDirectory_ / "logs";
+    boost::filesystem::create_directories(logs);
+
+    std::vector<Notification> created;
+    auto notifier = makeNotifier(on<Event::create>([&](const Notification& notification) {
+        created.push_back(notification);
+    }));
+    auto group = notifier.inotify().addWatchGroup("logs");
+    notifier.inotify().setWatchGroup(logs, group);
+    notifier.watchPathRecursively(testDirectory_);
+    notifier.processReady();
+
+    boost::filesystem::ofstream(testDirectory_ / "source.txt");
+    boost::filesystem::ofstream(logs / "app.log");
+
+    BOOST_REQUIRE(dispatchUntil(notifier, [&]() { return created.size() == 2; }));
+    BOOST_CHECK(created[0].path == testDirectory_ / "source.txt");
+    BOOST_CHECK_EQUAL(created[0].group, 0u);
+    BOOST_CHECK(created[1].path == logs / "app.log");
+    BOOST_CHECK_EQUAL(created[1].group, group);
+}
@@ -0,0 +1,52 @@
+#include <inotify-cpp/Statistics.h>
+
+#include <boost/test/unit_test.hpp>
+
+#include <chrono>
+#include <sstream>
+#include <string>
+
+using namespace inotify;
+using namespace std::chrono;
+
+BOOST_AUTO_TEST_CASE(shouldSortDurationsIntoLog2Buckets)
+{
+    BOOST_CHECK_EQUAL(DurationHistogram::bucketOf(nanoseconds(999)), 0u);
+    BOOST_CHECK_EQUAL(DurationHistogram::bucketOf(microseconds(1)), 1u);
+    BOOST_CHECK_EQUAL(DurationHistogram::bucketOf(microseconds(3)), 2u);
+    BOOST_CHECK_EQUAL(DurationHistogram::bucketOf(microseconds(4)), 3u);
+    BOOST_CHECK_EQUAL(DurationHistogram::bucketOf(hours(1)), DurationHistogram::buckets - 1);
+    BOOST_CHECK(DurationHistogram::upperBound(2) == microseconds(4));
+
+    ObserverCounters counters;
+    counters.record(microseconds(3));
+    counters.record(microseconds(5));
+    auto statistics = counters.snapshot(Event::open);
+    BOOST_CHECK(statistics.events == Event::open);
+    BOOST_CHECK_EQUAL(statistics.calls, 2u);
+    BOOST_CHECK_EQUAL(statistics.durations.counts[2], 1u);
+    BOOST_CHECK_EQUAL(statistics.durations.counts[3], 1u);
+    BOOST_CHECK(statistics.durations.total == microseconds(8));
+}
+
+BOOST_AUTO_TEST_CASE(shouldWriteStatisticsInPrometheusFormat)
+{
+    EventCounters counters;
+    counters.eventsParsed += 3;
+    counters.watches = 2;
+    std::stringstream stream;
+    writePrometheus(stream, counters.snapshot());
+    BOOST_CHECK(stream.str().find("# TYPE inotify_cpp_events_parsed_total counter\n"
+                                  "inotify_cpp_events_parsed_total 3\n")
+        != std::string::npos);
+    BOOST_CHECK(stream.str().find("inotify_cpp_watches 2\n") != std::string::npos);
+
+    ObserverCounters observer;
+    observer.record(microseconds(3));
+    stream.str("");
+    writePrometheus(stream, { observer.snapshot(Event::open) });
+    BOOST_CHECK(stream.str().find("_bucket{observer=\"0\",le=\"2e-06\"} 0\n") != std::string::npos);
+    BOOST_CHECK(stream.str().find("_bucket{observer=\"0\",le=\"4e-06\"} 1\n") != std::string::npos);
+    BOOST_CHECK(stream.str().find("_bucket{observer=\"0\",le=\"+Inf\"} 1\n") != std::string::npos);
+    BOOST_CHECK(stream.str().find("_count{observer=\"0\"} 1\n") != std::string::npos);
+}
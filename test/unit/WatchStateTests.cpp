@@ -0,0 +1,67 @@
+#include <inotify-cpp/WatchState.h>
+
+#include <boost/filesystem/fstream.hpp>
+#include <boost/test/unit_test.hpp>
+
+using namespace inotify;
+
+struct WatchStateTests {
+    WatchStateTests()
+        : stateFile_("watchStateTest.bin")
+    {
+    }
+    ~WatchStateTests()
+    {
+        boost::filesystem::remove(stateFile_);
+    }
+
+    boost::filesystem::path stateFile_;
+};
+
+BOOST_FIXTURE_TEST_CASE(shouldLoadSavedRecords, WatchStateTests)
+{
+    {
+        WatchState state;
+        auto root = state.add("/watched/root", WatchState::directory | WatchState::watched);
+        state.setRoots(1);
+        state.mutableRecord(root).mtime = 42;
+        state.mutableRecord(root).inode = 7;
+        auto firstChild = state.add("file.txt", 0);
+        state.add("sub", WatchState::directory);
+        state.mutableRecord(root).firstChild = firstChild;
+        state.mutableRecord(root).children = 2;
+        BOOST_REQUIRE(state.save(stateFile_));
+    }
+
+    WatchState state;
+    BOOST_REQUIRE(state.load(stateFile_));
+    BOOST_CHECK_EQUAL(state.roots(), 1u);
+    BOOST_REQUIRE_EQUAL(state.size(), 3u);
+    BOOST_CHECK_EQUAL(state.name(state.record(0)), "/watched/root");
+    BOOST_CHECK_EQUAL(state.record(0).mtime, 42u);
+    BOOST_CHECK_EQUAL(state.record(0).inode, 7u);
+    BOOST_CHECK_EQUAL(state.record(0).firstChild, 1u);
+    BOOST_CHECK_EQUAL(state.record(0).children, 2u);
+    BOOST_CHECK_EQUAL(state.name(state.record(2)), "sub");
+    BOOST_CHECK_EQUAL(state.record(2).flags, WatchState::directory);
+}
+
+BOOST_FIXTURE_TEST_CASE(shouldRejectInvalidFiles, WatchStateTests)
+{
+    WatchState state;
+    BOOST_CHECK(!state.load(stateFile_));
+
+    boost::filesystem::ofstream(stateFile_) << "no watch state";
+    BOOST_CHECK(!state.load(stateFile_));
+
+    {
+        WatchState saved;
+        saved.add("/watched/root", WatchState::directory | WatchState::watched);
+        saved.setRoots(1);
+        saved.mutableRecord(0).firstChild = 1;
+        saved.mutableRecord(0).children = 1;
+        BOOST_REQUIRE(saved.save(stateFile_));
+    }
+    // The child is missing
+    BOOST_CHECK(!state.load(stateFile_));
+}